@@ -6,11 +6,14 @@
 #define CGTOOL_LAMMPSDATAOUTPUT_H
 
 #include "trj_output.h"
+#include "text_buffer.h"
 
 class LammpsDataOutput : public TrjOutput{
 protected:
     /** \brief Output file handle. */
     FILE *file_ = nullptr;
+    /** \brief Each frame is formatted here then written in one call. */
+    TextBuffer buffer_;
 
     /** \brief Open and prepare output file. */
     int openFile(const std::string &filename);
@@ -6,25 +6,42 @@
 #define CGTOOL_LAMMPSTRJOUTPUT_H
 
 #include "trj_output.h"
+#include "text_buffer.h"
 
+/**
+* \brief Write frames as a LAMMPS dump - text, or LAMMPS' native binary format
+* read by its binary2txt tool and by read_dump with format native.
+*/
 class LammpsTrjOutput : public TrjOutput{
 protected:
     /** \brief Output file handle. */
     FILE *file_ = nullptr;
+    /** \brief Write binary dump rather than text. */
+    bool binary_ = false;
+    /** \brief Each frame is formatted here then written in one call. */
+    TextBuffer buffer_;
 
     /** \brief Open and prepare output file. */
     int openFile(const std::string &filename);
     /** \brief Close output file. */
     int closeFile();
+
+    /** \brief Format a frame as text into buffer_. */
+    void formatText(const Frame &frame);
+    /** \brief Format a frame as a binary dump into buffer_. */
+    void formatBinary(const Frame &frame);
 public:
     /** \brief Constructor.  Calls openFile() .*/
-    LammpsTrjOutput(const int natoms, const std::string &filename);
+    LammpsTrjOutput(const int natoms, const std::string &filename, const bool binary=false);
     /** \brief Destructor.  Calls closeFile(). */
     ~LammpsTrjOutput();
 
     /** \brief Write a Frame to output file. */
     int writeFrame(const Frame &frame);
 
+    /** \brief Save or restore length of output file. */
+    void checkpoint(Checkpoint &cp);
+
     friend class Frame;
 };
 
@@ -6,6 +6,7 @@
 #define CGTOOL_TRJINPUT_H
 
 #include <string>
+#include <stdexcept>
 
 #include "frame.h"
 #include "residue.h"
@@ -47,6 +48,16 @@ public:
         throw std::logic_error("Input file does not support reading residues");
     };
 
+    /** \brief Position in input file after the last frame read.  Does not have to be supported. */
+    virtual long tell() const{
+        throw std::logic_error("Input file does not support seeking");
+    };
+
+    /** \brief Continue reading from a position returned by tell().  Does not have to be supported. */
+    virtual void seek(const long pos){
+        throw std::logic_error("Input file does not support seeking");
+    };
+
     int getNumAtoms() const{
         return natoms_;
     }
@@ -36,6 +36,13 @@ public:
     /** \brief Read a Frame from input file. */
     int readFrame(Frame &frame);
 
+    /** \brief Position in input file after the last frame read. */
+    long tell() const;
+
+    /** \brief Continue reading from a position returned by tell().
+    * \throws std::runtime_error if the position is not in the file */
+    void seek(const long pos);
+
     friend class Frame;
 };
 
@@ -5,31 +5,91 @@
 #ifndef CGTOOL_XTCOUTPUT_H
 #define CGTOOL_XTCOUTPUT_H
 
+#include <cstdio>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
 #include "trj_output.h"
 #include "xdrfile.h"
 
+/**
+* \brief Write frames to a GROMACS XTC trajectory.
+*
+* Each frame is compressed into memory then appended to the file.  With worker
+* threads, several frames are compressed at once and written as they complete
+* in the order they were given, so the file is the same as if written serially.
+*/
 class XTCOutput : public TrjOutput{
 protected:
-    /** \brief Stores atoms copied from Frame. */
-    rvec *x_ = nullptr;
-    /** \brief Stores box vectors copied from Frame. */
-    float box_[3][3];
+    /** \brief A frame waiting to be compressed and written. */
+    struct Job{
+        std::vector<float> x;
+        matrix box;
+        int step;
+        float time;
+        /** Compressed frame - allocated by open_memstream */
+        char *data = nullptr;
+        size_t size = 0;
+        int status = exdrOK;
+        bool done = false;
+
+        ~Job();
+    };
+
     /** \brief Output file handle. */
-    XDRFILE *file_ = nullptr;
+    FILE *file_ = nullptr;
+    /** \brief XTC precision - coordinates are rounded to 1/precision nm. */
+    float precision_;
+    /** \brief Atoms to write - all atoms if empty. */
+    std::vector<int> atoms_;
+
+    std::vector<std::thread> workers_;
+    /** \brief Frames given but not yet written, in order. */
+    std::deque<std::unique_ptr<Job>> pending_;
+    /** \brief Frames waiting for a worker. */
+    std::deque<Job *> queue_;
+    /** \brief Maximum frames held before writeFrame waits for the oldest. */
+    size_t maxPending_ = 1;
+    bool stop_ = false;
+    std::mutex mutex_;
+    std::condition_variable workCv_;
+    std::condition_variable doneCv_;
 
     /** \brief Open and prepare output file. */
     int openFile(const std::string &filename);
     /** \brief Close output file. */
     int closeFile();
+
+    /** \brief Compress a frame into memory. */
+    void encode(Job &job) const;
+    /** \brief Compress frames from the queue until stopped. */
+    void worker();
+    /** \brief Write completed frames in order until at most max_pending are held.
+    * Returns non-zero if any frame failed. */
+    int commitFrames(const size_t max_pending);
+
 public:
-    /** \brief Constructor.  Calls openFile(). */
-    XTCOutput(const int natoms, const std::string &filename);
-    /** \brief Destructor.  Calls closeFile(). */
+    /** \brief Constructor.  Calls openFile().
+    * \param natoms Number of atoms in each Frame
+    * \param precision XTC precision - 1000 keeps three decimal places in nm
+    * \param atoms Subset of atoms to write - all atoms if empty
+    * \param threads Number of worker threads to compress frames - none to compress serially
+    * \throws std::out_of_range if an atom is not in the Frame */
+    XTCOutput(const int natoms, const std::string &filename, const float precision=500.f,
+              const std::vector<int> &atoms={}, const int threads=0);
+    /** \brief Destructor.  Writes remaining frames then calls closeFile(). */
     ~XTCOutput();
 
-    /** \brief Write a Frame to output file. */
+    /** \brief Write a Frame to output file.  Returns 0 unless a frame has failed to write. */
     int writeFrame(const Frame &frame);
 
+    /** \brief Write all frames given so far then save or restore length of output file. */
+    void checkpoint(Checkpoint &cp);
+
     friend class Frame;
 };
 
@@ -2,10 +2,11 @@
 #define BOLTZMANN_INVERTER_H_
 
 #include <vector>
+#include <cstdint>
 
 #include "bond_struct.h"
 #include "light_array.h"
-#include "histogram.h"
+#include "histogram_nd.h"
 
 /** \brief Class to perform Boltzmann Inversion
 *
@@ -22,7 +23,7 @@ protected:
     double integral_, mean_, adev_, var_, sdev_;
 
     /** Store histogram frequencies */
-    Histogram histogram_;
+    HistogramND<std::int64_t, 1> histogram_;
     LightArray<double> gaussian_;
     LightArray<double> harmonic_;
 
@@ -30,12 +31,27 @@ protected:
     double invertGaussian();
     double invertGaussianSimple();
 
+    /** \brief Harmonic force constant for a Gaussian of given mean and standard deviation */
+    double harmonicConstant(const double mean, const double sdev) const;
+
+    /** \brief Fit a k component Gaussian mixture to the histogram by Expectation Maximisation.
+    * Works on bin counts so cost is O(bins * k) per iteration.
+    * \returns Log likelihood of the fitted mixture */
+    double fitMixtureEM(std::vector<GaussianMode> &modes, const int k) const;
+
     /** \brief Sort bond time series into histogram bins */
     void binHistogram(const std::vector<double> &vec);
 
     /** \brief Calculate R^2 value for calculated gaussian relative to histogram */
     double gaussianRSquared();
 
+    /** \brief Kernel density estimate of the distribution on a regular grid.
+    * Samples are binned onto the grid and smoothed by FFT convolution with a
+    * Gaussian kernel of bandwidth chosen by Silverman's rule, multiplied by scale. */
+    std::vector<double> kernelDensity(const std::vector<double> &vec, const double lo,
+                                      const double step, const int points,
+                                      const bool periodic, const double scale=1.) const;
+
 
 public:
     BoltzmannInverter(const double temp=310., const int bins=55);
@@ -49,6 +65,26 @@ public:
 
     /** Perform all of the necessary calculations to get a force constant */
     void calculate(BondStruct &bond);
+
+    /** \brief Fit Gaussian mixtures of up to max_modes components to a bond distribution.
+    * Must be called after calculate().  The number of modes is chosen by the
+    * Bayesian Information Criterion.  Modes are stored in BondStruct::modes_
+    * with a force constant for each.  Dihedrals are not treated as periodic. */
+    void fitModes(BondStruct &bond, const int max_modes) const;
+
+    /** \brief Fourier analysis of a dihedral free energy -kT ln P.
+    * Must be called after calculate().  Harmonics up to max_mult with an amplitude
+    * of at least min_frac of the largest are stored as proper dihedral terms in
+    * BondStruct::terms_.  Cosine harmonics up to five are also converted to
+    * Ryckaert-Bellemans coefficients in BondStruct::rbCoeffs_. */
+    void fitDihedralSeries(BondStruct &bond, const int max_mult=6,
+                           const double min_frac=0.1) const;
+
+    /** \brief Create a tabulated potential -kT ln P for a bond by Boltzmann Inversion.
+    * Must be called after calculate().  Angle and length distributions are
+    * corrected by their Jacobian before inversion.  Results are stored in
+    * BondStruct::table_ in GROMACS units - nm or degrees, kJ/mol and kJ/mol/(nm or rad). */
+    void tabulate(BondStruct &bond, const double bandwidth_scale=1.) const;
 };
 
 #endif
\ No newline at end of file
@@ -3,12 +3,35 @@
 
 #include <vector>
 #include <string>
+#include <array>
 
 #include "frame.h"
 
 enum class BondType{LENGTH=2, ANGLE=3, DIHEDRAL=4};
 enum class FunctionalForm{HARMONIC, COS, COSHARMONIC};
 
+/** \brief A single Gaussian component of a bond distribution */
+struct GaussianMode{
+    /** Fraction of the distribution in this mode */
+    double weight = 0.;
+    /** Mean of the mode - the equilibrium value */
+    double mean = 0.;
+    /** Standard deviation of the mode */
+    double sdev = 0.;
+    /** Harmonic force constant for this mode by Boltzmann Inversion */
+    double forceConstant = 0.;
+};
+
+/** \brief A single proper dihedral term k(1 + cos(n phi - phi_s)) */
+struct DihedralTerm{
+    /** Multiplicity n */
+    int multiplicity = 1;
+    /** Force constant k in kJ/mol */
+    double forceConstant = 0.;
+    /** Phase phi_s in degrees */
+    double phase = 0.;
+};
+
 /**
 * \brief Class to hold atoms in bonds, angles and dihedrals.
 */
@@ -29,6 +52,17 @@ public:
     /** \brief R^2 of fitting gaussian to bond distribution
     * A low value indicates that the bond is probably bimodal */
     double rsqr_ = 0.;
+    /** \brief Gaussian mixture fitted to the bond distribution, ordered by mean.
+    * Empty unless mixture fitting was requested. */
+    std::vector<GaussianMode> modes_;
+    /** \brief Proper dihedral terms from Fourier analysis of the free energy, ordered by multiplicity.
+    * Empty unless requested - dihedrals only. */
+    std::vector<DihedralTerm> terms_;
+    /** \brief Ryckaert-Bellemans coefficients C0 to C5 in kJ/mol from the same analysis */
+    std::array<double, 6> rbCoeffs_ = {{0., 0., 0., 0., 0., 0.}};
+    /** \brief Tabulated potential from Boltzmann Inversion
+    * Each row contains x, V(x) and -dV/dx.  Empty unless tabulation was requested. */
+    std::vector<std::array<double, 3>> table_;
 
     /** Constructor to set size (bond/angle/dihedral) */
     BondStruct(const BondType type);
@@ -4,10 +4,12 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <array>
 
 #include "bond_struct.h"
 #include "frame.h"
 #include "file_io.h"
+#include "checkpoint.h"
 
 using std::vector;
 using std::string;
@@ -33,6 +35,10 @@ public:
     vector<BondStruct> angles_;
     /** Vector of bond dihedral quads */
     vector<BondStruct> dihedrals_;
+    /** Functional forms to output for lengths, angles and dihedrals */
+    PotentialType potentials_[3];
+    /** Pairs of angle and dihedral indices whose joint distribution should be calculated */
+    vector<std::array<int, 2>> correlations_;
 
     /** \brief Constructor to read from file */
     BondSet(const std::string &cfgname, const std::vector<Residue> &residues,
@@ -51,8 +57,27 @@ public:
     */
     void calcBondsInternal(Frame &frame);
 
-    /** \brief Perform Boltzmann Inversion on all bond_structs. */
-    void BoltzmannInversion();
+    /** \brief Perform Boltzmann Inversion on all bond_structs.
+    * Bonds are processed in parallel, each thread using its own BoltzmannInverter.
+    * If tabulate is true a tabulated potential is also produced for each bond,
+    * smoothed with a kernel bandwidth multiplied by bandwidth_scale.
+    * If max_modes is greater than one, Gaussian mixtures are fitted to each bond.
+    * Dihedrals output as COS or RB are Fourier analysed to find their multiplicity. */
+    void BoltzmannInversion(const bool tabulate=false, const double bandwidth_scale=1.,
+                            const int max_modes=1);
+
+    /** \brief Write tabulated potentials to GROMACS table files.
+    * Files are table_b<n>.xvg, table_a<n>.xvg and table_d<n>.xvg for
+    * lengths, angles and dihedrals.  Requires BoltzmannInversion(true). */
+    void writeTables() const;
+
+    /** \brief Write joint probability density of angle and dihedral pairs.
+    * Pairs are read from the [correlation] section.  Files are corr_a<n>_d<m>.dat
+    * with angle, dihedral and density on each line in blocks of constant angle. */
+    void writeCorrelations() const;
+
+    /** \brief Save or restore bond measurements */
+    void checkpoint(Checkpoint &cp);
 
     /** \brief Calculate bond averages without full Boltzmann Inversion */
     void calcAvgs();
@@ -0,0 +1,99 @@
+#ifndef CGTOOL_CELL_LIST_H
+#define CGTOOL_CELL_LIST_H
+
+#include <vector>
+#include <array>
+
+/**
+* \brief Linked cell neighbour search in an orthorhombic periodic box.
+*
+* Particles are sorted into cells at least as wide as the cutoff so all
+* neighbours of a particle lie in its own or the 26 adjacent cells.  Each pair
+* is visited once by searching only half of the adjacent cells and distances
+* use the minimum image convention, so the cutoff must not exceed half the box.
+*/
+class CellList{
+protected:
+    double cutoff_;
+    std::array<double, 3> box_ = {{0., 0., 0.}};
+    std::array<double, 3> halfBox_ = {{0., 0., 0.}};
+    /** Number of cells along each axis */
+    std::array<int, 3> numCells_ = {{0, 0, 0}};
+    /** Is every axis at least three cells wide?  If not, half shell search could visit a cell twice */
+    bool halfShell_ = true;
+
+    /** Index into sorted arrays of first particle in each cell - one extra entry marks the end */
+    std::vector<int> cellStart_;
+    /** Original index of particles sorted by cell */
+    std::vector<int> sortedIndex_;
+    /** Coordinates of particles sorted by cell - wrapped into the box */
+    std::vector<std::array<double, 3>> sortedCoords_;
+    /** Neighbour cells of each cell - forward half or all unique neighbours */
+    std::vector<std::vector<int>> neighbours_;
+
+    int cellIndex(const int x, const int y, const int z) const{
+        return (x * numCells_[1] + y) * numCells_[2] + z;
+    }
+
+    /** \brief Work out cell dimensions and neighbour lists if the box has changed */
+    void setupCells(const std::array<double, 3> &box);
+
+    /** \brief Minimum image squared distance between two sorted particles.
+    * Sorted coordinates are wrapped into the box so at most one box length need be removed. */
+    double distSqr(const int a, const int b) const{
+        double sum = 0.;
+        for(int d=0; d<3; d++){
+            double delta = sortedCoords_[b][d] - sortedCoords_[a][d];
+            if(delta > halfBox_[d]){
+                delta -= box_[d];
+            }else if(delta < -halfBox_[d]){
+                delta += box_[d];
+            }
+            sum += delta * delta;
+        }
+        return sum;
+    }
+
+public:
+    CellList(const double cutoff) : cutoff_(cutoff){};
+
+    /** \brief Sort particles into cells.  Particles outside the box are wrapped in.
+    * \throws std::invalid_argument if the cutoff is more than half the box */
+    void build(const std::vector<std::array<double, 3>> &coords,
+               const std::array<double, 3> &box);
+
+    /** \brief Call func(i, j, dist_sqr) once for every pair closer than the cutoff.
+    * Cells are processed in parallel so func must be safe to call from many threads. */
+    template <typename Func>
+    void forEachPair(Func func) const{
+        const double cut2 = cutoff_ * cutoff_;
+        const int num_cells = static_cast<int>(neighbours_.size());
+
+        #pragma omp parallel for default(shared) schedule(dynamic, 16)
+        for(int c=0; c<num_cells; c++){
+            for(int a=cellStart_[c]; a<cellStart_[c+1]; a++){
+                // Pairs within this cell
+                for(int b=a+1; b<cellStart_[c+1]; b++){
+                    const double dist2 = distSqr(a, b);
+                    if(dist2 < cut2) func(sortedIndex_[a], sortedIndex_[b], dist2);
+                }
+
+                for(const int n : neighbours_[c]){
+                    // Without half shell every neighbour cell is searched so take only one ordering
+                    const int start = halfShell_ || n > c ? cellStart_[n] : cellStart_[n+1];
+                    for(int b=start; b<cellStart_[n+1]; b++){
+                        const double dist2 = distSqr(a, b);
+                        if(dist2 < cut2) func(sortedIndex_[a], sortedIndex_[b], dist2);
+                    }
+                }
+            }
+        }
+    }
+
+    /** \brief Number of cells along each axis */
+    const std::array<int, 3> &numCells() const{
+        return numCells_;
+    }
+};
+
+#endif //CGTOOL_CELL_LIST_H
@@ -5,10 +5,15 @@
 #ifndef CGTOOL_CGTOOL_H
 #define CGTOOL_CGTOOL_H
 
+#include <vector>
+#include <array>
+#include <string>
+
 #include "common.h"
 
 #include "bondset.h"
 #include "rdf.h"
+#include "structure_factor.h"
 
 class Cgtool : public Common{
 protected:
@@ -20,8 +25,13 @@ protected:
 
     BondSet  *bondSet_ = nullptr;
     RDF      *rdf_ = nullptr;
+    /** \brief Pairs of selections to calculate RDF between */
+    std::vector<std::array<std::string, 2>> rdfPairs_;
+    StructureFactor *sq_ = nullptr;
 
     TrjOutput *trjOutput_ = nullptr;
+    /** \brief Bead names or types to write to the XTC - all beads if empty */
+    std::vector<std::string> outputAtoms_;
 
     double temperature_ = 310;
 
@@ -32,9 +42,16 @@ protected:
     /** \brief Construct objects which are required to perform requested functions */
     void setupObjects();
 
+    /** \brief Indices of CG atoms matching outputAtoms_ by name or type
+    * \throws std::runtime_error if a name matches no atoms */
+    std::vector<int> selectOutputAtoms() const;
+
     /** \brief Function executed within the main loop - performs most significant work*/
     void mainLoop();
 
+    /** \brief Save or restore accumulated analysis */
+    void checkpoint(Checkpoint &cp);
+
     /** \brief Perform final calculations and end program */
     void postProcess();
 
@@ -0,0 +1,158 @@
+#ifndef CGTOOL_CHECKPOINT_H
+#define CGTOOL_CHECKPOINT_H
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <array>
+#include <map>
+#include <valarray>
+#include <stdexcept>
+#include <type_traits>
+
+/**
+* \brief Save or restore accumulated analysis state so a run can be resumed.
+*
+* The same sync calls are used to write and to read a checkpoint, so each
+* class describes its state once in a checkpoint() member.  Containers are
+* stored with their size and resized when loading.  Named sections are
+* checked on load to catch a checkpoint written with a different setup.
+*/
+class Checkpoint{
+public:
+    enum class Mode{SAVE, LOAD};
+
+protected:
+    Mode mode_;
+    std::string filename_;
+    std::vector<char> data_;
+    size_t pos_ = 0;
+
+    /** \brief Is this process continuing from a checkpoint? */
+    static bool resuming_;
+
+    /** \brief Copy bytes to or from the checkpoint */
+    void raw(void *bytes, const size_t n);
+
+    /** \brief Read or write the size of a container - checked against the data remaining */
+    uint64_t syncSize(const size_t size);
+
+    /** \brief Numbers are copied as one block */
+    template<typename T>
+    void syncItems(std::vector<T> &vec, std::true_type){
+        if(!vec.empty()) raw(vec.data(), vec.size() * sizeof(T));
+    }
+
+    template<typename T>
+    void syncItems(std::vector<T> &vec, std::false_type){
+        for(T &item : vec) sync(item);
+    }
+
+public:
+    /** \brief Start a checkpoint to save, or read a checkpoint to load.
+    * \throws std::runtime_error if a checkpoint to load cannot be read or is not a checkpoint */
+    Checkpoint(const std::string &filename, const Mode mode);
+
+    bool loading() const{
+        return mode_ == Mode::LOAD;
+    }
+
+    /** \brief Mark the start of named state.
+    * \throws std::runtime_error if loading and the checkpoint has a different section here */
+    void section(const std::string &name);
+
+    template<typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value>::type sync(T &value){
+        raw(&value, sizeof(T));
+    }
+
+    void sync(std::string &str);
+
+    template<typename T>
+    void sync(std::vector<T> &vec);
+
+    template<typename T, size_t N>
+    void sync(std::array<T, N> &arr){
+        for(T &item : arr) sync(item);
+    }
+
+    template<typename K, typename V>
+    void sync(std::map<K, V> &map);
+
+    template<typename T>
+    void sync(std::valarray<T> &arr);
+
+    /** \brief Save or restore a fixed length array of numbers.
+    * \throws std::runtime_error if loading and the stored length differs */
+    template<typename T>
+    void syncData(T *data, const size_t n);
+
+    /** \brief Save the length of an output file or cut it back to the saved length.
+    * Output written after the checkpoint is discarded so the resumed run can append.
+    * \throws std::runtime_error if loading and the file is shorter than when saved */
+    void syncFile(FILE *file);
+
+    /** \brief Switch a saved checkpoint to loading from the start - to restore state kept in memory */
+    void rewind();
+
+    /** \brief Write checkpoint to a temporary file then move it over the old one.
+    * \throws std::runtime_error if the checkpoint cannot be written */
+    void save();
+
+    static void setResuming(const bool resuming){
+        resuming_ = resuming;
+    }
+
+    static bool resuming(){
+        return resuming_;
+    }
+};
+
+/** \brief Open output file which is written during the run.
+* Backs up any old file, unless resuming when the file is opened for appending. */
+FILE *open_stream_file(const std::string &filename, const bool binary=false);
+
+template<typename T>
+void Checkpoint::sync(std::vector<T> &vec){
+    const uint64_t size = syncSize(vec.size());
+    if(loading()) vec.resize(size);
+    syncItems(vec, std::is_arithmetic<T>());
+}
+
+template<typename K, typename V>
+void Checkpoint::sync(std::map<K, V> &map){
+    const uint64_t size = syncSize(map.size());
+    if(loading()){
+        map.clear();
+        for(uint64_t i=0; i<size; i++){
+            K key;
+            sync(key);
+            sync(map[key]);
+        }
+    }else{
+        for(auto &item : map){
+            K key = item.first;
+            sync(key);
+            sync(item.second);
+        }
+    }
+}
+
+template<typename T>
+void Checkpoint::sync(std::valarray<T> &arr){
+    const uint64_t size = syncSize(arr.size());
+    if(loading()) arr.resize(size);
+    if(size > 0) syncData(&arr[0], size);
+}
+
+template<typename T>
+void Checkpoint::syncData(T *data, const size_t n){
+    static_assert(std::is_arithmetic<T>::value, "Checkpoint::syncData needs numbers");
+    uint64_t size = n;
+    sync(size);
+    if(size != n) throw std::runtime_error("Checkpoint " + filename_ + " does not match the current setup");
+    raw(data, n * sizeof(T));
+}
+
+#endif //CGTOOL_CHECKPOINT_H
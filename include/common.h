@@ -12,8 +12,10 @@
 #include "residue.h"
 #include "frame.h"
 #include "cg_map.h"
+#include "density_map.h"
 #include "parser.h"
 #include "cmd.h"
+#include "checkpoint.h"
 
 struct CheckedFile{
     std::string name = "";
@@ -43,12 +45,27 @@ protected:
     bool untilEnd_ = true;
     std::map<std::string, std::map<std::string, int>> settings_;
 
+    // Checkpointing
+    /** \brief Checkpoint file - set by each program so they do not overwrite each other */
+    std::string checkpointFile_ = "checkpoint.cpt";
+    /** \brief Position in the XTC after the last frame read */
+    long xtcPosition_ = 0;
+
+    // Following a growing XTC
+    bool follow_ = false;
+    /** \brief Time of the last output refresh */
+    double lastRefresh_ = 0.;
+    /** \brief Frame at the last output refresh - output is not refreshed if nothing is new */
+    int refreshFrame_ = 0;
+
     // Objects
     std::vector<Residue> residues_;
     std::vector<Residue> cgResidues_;
     Frame    *frame_ = nullptr;
     Frame    *cgFrame_ = nullptr;
     CGMap    *cgMap_ = nullptr;
+    /** \brief Density maps requested in the [density_maps] section */
+    std::vector<DensityMap> densityMaps_;
 
     // Progress updates
     const int updateFreq_[10] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000};
@@ -64,8 +81,44 @@ protected:
     /** \brief Construct objects which are required to perform requested functions */
     virtual void setupObjects() = 0;
 
-    /** \brief Prepare for and run the main calculation loop */
-    void doMainLoop();
+    /** \brief Read density maps from config file - shared by all programs */
+    void readDensityConfig();
+
+    /** \brief Read checkpoint settings from config file - shared by all programs */
+    void readCheckpointConfig();
+
+    /** \brief Save or restore state shared by all programs then call checkpoint() */
+    void syncCheckpoint(Checkpoint &cp);
+
+    /** \brief Write a checkpoint of the analysis so far */
+    void saveCheckpoint();
+
+    /** \brief Restore analysis from checkpoint and continue reading the XTC after the last frame */
+    void loadCheckpoint();
+
+    /** \brief Save or restore program specific state */
+    virtual void checkpoint(Checkpoint &cp) = 0;
+
+    /** \brief Read settings for following a growing XTC from config file - shared by all programs */
+    void readFollowConfig();
+
+    /** \brief Wait for XTC to grow beyond size, refreshing output while waiting.
+    * Returns false if stopped by a signal or the timeout in [follow] */
+    bool waitForFrames(const long size);
+
+    /** \brief Is it time to refresh output? */
+    bool refreshDue() const;
+
+    /** \brief Write output of the analysis so far then carry on.
+    * postProcess() may normalise in place so state is restored from a snapshot afterwards. */
+    void refreshOutput();
+
+    /** \brief Print all density maps */
+    void printDensity();
+
+    /** \brief Prepare for and run the main calculation loop.
+    * Returns false if stopped by a signal, after writing a checkpoint. */
+    bool doMainLoop();
 
     /** \brief Update progress timer within the main loop */
     void updateProgress();
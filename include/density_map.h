@@ -0,0 +1,94 @@
+#ifndef CGTOOL_DENSITY_MAP_H
+#define CGTOOL_DENSITY_MAP_H
+
+#include <vector>
+#include <array>
+#include <string>
+
+#include "frame.h"
+#include "residue.h"
+#include "histogram_nd.h"
+
+/**
+* \brief Number density of a selection of atoms on a 1, 2 or 3d grid.
+*
+* Atoms are binned in fractional coordinates so the grid is fixed relative to
+* the box as it fluctuates.  Each sample is weighted by the inverse volume of
+* its cell in that frame, and grid spacing is reported from the mean box.
+* Axes which are not binned have a single cell covering the box.
+* Each thread bins into its own shard, shards are merged by reduce().
+*/
+class DensityMap{
+protected:
+    /** Residue name, atom name or atom type selected */
+    std::string selection_;
+    /** Residue name, atom name or atom type whose centre is moved to the middle of the box */
+    std::string centre_;
+    /** Number of bins along each of x, y and z */
+    std::array<int, 3> bins_ = {{1, 1, 1}};
+    std::vector<int> atoms_;
+    std::vector<int> centreAtoms_;
+
+    int numShards_ = 1;
+    std::vector<HistogramND<double, 3>> shards_;
+    /** Sum over frames of samples weighted by inverse cell volume - valid after reduce() */
+    HistogramND<double, 3> density_;
+    std::array<double, 3> boxSum_ = {{0., 0., 0.}};
+    int frames_ = 0;
+
+    /** \brief Atoms matching a residue name (all atoms of the residue), atom name or atom type */
+    static std::vector<int> resolveSelection(const std::string &name, const Frame &frame,
+                                             const std::vector<Residue> &residues);
+
+public:
+    /** \brief Density of selection binned along axes.
+    * \param axes Axes to bin along - any of x, y and z, e.g. "z" for a profile along the normal
+    * \param bins Number of bins along each axis given, in the order x, y, z
+    * \param centre Selection to centre in the box each frame - empty for none */
+    DensityMap(const std::string &selection, const std::string &axes,
+               const std::vector<int> &bins, const std::string &centre="");
+
+    /** \brief Find selected atoms in frame.
+    * \throws std::runtime_error if a selection matches no atoms */
+    void setup(const Frame &frame, const std::vector<Residue> &residues);
+
+    /** \brief Bin selected atoms of a frame */
+    void add(const Frame &frame);
+
+    /** \brief Merge thread shards into the density */
+    void reduce();
+
+    /** \brief Save or restore accumulated density - must already be setup with the saved bins */
+    void checkpoint(Checkpoint &cp);
+
+    /** \brief Mean number density in nm^-3 of a cell - valid after reduce() */
+    double density(const int x, const int y=0, const int z=0) const;
+
+    /** \brief Mean box dimensions over frames */
+    std::array<double, 3> meanBox() const;
+
+    const std::array<int, 3> &bins() const{
+        return bins_;
+    }
+
+    int frames() const{
+        return frames_;
+    }
+
+    const std::string &selection() const{
+        return selection_;
+    }
+
+    /** \brief Print as text - a profile for one axis, or a matrix for two with the last axis along rows.
+    * Three axes are printed one line per cell. */
+    void printText(const std::string &filename, const bool header=true) const;
+
+    /** \brief Print as an OpenDX scalar field with grid from the mean box */
+    void printDX(const std::string &filename) const;
+
+    /** \brief Print as binary - "CGDM" then int32 nx, ny, nz, float32 origin[3],
+    * float32 spacing[3] and float32 density with z varying fastest */
+    void printBinary(const std::string &filename) const;
+};
+
+#endif //CGTOOL_DENSITY_MAP_H
@@ -0,0 +1,91 @@
+#ifndef CGTOOL_DIFFUSION_H
+#define CGTOOL_DIFFUSION_H
+
+#include <vector>
+#include <array>
+#include <string>
+
+#include "checkpoint.h"
+
+/**
+* \brief Lateral mean squared displacement and diffusion coefficients.
+*
+* In-plane positions of each particle are unwrapped across the periodic box
+* and stored per frame as displacements from the first frame.  Drift of the
+* centre of mass of a reference set of groups is removed from each group, so
+* for instance lipids are measured relative to their own leaflet.
+* The MSD of every lag is computed from the FFT autocorrelation of each
+* particle's time series in O(T log T), averaging over all time origins.
+*/
+class Diffusion{
+protected:
+    int numParticles_ = 0;
+    /** Group of each particle */
+    std::vector<int> group_;
+    std::vector<std::string> groupNames_;
+    /** Bitmask of groups whose pooled centre of mass drift is removed from each group - 0 for none */
+    std::vector<unsigned> reference_;
+    /** Number of particles in each group */
+    std::vector<int> groupSize_;
+
+    /** Wrapped position of each particle in the previous frame */
+    std::vector<std::array<double, 2>> prevWrapped_;
+    /** Unwrapped displacement of each particle since the first frame */
+    std::vector<std::array<double, 2>> unwrapped_;
+    /** Drift corrected displacements - frame major, x and y of each particle */
+    std::vector<float> series_;
+    std::vector<double> times_;
+
+    /** MSD of each group at each lag - calculated by calculate() */
+    std::vector<std::vector<double>> msd_;
+
+public:
+    /** \brief Track particles belonging to groups.
+    * \param group Group of each particle - index into names
+    * \param names Name of each group
+    * \param reference Bitmask for each group of the groups whose drift is removed from it */
+    Diffusion(const std::vector<int> &group, const std::vector<std::string> &names,
+              const std::vector<unsigned> &reference);
+
+    /** \brief Add wrapped in-plane positions of every particle at a time in ps.
+    * Particles must not move more than half the box between frames. */
+    void add(const std::vector<std::array<double, 2>> &positions,
+             const std::array<double, 2> &box, const double time);
+
+    /** \brief Save or restore trajectories of all frames added */
+    void checkpoint(Checkpoint &cp);
+
+    /** \brief Calculate MSD of each group from all frames added */
+    void calculate();
+
+    /** \brief MSD in nm^2 of a group at a lag in frames - valid after calculate() */
+    double msd(const int group, const int lag) const{
+        return msd_[group][lag];
+    }
+
+    /** \brief Lag time in ps of a lag in frames assuming equally spaced frames */
+    double lagTime(const int lag) const;
+
+    /** \brief Fit D in nm^2/ps from MSD = 4 D t + c over lag times in [t_start, t_end] ps.
+    * A negative t_end fits up to half the trajectory.
+    * \return false if fewer than two lags are in the window */
+    bool fit(const int group, const double t_start, const double t_end, double &D) const;
+
+    int frames() const{
+        return static_cast<int>(times_.size());
+    }
+
+    int numGroups() const{
+        return static_cast<int>(groupNames_.size());
+    }
+
+    const std::string &groupName(const int group) const{
+        return groupNames_[group];
+    }
+
+    /** \brief Print MSD of each group with fitted D in the header */
+    void print(const std::string &filename, const double t_start, const double t_end,
+               const bool header=true) const;
+};
+
+#endif //CGTOOL_DIFFUSION_H
@@ -0,0 +1,79 @@
+#ifndef CGTOOL_FFT_H
+#define CGTOOL_FFT_H
+
+#include <vector>
+#include <complex>
+#include <memory>
+
+/**
+* \brief Precomputed plan for a 1d complex discrete Fourier transform
+*
+* Powers of two use an iterative radix-2 transform, other lengths are
+* evaluated with Bluestein's algorithm on a padded power of two.
+* A plan holds only constant data so may be shared between threads.
+*/
+class FFT{
+protected:
+    /** Length of the transform */
+    int size_ = 0;
+    /** Is size_ a power of two? */
+    bool pow2_ = true;
+    /** Twiddle factors exp(-2 pi i k / size_) for radix-2 */
+    std::vector<std::complex<double>> twiddles_;
+    /** Bit reversal permutation for radix-2 */
+    std::vector<int> bitrev_;
+
+    /** Bluestein chirp exp(-i pi k^2 / size_) */
+    std::vector<std::complex<double>> chirp_;
+    /** Forward transform of the conjugate chirp filter */
+    std::vector<std::complex<double>> chirpFT_;
+    /** Power of two plan used to perform Bluestein convolution */
+    std::unique_ptr<FFT> inner_;
+
+    /** \brief Radix-2 transform in place - size_ must be a power of two */
+    void radix2(std::complex<double> *data, const bool inverse) const;
+
+    /** \brief Bluestein transform in place for arbitrary size_ */
+    void bluestein(std::complex<double> *data, const bool inverse) const;
+
+public:
+    /** \brief Create plan for transforms of length size */
+    FFT(const int size);
+
+    /** \brief Transform size_ contiguous values in place.
+    * The inverse transform is normalised by 1 / size_ */
+    void transform(std::complex<double> *data, const bool inverse=false) const;
+
+    /** \brief Forward transform of a vector in place */
+    void forward(std::vector<std::complex<double>> &data) const;
+
+    /** \brief Normalised inverse transform of a vector in place */
+    void inverse(std::vector<std::complex<double>> &data) const;
+
+    int size() const{
+        return size_;
+    }
+};
+
+/** \brief Smallest power of two not less than n */
+int next_pow2(const int n);
+
+/** \brief 2d transform in place of row major data with dimensions nx * ny.
+* Lines are transformed in parallel. */
+void fft2D(std::vector<std::complex<double>> &data, const int nx, const int ny,
+           const bool inverse=false);
+
+/** \brief 3d transform in place of row major data with dimensions nx * ny * nz.
+* Lines are transformed in parallel. */
+void fft3D(std::vector<std::complex<double>> &data, const int nx, const int ny,
+           const int nz, const bool inverse=false);
+
+/** \brief Convolve real data with a kernel centred on index 0.
+*
+* kernel[i] is the weight at offset i, kernel is assumed symmetric.
+* If periodic the data wrap around, otherwise data are zero padded.
+*/
+void fft_convolve(std::vector<double> &data, const std::vector<double> &kernel,
+                  const bool periodic);
+
+#endif //CGTOOL_FFT_H
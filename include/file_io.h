@@ -9,7 +9,7 @@
 
 enum class FileFormat{GROMACS, LAMMPS};
 enum class FieldFormat{MARTINI, ELBA, OTHER};
-enum class PotentialType{HARMONIC, COS, COSSQUARED};
+enum class PotentialType{HARMONIC, COS, COSSQUARED, RB};
 
 const std::map<std::string, FileFormat> getFileFormat =
         {{"GROMACS", FileFormat::GROMACS},
@@ -23,6 +23,7 @@ const std::map<std::string, FieldFormat> getFieldFormat =
 const std::map<std::string, PotentialType> getPotential =
         {{"HARMONIC",   PotentialType::HARMONIC},
          {"COS",        PotentialType::COS},
-         {"COSSQUARED", PotentialType::COSSQUARED}};
+         {"COSSQUARED", PotentialType::COSSQUARED},
+         {"RB",         PotentialType::RB}};
 
 #endif //CGTOOL_FILE_IO_H
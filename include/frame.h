@@ -119,6 +119,10 @@ public:
                                 time_(frame.time_), num_(frame.num_), step_(frame.step_),
                                 residues_(frame.residues_){}
 
+    /** \brief Create Frame of natoms atoms at the origin in a cubic box of side box.
+    * Not attached to any input file - for use in tests and benchmarks. */
+    Frame(const int natoms, const double box, std::vector<Residue> &residues);
+
     /** \brief Create Frame by copying data from another Frame
     * Intended for creating a CG Frame from an atomistic one.  Atoms are not copied. */
     Frame(const Frame &frame, std::vector<Residue> *residues=nullptr);
@@ -135,6 +139,12 @@ public:
     */
     bool readNext();
 
+    /** \brief Position in input trajectory after the last frame read - to resume from a checkpoint */
+    long trajectoryPosition() const;
+
+    /** \brief Continue reading input trajectory from a position given by trajectoryPosition() */
+    void seekTrajectory(const long pos);
+
     void initFromITP(const std::string &topname);
     void initFromFLD(const std::string &fldname);
 
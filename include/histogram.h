@@ -5,16 +5,35 @@
 #ifndef CGTOOL_HISTOGRAM_H
 #define CGTOOL_HISTOGRAM_H
 
+#include <cstdint>
+#include <vector>
+
+#include "histogram_nd.h"
+
+/**
+* \brief 1d histogram of integer counts which may be incremented from many threads.
+*
+* Each OpenMP thread increments its own partial HistogramND so no atomics are
+* required.  After incrementing in parallel, call reduce() to merge the
+* partials before reading counts.
+*/
 class Histogram{
 protected:
     int size_;
-    int *array_ = nullptr;
+    /** Number of per-thread shards - excluding the shared overflow shard */
+    int numShards_ = 1;
+    /** Partial histograms - one per thread plus one shared by any extra threads */
+    std::vector<HistogramND<std::int64_t, 1>> shards_;
     bool fast_ = false;
     bool allocated_ = false;
     double min_ = 0.;
     double max_ = 0.;
     double step_ = 0.;
 
+    /** \brief Get the shard belonging to the calling thread.
+    * Threads beyond numShards_ share an extra shard which is updated atomically. */
+    int shardNum() const;
+
 public:
     // ##############################################################################
     // Con/Destructors
@@ -26,7 +45,10 @@ public:
     // ##############################################################################
     // Setup / Tear down
     // ##############################################################################
+    /** \brief Allocate histogram of size bins indexed directly by increment() */
     void init(const int size, const bool fast=false);
+    /** \brief Allocate histogram of size bins covering [min, max) for use with add() */
+    void init(const double min, const double max, const int size);
     void zero(const int set=0);
     void free();
 
@@ -35,10 +57,20 @@ public:
     // ##############################################################################
     void increment(int loc);
     void decrement(int loc);
-    int at (int loc) const;
+    /** \brief Count value weight times in the bin containing it.  Values out of range are ignored. */
+    void add(const double val, const int weight=1);
+    /** \brief Get count in bin.  Counts from threads other than the
+    * master are not visible until reduce() has been called. */
+    std::int64_t at(int loc) const;
+
+    /** \brief Merge all shards into the first by pairwise tree reduction */
+    void reduce();
 
     void scale(const double mult);
 
+    /** \brief Save or restore counts - must already be allocated with the saved range */
+    void checkpoint(Checkpoint &cp);
+
     // ##############################################################################
     // Printing
     // ##############################################################################
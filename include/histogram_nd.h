@@ -0,0 +1,334 @@
+#ifndef CGTOOL_HISTOGRAM_ND_H
+#define CGTOOL_HISTOGRAM_ND_H
+
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+#include <vector>
+#include <array>
+#include <algorithm>
+
+#include "checkpoint.h"
+
+/**
+* \brief Bin edges along a single axis of a HistogramND.
+*
+* Bins are half open [edge_i, edge_i+1).  Uniform axes compute the bin directly,
+* axes with explicit edges use a binary search.  Periodic axes wrap values into range.
+*/
+class HistogramAxis{
+protected:
+    /** Bin edges - bins_ + 1 of them */
+    std::vector<double> edges_;
+    int bins_ = 0;
+    double lo_ = 0.;
+    double hi_ = 0.;
+    /** Width of bins if uniform */
+    double width_ = 0.;
+    bool uniform_ = true;
+    bool periodic_ = false;
+
+public:
+    HistogramAxis(){};
+
+    /** \brief Uniform axis of bins bins covering [lo, hi) */
+    HistogramAxis(const double lo, const double hi, const int bins, const bool periodic=false) :
+            bins_(bins), lo_(lo), hi_(hi), width_((hi - lo) / bins), periodic_(periodic){
+        if(bins < 1 || !(hi > lo)) throw std::invalid_argument("Invalid histogram axis range");
+        edges_.resize(bins_ + 1);
+        for(int i=0; i<=bins_; i++) edges_[i] = lo_ + i * width_;
+        edges_[bins_] = hi_;
+    }
+
+    /** \brief Axis with explicit bin edges which must be strictly increasing */
+    HistogramAxis(const std::vector<double> &edges, const bool periodic=false) :
+            edges_(edges), periodic_(periodic){
+        if(edges_.size() < 2) throw std::invalid_argument("Histogram axis needs at least two edges");
+        for(int i=1; i<edges_.size(); i++){
+            if(!(edges_[i] > edges_[i-1])) throw std::invalid_argument("Histogram edges must be increasing");
+        }
+        bins_ = static_cast<int>(edges_.size()) - 1;
+        lo_ = edges_.front();
+        hi_ = edges_.back();
+        width_ = (hi_ - lo_) / bins_;
+        uniform_ = false;
+    }
+
+    /** \brief Uniform axis of bins bins of given width starting at lo */
+    static HistogramAxis fromWidth(const double lo, const double width, const int bins,
+                                   const bool periodic=false){
+        HistogramAxis axis(lo, lo + bins * width, bins, periodic);
+        // Keep the exact width so bin assignment matches (x - lo) / width
+        axis.width_ = width;
+        return axis;
+    }
+
+    /** \brief Save or restore axis exactly */
+    void checkpoint(Checkpoint &cp){
+        cp.sync(edges_);
+        cp.sync(bins_);
+        cp.sync(lo_);
+        cp.sync(hi_);
+        cp.sync(width_);
+        cp.sync(uniform_);
+        cp.sync(periodic_);
+    }
+
+    /** \brief Bin containing x.  Returns -1 below range and bins() above or if x is NaN */
+    int index(double x) const{
+        if(periodic_) x -= (hi_ - lo_) * std::floor((x - lo_) / (hi_ - lo_));
+        if(uniform_){
+            const double u = (x - lo_) / width_;
+            if(u < 0.) return -1;
+            if(u < bins_) return static_cast<int>(u);
+            return bins_;
+        }
+        if(x < lo_) return -1;
+        if(!(x < hi_)) return bins_;
+        return static_cast<int>(std::upper_bound(edges_.begin(), edges_.end(), x) - edges_.begin()) - 1;
+    }
+
+    /** \brief Bins for n values - out of range values as for index() */
+    void indices(const double *x, const int n, int *out) const{
+        if(uniform_ && !periodic_){
+            const double lo = lo_, width = width_, bins = bins_;
+            const int past_end = bins_;
+            #pragma omp simd
+            for(int i=0; i<n; i++){
+                const double u = (x[i] - lo) / width;
+                out[i] = u < 0. ? -1 : (u < bins ? static_cast<int>(u) : past_end);
+            }
+        }else{
+            for(int i=0; i<n; i++) out[i] = index(x[i]);
+        }
+    }
+
+    int bins() const{
+        return bins_;
+    }
+
+    double lo() const{
+        return lo_;
+    }
+
+    double hi() const{
+        return hi_;
+    }
+
+    bool periodic() const{
+        return periodic_;
+    }
+
+    double edge(const int i) const{
+        return edges_[i];
+    }
+
+    double width(const int i) const{
+        return edges_[i+1] - edges_[i];
+    }
+
+    double centre(const int i) const{
+        return 0.5 * (edges_[i] + edges_[i+1]);
+    }
+
+    bool operator==(const HistogramAxis &other) const{
+        return bins_ == other.bins_ && periodic_ == other.periodic_ && edges_ == other.edges_;
+    }
+};
+
+/**
+* \brief N dimensional histogram with weighted bins of type T.
+*
+* Samples outside the range of any axis are not binned but their weight is
+* tallied in outside().  Partial histograms, for instance one per thread, may
+* be combined with merge() or reduce_partials().
+*/
+template <typename T, int N> class HistogramND{
+protected:
+    std::array<HistogramAxis, N> axes_;
+    /** Distance in counts_ between consecutive bins along each axis - row major */
+    std::array<int, N> strides_;
+    std::vector<T> counts_;
+    /** Total weight of samples outside the histogram range */
+    T outside_ = 0;
+
+    /** Samples are binned in chunks of this size when filling from arrays */
+    static const int chunk_ = 256;
+
+public:
+    HistogramND(){};
+
+    HistogramND(const std::array<HistogramAxis, N> &axes){
+        init(axes);
+    }
+
+    void init(const std::array<HistogramAxis, N> &axes){
+        axes_ = axes;
+        int size = 1;
+        for(int d=N-1; d>=0; d--){
+            strides_[d] = size;
+            size *= axes_[d].bins();
+        }
+        counts_.assign(size, T(0));
+        outside_ = 0;
+    }
+
+    void zero(const T value=0){
+        std::fill(counts_.begin(), counts_.end(), value);
+        outside_ = 0;
+    }
+
+    // ##############################################################################
+    // Add values
+    // ##############################################################################
+
+    /** \brief Flat index of bin containing x, or -1 if outside range */
+    int flatIndex(const std::array<double, N> &x) const{
+        int flat = 0;
+        for(int d=0; d<N; d++){
+            const int i = axes_[d].index(x[d]);
+            if(i < 0 || i >= axes_[d].bins()) return -1;
+            flat += i * strides_[d];
+        }
+        return flat;
+    }
+
+    void add(const std::array<double, N> &x, const T weight=1){
+        const int flat = flatIndex(x);
+        if(flat < 0){
+            outside_ += weight;
+        }else{
+            counts_[flat] += weight;
+        }
+    }
+
+    /** \brief Add weight directly to a bin by flat index */
+    void addIndex(const int flat, const T weight=1){
+        assert(flat >= 0 && flat < counts_.size());
+        counts_[flat] += weight;
+    }
+
+    /** \brief Add n samples whose coordinates along axis d are in cols[d].
+    * Bin indices are computed for a chunk of samples along each axis in
+    * turn before any bins are updated.  weights may be null for unit weight. */
+    void addBatch(const std::array<const double *, N> &cols, const int n,
+                  const T *weights=nullptr){
+        int idx[chunk_], axis_idx[chunk_];
+        for(int start=0; start<n; start+=chunk_){
+            const int len = n - start < chunk_ ? n - start : chunk_;
+            std::fill(idx, idx + len, 0);
+            for(int d=0; d<N; d++){
+                axes_[d].indices(cols[d] + start, len, axis_idx);
+                const int bins = axes_[d].bins(), stride = strides_[d];
+                for(int i=0; i<len; i++){
+                    const int a = axis_idx[i];
+                    idx[i] = (idx[i] < 0 || a < 0 || a >= bins) ? -1 : idx[i] + a * stride;
+                }
+            }
+            for(int i=0; i<len; i++){
+                const T weight = weights ? weights[start + i] : T(1);
+                if(idx[i] < 0){
+                    outside_ += weight;
+                }else{
+                    counts_[idx[i]] += weight;
+                }
+            }
+        }
+    }
+
+    /** \brief Add all partial results from another histogram with identical axes */
+    void merge(const HistogramND<T, N> &other){
+        for(int d=0; d<N; d++){
+            if(!(axes_[d] == other.axes_[d]))
+                throw std::invalid_argument("Cannot merge histograms with different axes");
+        }
+        for(int i=0; i<counts_.size(); i++) counts_[i] += other.counts_[i];
+        outside_ += other.outside_;
+    }
+
+    HistogramND<T, N> &operator+=(const HistogramND<T, N> &other){
+        merge(other);
+        return *this;
+    }
+
+    void scale(const double mult){
+        for(T &count : counts_) count *= mult;
+        outside_ *= mult;
+    }
+
+    /** \brief Save or restore axes and counts */
+    void checkpoint(Checkpoint &cp){
+        for(HistogramAxis &axis : axes_) axis.checkpoint(cp);
+        if(cp.loading()) init(axes_);
+        cp.sync(counts_);
+        cp.sync(outside_);
+    }
+
+    // ##############################################################################
+    // Access
+    // ##############################################################################
+
+    T &operator[](const int flat){
+        return counts_[flat];
+    }
+
+    const T &at(const int flat) const{
+        return counts_[flat];
+    }
+
+    const T &at(const std::array<int, N> &i) const{
+        int flat = 0;
+        for(int d=0; d<N; d++) flat += i[d] * strides_[d];
+        return counts_[flat];
+    }
+
+    /** \brief Total weight of samples inside range */
+    T total() const{
+        T sum = 0;
+        for(const T count : counts_) sum += count;
+        return sum;
+    }
+
+    /** \brief Total weight of samples dropped as out of range */
+    T outside() const{
+        return outside_;
+    }
+
+    /** \brief Total number of bins */
+    int size() const{
+        return static_cast<int>(counts_.size());
+    }
+
+    const HistogramAxis &axis(const int d) const{
+        return axes_[d];
+    }
+
+    /** \brief Probability density in each bin - normalised by the total in range and bin volume */
+    std::vector<double> density() const{
+        std::vector<double> dens(counts_.size(), 0.);
+        const double sum = static_cast<double>(total());
+        if(sum <= 0.) return dens;
+        for(int flat=0; flat<counts_.size(); flat++){
+            double volume = 1.;
+            for(int d=0; d<N; d++) volume *= axes_[d].width((flat / strides_[d]) % axes_[d].bins());
+            dens[flat] = counts_[flat] / (sum * volume);
+        }
+        return dens;
+    }
+};
+
+/** \brief Merge partial histograms into the first by pairwise tree reduction.
+* Each level of the tree is merged in parallel. */
+template <typename T, int N>
+void reduce_partials(std::vector<HistogramND<T, N>> &parts){
+    const int num = static_cast<int>(parts.size());
+    for(int gap=1; gap<num; gap*=2){
+        #pragma omp parallel for default(shared) schedule(static)
+        for(int dest=0; dest<num-gap; dest+=2*gap){
+            parts[dest].merge(parts[dest + gap]);
+        }
+    }
+}
+
+#endif //CGTOOL_HISTOGRAM_ND_H
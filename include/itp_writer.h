@@ -42,6 +42,9 @@ protected:
     /** Create a new section in the ITP file */
     void newSection(const std::string &section_name) const;
 
+    /** Print fitted modes of a multimodal bond as comments */
+    void printModes(const BondStruct &bond) const;
+
 public:
     /** Create an ITP file and prepare to write */
     ITPWriter(const std::vector<Residue> *residues,
@@ -61,6 +64,10 @@ public:
     /** Print bond params to ITP */
     void printBonds(const BondSet &bond_set, const bool round=false) const;
 
+    /** \brief Print bonds referencing tabulated potentials to ITP.
+    * Table numbers match the files written by BondSet::writeTables(). */
+    void printBondsTabulated(const BondSet &bond_set) const;
+
     /** Print atomtypes to ITP */
     void printAtomTypes(const CGMap &cgmap) const;
 };
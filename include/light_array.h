@@ -8,10 +8,15 @@
 #include <cassert>
 #include <stdexcept>
 
+#include <cmath>
+
 #include <valarray>
+#include <vector>
 #include <array>
+#include <algorithm>
 
 #include "small_functions.h"
+#include "checkpoint.h"
 
 template <typename T> class LightArray{
 protected:
@@ -19,6 +24,43 @@ protected:
     std::array<int, 2> size_ = {{0, 0}};
     const bool safe_;
 
+    /** \brief Gauss-Seidel update of the points in row i with colour (i + j) % 2.
+    * Points of one colour depend only on points of the other so the inner loop vectorises.
+    * Without periodic boundaries the first and last columns are left unchanged. */
+    void relaxRow(const int i, const int colour, const bool periodic){
+        const int nx = size_[0], ny = size_[1];
+        T *row = &array_[i * ny];
+        const T *up = &array_[((i + nx - 1) % nx) * ny];
+        const T *down = &array_[((i + 1) % nx) * ny];
+
+        int start = (i + colour) & 1;
+        if(start == 0){
+            if(periodic) row[0] += 0.25 * (up[0] + down[0] + row[ny-1] + row[1] - 4 * row[0]);
+            start = 2;
+        }
+        #pragma omp simd
+        for(int j=start; j<ny-1; j+=2){
+            row[j] += 0.25 * (up[j] + down[j] + row[j-1] + row[j+1] - 4 * row[j]);
+        }
+        if(periodic && ((i + ny - 1) & 1) == colour){
+            row[ny-1] += 0.25 * (up[ny-1] + down[ny-1] + row[ny-2] + row[0] - 4 * row[ny-1]);
+        }
+    }
+
+    /** \brief Convolve n values with a symmetric kernel given by its non-negative half.
+    * in holds the values padded by the kernel radius either side. */
+    static void convolvePadded(const double *in, const int n, const std::vector<double> &kernel,
+                               double *out){
+        const int radius = static_cast<int>(kernel.size()) - 1;
+        std::fill(out, out + n, 0.);
+        for(int k=-radius; k<=radius; k++){
+            const double w = kernel[std::abs(k)];
+            const double *src = in + radius + k;
+            #pragma omp simd
+            for(int j=0; j<n; j++) out[j] += w * src[j];
+        }
+    }
+
 public:
     LightArray<T>(const bool safe=true) : safe_(safe){};
 
@@ -78,19 +120,112 @@ public:
         return array_.sum();
     }
 
-    void smooth(const int n_iter=1){
-        int jsw = 0;
-        int isw = 0;
-        for(int ipass = 0; ipass < 2 * n_iter; ipass++){
-            jsw = isw;
-            for(int i = 1; i < size_[0]-1; i++){
-                for(int j = jsw+1; j < size_[1]-1; j += 2){
-                    const int loc = i*size_[0] + j;
-                    array_[loc] += 0.25 * (array_[loc+size_[0]] + array_[loc+1] + array_[loc-1] + array_[loc-size_[0]] - 4 * array_[loc]);
+    /** \brief Save or restore contents - array is reallocated on load */
+    void checkpoint(Checkpoint &cp){
+        cp.sync(size_);
+        cp.sync(array_);
+    }
+
+    /** \brief Number of elements along each dimension */
+    const std::array<int, 2> &size() const{
+        return size_;
+    }
+
+    /** \brief Apply iterations of red-black Gauss-Seidel smoothing.
+    *
+    * Each iteration relaxes the points with i + j even then those with i + j odd.
+    * Rows of one colour are independent so are processed in parallel.
+    * Without periodic boundaries the edges of the array are left unchanged.
+    * Arrays smaller than 3 points along either axis are not smoothed.
+    */
+    void smooth(const int n_iter=1, const bool periodic=false){
+        const int nx = size_[0], ny = size_[1];
+        if(nx < 3 || ny < 3) return;
+
+        // With an odd number of rows the first and last rows are neighbours of the
+        // same colour so are updated after the others rather than concurrently
+        const bool wrap_rows = periodic && nx % 2 == 1;
+        const int first = periodic && !wrap_rows ? 0 : 1;
+        const int last = periodic && !wrap_rows ? nx : nx - 1;
+
+        for(int pass=0; pass<2*n_iter; pass++){
+            const int colour = pass % 2;
+            #pragma omp parallel for default(shared) schedule(static)
+            for(int i=first; i<last; i++) relaxRow(i, colour, periodic);
+            if(wrap_rows){
+                relaxRow(0, colour, true);
+                relaxRow(nx - 1, colour, true);
+            }
+        }
+    }
+
+    /** \brief Separable Gaussian filter of width sigma grid points.
+    *
+    * The kernel is truncated at three sigma.  Without periodic boundaries the
+    * kernel is renormalised near the edges over the points inside the array.
+    * Each pass works on whole rows so the inner loops are contiguous and vectorise.
+    */
+    void gaussianFilter(const double sigma, const bool periodic=true){
+        const int nx = size_[0], ny = size_[1];
+        if(sigma <= 0. || nx * ny == 0) return;
+
+        const int radius = static_cast<int>(std::ceil(3. * sigma));
+        std::vector<double> kernel(radius + 1);
+        double sum = 0.;
+        for(int k=0; k<=radius; k++){
+            kernel[k] = std::exp(-0.5 * k * k / (sigma * sigma));
+            sum += k == 0 ? kernel[k] : 2 * kernel[k];
+        }
+        for(double &w : kernel) w /= sum;
+
+        // Weight of the kernel inside the array at each point - all one if periodic
+        auto edge_weights = [&](const int n){
+            std::vector<double> norm(n, 1.);
+            if(periodic) return norm;
+            for(int j=0; j<n; j++){
+                double in = 0.;
+                for(int k=-radius; k<=radius; k++) if(j + k >= 0 && j + k < n) in += kernel[std::abs(k)];
+                norm[j] = 1. / in;
+            }
+            return norm;
+        };
+        const std::vector<double> norm_y = edge_weights(ny);
+        const std::vector<double> norm_x = edge_weights(nx);
+        auto pad_index = [&](const int j, const int n){
+            return periodic ? ((j % n) + n) % n : (j >= 0 && j < n ? j : -1);
+        };
+
+        std::vector<double> tmp(nx * ny);
+        #pragma omp parallel default(shared)
+        {
+            std::vector<double> pad(std::max(nx, ny) + 2 * radius);
+            std::vector<double> out(std::max(nx, ny));
+
+            // Along y within each row
+            #pragma omp for schedule(static)
+            for(int i=0; i<nx; i++){
+                for(int j=-radius; j<ny+radius; j++){
+                    const int src = pad_index(j, ny);
+                    pad[j + radius] = src < 0 ? 0. : array_[i * ny + src];
+                }
+                convolvePadded(pad.data(), ny, kernel, out.data());
+                for(int j=0; j<ny; j++) tmp[i * ny + j] = out[j] * norm_y[j];
+            }
+
+            // Along x - accumulate whole rows weighted by the kernel
+            #pragma omp for schedule(static)
+            for(int i=0; i<nx; i++){
+                std::fill(out.begin(), out.begin() + ny, 0.);
+                for(int k=-radius; k<=radius; k++){
+                    const int src = pad_index(i + k, nx);
+                    if(src < 0) continue;
+                    const double w = kernel[std::abs(k)];
+                    const double *row = &tmp[src * ny];
+                    #pragma omp simd
+                    for(int j=0; j<ny; j++) out[j] += w * row[j];
                 }
-                jsw = 1 - jsw;
+                for(int j=0; j<ny; j++) array_[i * ny + j] = static_cast<T>(out[j] * norm_x[i]);
             }
-            isw = 1 - isw;
         }
     }
 
@@ -102,7 +237,7 @@ public:
     void print(const char *format="%8.3f") const{
         for(int i = 0; i < size_[0]; i++){
             for(int j = 0; j < size_[1]; j++){
-                printf(format, array_[i * size_[0] + j]);
+                printf(format, array_[i * size_[1] + j]);
             }
             printf("\n");
         }
@@ -117,10 +252,11 @@ public:
         // Backup using small_functions.h
         if(!suppress_backup) backup_old_file(file);
 
-        FILE *f = fopen(file.c_str(), "a");
+        // Append to a header if it was written by the caller
+        FILE *f = fopen(file.c_str(), suppress_backup ? "a" : "w");
         for(int i=r; i < size_[0]-r; i++){
             for(int j=r; j < size_[1]-r; j++){
-                fprintf(f, "%8.3f", array_[i*size_[0] + j]);
+                fprintf(f, "%8.3f", array_[i*size_[1] + j]);
             }
             fprintf(f, "\n");
         }
@@ -7,13 +7,15 @@
 
 #include <string>
 #include <vector>
-#include <set>
 #include <array>
 #include <map>
+#include <cstdint>
 
 #include "frame.h"
 #include "residue.h"
 #include "light_array.h"
+#include "voronoi.h"
+#include "undulation.h"
 
 class Membrane{
 protected:
@@ -21,17 +23,43 @@ protected:
     std::vector<int> upperHeads_;
     /** Head group reference atoms in the lower layer */
     std::vector<int> lowerHeads_;
+    /** Names of lipid residue types - sorted */
+    std::vector<std::string> resTypes_;
+    /** Residue type of each upper head group - index into resTypes_ */
+    std::vector<int> upperHeadType_;
+    /** Residue type of each lower head group - index into resTypes_ */
+    std::vector<int> lowerHeadType_;
+    /** Head group reference atom of each lipid */
+    std::vector<int> lipidHead_;
+    /** Last atom of each lipid - used for orientation */
+    std::vector<int> lipidTail_;
+    /** Residue type of each lipid - index into resTypes_ */
+    std::vector<int> lipidType_;
+    /** Is each lipid in the upper leaflet? */
+    std::vector<char> lipidUpper_;
+    /** Lipid index of each head group reference atom */
+    std::map<int, int> headLipid_;
+    /** Track lipids moving between leaflets each frame? */
+    bool track_ = true;
+    /** Number of blocks along x and y used to find the local midplane */
+    int blocks_ = 4;
     /** Protein reference atoms */
     std::vector<int> protAtoms_;
     /** Is protein present? */
     bool protein_ = false;
-    /** Distance from ref in upper leaflet to closest in lower */
-    std::map<int, double> upperPair_;
-    /** Distance from ref in lower leaflet to closest in upper */
-    std::map<int, double> lowerPair_;
-    /** Closest lipid to grid point in upper leaflet */
+    /** Radius of protein atoms when rasterising - if zero grid points closer to protein than lipid are excluded */
+    double proteinRadius_ = 0.3;
+    /** Grid points covered by protein in the current frame - one bit per point, row major */
+    std::vector<std::uint64_t> protMask_;
+    /** Number of frames each grid point was covered by protein */
+    LightArray<double> protOccupancy_;
+    /** Distance from each upperHeads_ to closest in lower leaflet */
+    std::vector<double> upperPair_;
+    /** Distance from each lowerHeads_ to closest in upper leaflet */
+    std::vector<double> lowerPair_;
+    /** Closest lipid to grid point in upper leaflet - -1 if covered by protein */
     LightArray<int> closestUpper_;
-    /** Closest lipid to grid point in lower leaflet */
+    /** Closest lipid to grid point in lower leaflet - -1 if covered by protein */
     LightArray<int> closestLower_;
     /** Local membrane mean curvature */
     LightArray<double> curvMean_;
@@ -56,22 +84,80 @@ protected:
     /** \brief File for printing area per lipid */
     FILE *aplFile_ = nullptr;
     FILE *avgFile_ = nullptr;
-    /** \brief Number of grid points for each residue */
-    std::map<std::string, int> upperResPPL_;
-    std::map<std::string, int> lowerResPPL_;
-    std::map<std::string, int> upperNumRes_;
-    std::map<std::string, int> lowerNumRes_;
-
-    /** \brief Create closest pairs of reference groups between layers */
+    /** \brief Number of grid points for each residue type */
+    std::vector<int> upperResPPL_;
+    std::vector<int> lowerResPPL_;
+    /** \brief Number of lipids of each residue type */
+    std::vector<int> upperNumRes_;
+    std::vector<int> lowerNumRes_;
+    /** \brief Sum over frames of number of lipids of each residue type - for averaging */
+    std::vector<int> upperLipidFrames_;
+    std::vector<int> lowerLipidFrames_;
+    /** \brief File for printing lipid flip-flop events */
+    FILE *flipFile_ = nullptr;
+
+    /** Calculate area per lipid by Voronoi tessellation rather than counting grid points? */
+    bool voronoi_ = true;
+    /** \brief Total Voronoi area of each residue type */
+    std::vector<double> upperResArea_;
+    std::vector<double> lowerResArea_;
+    /** Accumulate undulation spectrum of height and thickness fields? */
+    bool spectrum_ = true;
+    /** Fluctuation spectrum of membrane midplane height and thickness */
+    UndulationSpectrum undulation_;
+    /** Width in nm of periodic Gaussian filter applied to thickness and curvature - 0 for none */
+    double smoothSigma_ = 0.;
+
+    /** Voronoi tessellation of each leaflet in the most recent frame */
+    Voronoi upperVoronoi_;
+    Voronoi lowerVoronoi_;
+
+    /** \brief Fill head group lists and counts of each leaflet from lipidUpper_ */
+    void rebuildLeaflets();
+
+    /** \brief Reassign lipids which have moved between leaflets.
+    * Lipids far from the local midplane on their own side keep their leaflet.  Others
+    * change leaflet only if both their position and head-tail orientation say so. */
+    void updateLeaflets(const Frame &frame);
+
+    /** \brief Create closest pairs of reference groups between layers.
+    * pairs is indexed by position in ref.  Uses a bucket grid of the other layer. */
     void makePairs(const Frame &frame, const std::vector<int> &ref,
-                   const std::vector<int> &other, std::map<int, double> &pairs);
+                   const std::vector<int> &other, std::vector<double> &pairs);
 
-    /** \brief Find closest head group to each grid cell */
+    /** \brief Find closest head group to each grid cell.
+    * Uses a bucket grid of head groups so each query is independent of the number of lipids.
+    * Grid points are counted per thread and added to resPPL after the search. */
     double closestLipid(const Frame &frame, const std::vector<int> &ref,
-                        const std::map<int, double> &pairs,
-                        std::map<std::string, int> &resPPL, LightArray<int> &closest);
+                        const std::vector<int> &head_type, const std::vector<double> &pairs,
+                        std::vector<int> &resPPL, LightArray<int> &closest);
+
+    /** \brief Set bits of protMask_ for grid points within proteinRadius_ of a protein atom */
+    void rasteriseProtein(const Frame &frame);
+
+    /** \brief Is grid point covered by protein in the current frame? */
+    bool isProtein(const int i, const int j) const{
+        const int bit = i * grid_ + j;
+        return (protMask_[bit / 64] >> (bit % 64)) & 1;
+    }
+
+    /** \brief Tessellate head groups of a leaflet and add cell areas to the total for each residue */
+    void voronoiArea(const Frame &frame, const std::vector<int> &heads, const std::vector<int> &head_type,
+                     Voronoi &voronoi, std::vector<double> &res_area);
+
+    /** \brief Height of the closest head group in a leaflet at each grid point.
+    * Points covered by protein have no closest lipid and take the mean height of the rest */
+    void leafletHeight(const Frame &frame, const LightArray<int> &closest, LightArray<double> &height) const;
+
+    /** \brief Add height and thickness fields from closest lipids in each leaflet to the spectrum */
+    void addSpectrum(const Frame &frame);
+
+    /** \brief Print area per lipid of each residue type present in a leaflet */
+    void printLeafletAPL(const std::vector<int> &lipid_frames, const std::vector<int> &res_ppl,
+                         const std::vector<double> &res_area) const;
 
     void prepCSVAvgThickness();
+    void prepCSVFlipFlop();
     void prepCSVAreaPerLipid();
 
 public:
@@ -84,16 +170,22 @@ public:
 
     /** \brief Construct Membrane with vector of Residues present in simulation */
     Membrane(const std::vector<Residue> &residues, const Frame &frame,
-             const int resolution=100, const int blocks=4, const bool header=true);
+             const int resolution=100, const int blocks=4, const bool header=true,
+             const bool voronoi=true, const double protein_radius=0.3, const bool track=true,
+             const bool spectrum=true, const double smooth_sigma=0.);
 
     /** \brief Sort head groups into upper and lower bilayer
      *  Divided into blocks to account for curvature. Size blocks * blocks */
     void sortBilayer(const Frame &frame, const int blocks=4);
 
+    /** \brief Save or restore accumulated averages, leaflet assignment and output files */
+    void checkpoint(Checkpoint &cp);
+
     /** \brief Calculate thickness of bilayer */
     double thickness(const Frame &frame, const bool with_reset=false);
 
-    /** \brief Calculate curvature of membrane by 2nd order finite differences */
+    /** \brief Calculate curvature of membrane by 2nd order finite differences.
+     * Differences wrap around the box if a Gaussian filter is used, otherwise the edges are zero */
     void curvature(const Frame &frame);
 
     /** \brief Print curvature grid to file */
@@ -102,18 +194,50 @@ public:
     /** \brief Calculate average thickness */
     double mean() const;
 
-    /** \brief Normalize membrane thickness array in place */
+    /** \brief Normalize membrane thickness array in place.
+     * Applies smooth_iter Gauss-Seidel iterations then the Gaussian filter if enabled */
     void normalize(const int smooth_iter=1);
 
     /** \brief Print thickness array to CSV */
     void printCSV(const std::string &filename) const;
 
+    /** \brief Print running average area per lipid of each residue in each leaflet.
+     * Uses Voronoi cell areas, or grid points closest to each lipid if Voronoi is off */
     void printCSVAreaPerLipid(const float time) const;
 
+    /** \brief Print undulation spectrum and fitted elastic constants.
+     * \param q_max Largest wavevector in fit - continuum model holds only at long wavelength
+     * \param temperature Temperature in K */
+    void printSpectrum(const std::string &filename, const double q_max, const double temperature) const;
+
+    /** \brief Fit bending modulus (kJ/mol) and tension (kJ/mol/nm^2) to undulation spectrum
+     * \return false if too few frames or wavevectors */
+    bool elasticConstants(const double q_max, const double temperature, double &kappa, double &sigma) const;
+
+    /** \brief Print fraction of frames each grid point was covered by protein */
+    void printCSVProtein(const std::string &filename) const;
+
+    /** \brief Print Voronoi area and neighbours of each lipid in the most recent frame */
+    void printCSVVoronoi(const std::string &filename) const;
+
     /** \brief Set resolution of calculation
      * Number of grid points in x and y */
     void setResolution(const int n);
 
+    /** \brief Leaflet of the lipid with a given head group reference atom in the current frame
+     * \return 1 for the upper leaflet, -1 for the lower, 0 if the atom is not a lipid head group */
+    int leaflet(const int head) const;
+
+    /** \brief Head group reference atom of each lipid */
+    const std::vector<int> &lipidHeads() const{
+        return lipidHead_;
+    }
+
+    /** \brief Protein atoms within the membrane */
+    const std::vector<int> &proteinAtoms() const{
+        return protAtoms_;
+    }
+
     /** \brief Zero the running count of membrane thickness */
     void reset();
 };
@@ -0,0 +1,94 @@
+#ifndef CGTOOL_ORDER_PARAMETER_H
+#define CGTOOL_ORDER_PARAMETER_H
+
+#include <vector>
+#include <array>
+#include <string>
+
+#include "frame.h"
+#include "residue.h"
+#include "light_array.h"
+
+class Membrane;
+
+/**
+* \brief Lipid tail order parameters along chains of named atoms or beads.
+*
+* S_CC = <(3 cos^2 theta - 1) / 2> for each bond between consecutive atoms of
+* a chain, with theta the angle between the bond and the membrane normal z.
+* For each interior atom S_CD is estimated assuming ideal tetrahedral C-D
+* bonds: S_CD = (S_xx + 2 S_yy) / 3 where x bisects the C-C-C angle and y is
+* normal to the C-C-C plane.  Chains are listed from the head group towards the
+* tail end.  All results are resolved by leaflet.
+*/
+class OrderParameter{
+protected:
+    /** \brief Chain of atoms within all residues of one type */
+    struct Chain{
+        std::string resname;
+        std::vector<std::string> names;
+        /** Atom numbers of the chain in each residue - one row of names.size() per residue */
+        std::vector<int> atoms;
+        /** Reference atom of each residue - used to find the leaflet */
+        std::vector<int> heads;
+        /** Sum over lipids and frames of S_CC of each bond - upper then lower leaflet */
+        std::array<std::vector<double>, 2> scc;
+        /** Sum over lipids and frames of S_CD of each interior atom - upper then lower leaflet */
+        std::array<std::vector<double>, 2> scd;
+        /** Number of lipid frames in each leaflet */
+        std::array<int, 2> samples = {{0, 0}};
+    };
+
+    std::vector<Chain> chains_;
+    /** Residues in the frame */
+    std::vector<Residue> residues_;
+    int frames_ = 0;
+
+    /** Number of grid points along x and y of the order parameter maps */
+    int grid_ = 0;
+    /** Sum of mean S_CC of each lipid at its head group position - upper then lower leaflet */
+    std::array<LightArray<double>, 2> mapSum_;
+    std::array<LightArray<double>, 2> mapCount_;
+    std::array<double, 3> box_ = {{0., 0., 0.}};
+
+public:
+    /** \brief Order parameters of residues in frames with these residues.
+    * \param resolution Number of points along x and y of order parameter maps */
+    OrderParameter(const std::vector<Residue> &residues, const int resolution=100);
+
+    /** \brief Add a chain of at least two named atoms in every residue of a type.
+    * \throws std::invalid_argument if the residue or any atom does not exist */
+    void addChain(const std::string &resname, const std::vector<std::string> &names);
+
+    /** \brief Accumulate order parameters of all chains in a frame.
+    * Lipids are assigned to leaflets by membrane, or by orientation if membrane is null. */
+    void calculate(const Frame &frame, const Membrane *membrane=nullptr);
+
+    /** \brief Mean S_CC of a bond in leaflet 0 (upper), 1 (lower) or -1 (both) */
+    double scc(const int chain, const int bond, const int leaflet=-1) const;
+
+    /** \brief Mean S_CD of an interior atom in leaflet 0 (upper), 1 (lower) or -1 (both) */
+    double scd(const int chain, const int atom, const int leaflet=-1) const;
+
+    int numChains() const{
+        return static_cast<int>(chains_.size());
+    }
+
+    int frames() const{
+        return frames_;
+    }
+
+    /** \brief Print order parameters of every atom of every chain */
+    void print(const std::string &filename, const bool header=true) const;
+
+    /** \brief Print maps of mean S_CC of lipids in each leaflet to filename_upper and filename_lower */
+    void printCSVMaps(const std::string &filename, const bool header=true) const;
+
+    /** \brief Save or restore running totals */
+    void checkpoint(Checkpoint &cp);
+
+    /** \brief Zero running totals */
+    void reset();
+};
+
+#endif //CGTOOL_ORDER_PARAMETER_H
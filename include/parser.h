@@ -1,52 +1,94 @@
 #ifndef PARSER_H_
 #define PARSER_H_
 
-#include <fstream>
 #include <string>
 #include <vector>
+#include <map>
+#include <memory>
+
+#include <boost/utility/string_ref.hpp>
 
 #include "file_io.h"
 
 /**
 * \brief Parses input files for comments, section headers and data lines
+*
+* The file is read once on construction into an index of the data lines of
+* each section.  Tokens are references into the file contents so no strings
+* are allocated unless they are requested as std::string.
+*
+* GROMACS files are preprocessed - #include, #define, #undef, #ifdef, #ifndef,
+* #else and #endif are handled and defined names are substituted in data lines.
+* Included files are searched for relative to the including file, then the
+* working directory, then each directory in $GMXLIB; missing files are skipped.  Files are cached by path
+* and modification time so a force field included by many topologies is only
+* read once per process.
 */
 class Parser{
+public:
+    /** \brief Contents of a file split into lines - shared by all Parsers which read it */
+    struct SourceFile{
+        std::string contents;
+        /** Trimmed lines which are not empty or ; comments - refer into contents */
+        std::vector<boost::string_ref> lines;
+    };
+
 private:
-    /** The file currently being read */
-    std::ifstream file_;
-    /** The name of the file currently being read */
+    /** \brief Data line - a range of tokens_ */
+    struct Line{
+        int first;
+        int size;
+    };
+
+    /** The name of the file being read */
     std::string filename_;
-    /** The line currently being read */
-    std::string line_;
-    /** The section of the file currently being read */
-    std::string section_ = "";
+    /** The file and all files it includes - tokens refer into these */
+    std::vector<std::shared_ptr<const SourceFile>> files_;
+    /** Names defined by #define and the tokens they are replaced with */
+    std::map<std::string, std::vector<boost::string_ref>> defines_;
+    /** Tokens of every data line in order */
+    std::vector<boost::string_ref> tokens_;
+    /** Data lines of each section in file order - repeated sections are joined */
+    std::map<std::string, std::vector<Line>> sections_;
     /** The section that was last searched for. */
     std::string findPrevious_ = "";
-    /** Is EOF? */
-    bool eof_;
+    /** Next line of findPrevious_ to return */
+    int cursor_ = 0;
     /** Expected file format - GROMACS style or LAMMPS style */
     FileFormat format_ = FileFormat::GROMACS;
 
-    /**
-    * \brief Reads a line from file and splits it into tokens
+    /** \brief Split file contents into sections, data lines and tokens
     *
-    * Will skip over empty lines and comments and read section headers transparently
-    * Parses the next data line and fills a vector<string> of tokens
+    * Will skip over empty lines and comments and read section headers transparently.
+    * Preprocessor directives are followed, recursing into included files.
+    * Included files which cannot be found are skipped with a warning.
+    * \throws runtime_error if conditionals are unbalanced
     */
-    bool getLine(std::vector<std::string> &tokens);
+    void index(const std::string &filename, std::string &section, const int depth);
+
+    /** \brief Get a file from the cache, reading it if it is not cached or has been modified
+    * \throws runtime_error if file cannot be opened */
+    static std::shared_ptr<const SourceFile> load(const std::string &filename);
+
+    /** \brief Next line of a section with at least len tokens.  Returns nullptr at the end of the section
+    * and rewinds so the section will be read again from the start */
+    const Line *nextLine(const std::string &find, const int len);
 
     /** \brief Rewind to start of file */
     void rewind();
 
 public:
     /**
-    * \brief Constructor for a Parser which will open a file and prepare for reading
+    * \brief Constructor for a Parser which will read and index a file
     * \throws runtime_error if file cannot be opened
     */
     Parser(const std::string filename, const FileFormat format=FileFormat::GROMACS);
 
-    /** Destructor to close file */
-    ~Parser();
+    /** \brief Number of files held in the include cache */
+    static int cacheSize();
+
+    /** \brief Empty the include cache */
+    static void clearCache();
 
     /** \brief Search through a config file for a particular section
     * Returns false if section cannot be found
@@ -54,10 +96,15 @@ public:
     bool findSection(const std::string find);
 
     /**\brief Search through config file for a particular section and pass back lines
-    * Once it reaches the end of the file, it rewinds to the beginning and returns
+    * Once it reaches the end of the section, it rewinds to the beginning and returns
     * Can specify the number of tokens expected, will return false if too few found */
     bool getLineFromSection(const std::string find, std::vector<std::string> &tokens, const int len=1);
 
+    /** \brief As getLineFromSection but tokens refer into the file contents held by the Parser.
+    * Tokens are valid for the lifetime of the Parser and are followed in memory by a delimiter,
+    * so may be passed directly to strtod and similar. */
+    bool getLineFromSection(const std::string find, std::vector<boost::string_ref> &tokens, const int len=1);
+
     bool getKeyFromSection(const std::string &section, const std::string &key,
                            std::string &value);
 
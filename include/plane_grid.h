@@ -0,0 +1,62 @@
+#ifndef CGTOOL_PLANE_GRID_H
+#define CGTOOL_PLANE_GRID_H
+
+#include <vector>
+#include <array>
+
+/**
+* \brief Periodic 2d bucket grid for nearest neighbour queries in the xy plane.
+*
+* Points are sorted into square-ish buckets holding a few points each.  A query
+* searches rings of buckets outward from the query point until no unsearched
+* bucket can contain a closer point, so queries take constant time for evenly
+* spread points.  Distances use distSqrPlane so results are identical to a
+* brute force search, with ties going to the lowest point index.
+*/
+class PlaneGrid{
+protected:
+    /** Periodic box - only x and y are used */
+    std::array<double, 3> box_ = {{0., 0., 0.}};
+    /** Number of buckets along x and y */
+    std::array<int, 2> numCells_ = {{1, 1}};
+    /** Width of buckets along x and y */
+    std::array<double, 2> cellWidth_ = {{0., 0.}};
+    /** Range of bucket offsets which reach every bucket exactly once */
+    std::array<int, 2> offsetLo_ = {{0, 0}};
+    std::array<int, 2> offsetHi_ = {{0, 0}};
+
+    /** Index into sorted arrays of first point in each bucket - one extra entry marks the end */
+    std::vector<int> cellStart_;
+    /** Original index of points sorted by bucket */
+    std::vector<int> sortedIndex_;
+    /** Coordinates of points sorted by bucket - unwrapped as given */
+    std::vector<std::array<double, 3>> sortedCoords_;
+
+    /** \brief Bucket containing coordinate x along axis d */
+    int cellCoord(const double x, const int d) const;
+
+public:
+    PlaneGrid(){};
+
+    /** \brief Sort points into buckets.  Points need not be inside the box.
+    * \param per_cell Target mean number of points per bucket */
+    void build(const std::vector<std::array<double, 3>> &coords,
+               const std::array<double, 3> &box, const double per_cell=2.);
+
+    /** \brief Index of the point closest to point in the plane.
+    * Only points with squared distance less than max_dist2 are considered.
+    * \param dist2 Set to the squared distance of the closest point if found
+    * \return Original index of the closest point, or -1 if none are in range */
+    int nearest(const std::array<double, 3> &point, const double max_dist2, double &dist2) const;
+
+    /** \brief Original indices of all points with squared distance from point less than max_dist2.
+    * Uses minimum image so only one image of each point is found. */
+    void within(const std::array<double, 3> &point, const double max_dist2, std::vector<int> &found) const;
+
+    /** \brief Number of points in grid */
+    int size() const{
+        return static_cast<int>(sortedIndex_.size());
+    }
+};
+
+#endif //CGTOOL_PLANE_GRID_H
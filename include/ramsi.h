@@ -8,11 +8,30 @@
 #include "common.h"
 
 #include "membrane.h"
+#include "order_parameter.h"
+#include "diffusion.h"
 
 class Ramsi : public Common{
 protected:
     Membrane *membrane_ = nullptr;
+    /** \brief Radius of protein atoms in nm when rasterising the protein footprint */
+    double proteinRadius_ = 0.3;
+    /** \brief Largest wavevector in nm^-1 used in the bending modulus fit */
+    double spectrumQMax_ = 1.;
+    /** \brief Temperature in K for the elastic constants */
+    double temperature_ = 310.;
+    /** \brief Width in nm of Gaussian filter on thickness and curvature - 0 for none */
+    double smoothSigma_ = 0.;
     std::vector<double> thickness_;
+    OrderParameter *order_ = nullptr;
+    /** \brief Residue name followed by atoms of each tail chain for order parameters */
+    std::vector<std::vector<std::string>> orderChains_;
+    Diffusion *diffusion_ = nullptr;
+    /** \brief Atoms tracked for lateral diffusion - lipid head groups then protein */
+    std::vector<int> diffusionAtoms_;
+    /** \brief Time window in ps of the diffusion coefficient fit - negative end fits up to half the trajectory */
+    double diffusionStart_ = 0.;
+    double diffusionEnd_ = -1.;
 
     // Protected functions
     /** \brief Read config file and determine which functions should be performed */
@@ -24,6 +43,9 @@ protected:
     /** \brief Function executed within the main loop - performs most significant work*/
     void mainLoop();
 
+    /** \brief Save or restore accumulated analysis */
+    void checkpoint(Checkpoint &cp);
+
     /** \brief Perform final calculations and end program */
     void postProcess();
 
@@ -6,12 +6,24 @@
 #define CGTOOL_RDF_H
 
 #include <vector>
+#include <array>
+#include <string>
+#include <cstdint>
 
 #include "residue.h"
 #include "frame.h"
 #include "histogram.h"
 #include "light_array.h"
+#include "cell_list.h"
 
+/**
+* \brief Radial distribution functions between pairs of atom selections.
+*
+* A selection is either a residue name, selecting the reference atom of each
+* residue, or an atom/bead name or type.  All pairs are accumulated from a
+* single neighbour search per frame.  With no pairs added the RDF of the
+* reference atom of the first residue with itself is calculated.
+*/
 class RDF{
 protected:
     const std::vector<Residue> &residues_;
@@ -21,21 +33,79 @@ protected:
     int grid_ = 200;
 
     int frames_ = 0;
-    double density_ = 0.;
+    /** Have selections been resolved? */
+    bool selected_ = false;
 
-    Histogram histogram_;
-    LightArray<double> rdf_;
+    /** Names of selections as given by the user */
+    std::vector<std::string> selectionNames_;
+    /** Pairs of selections to calculate RDF between */
+    std::vector<std::array<int, 2>> pairs_;
+    /** Were pairs requested?  If not, write the single RDF as rdf.dat */
+    bool customPairs_ = false;
+
+    /** Atoms in any selection - resolved on the first frame */
+    std::vector<int> atoms_;
+    /** Bitmask of the selections each atom in atoms_ belongs to */
+    std::vector<std::uint64_t> masks_;
+    /** Number of atoms in each selection */
+    std::vector<int> selectionSizes_;
+    /** Number of atoms in both selections of each pair */
+    std::vector<int> pairOverlap_;
+
+    /** Histogram of distances for each pair */
+    std::vector<Histogram> histograms_;
+    /** Sum over frames of (N_A N_B - N_AB) / V for each pair - N_AB atoms are in both selections */
+    std::vector<double> pairDensity_;
+    /** Sum over frames of N_A for each pair */
+    std::vector<double> refCount_;
+    /** Normalised RDF of each pair */
+    std::vector<LightArray<double>> rdfs_;
+    /** Mean number of neighbours within outer edge of each shell for each pair */
+    std::vector<LightArray<double>> coordination_;
+
+    /** Neighbour search structure - kept between frames to reuse cell setup */
+    CellList cellList_;
+    /** Coordinates of selected atoms in the current frame */
+    std::vector<std::array<double, 3>> coords_;
+
+    /** \brief Index of selection with given name - adding it if not already present */
+    int selectionIndex(const std::string &name);
+
+    /** \brief Find the atoms in each selection */
+    void setupSelections(const Frame &frame);
+
+    /** \brief Atoms matching a selection in frame.
+    * \throws std::runtime_error if nothing matches */
+    std::vector<int> resolveSelection(const std::string &name, const Frame &frame) const;
 
 public:
-    RDF(const std::vector<Residue> &residues, const double cutoff, const int resolution) :
-        residues_(residues), cutoff_(cutoff), resolution_(resolution){
-        grid_ = static_cast<int>(cutoff_ * resolution_);
-        histogram_.init(grid_);
-        rdf_.alloc(grid_);
-    };
+    RDF(const std::vector<Residue> &residues, const double cutoff, const int resolution);
 
+    /** \brief Calculate RDF between selections a and b - must be called before the first frame */
+    void addPair(const std::string &a, const std::string &b);
+
+    /** \brief Add pairs of selected atoms in frame to the RDF histograms.
+    * Uses a cell list so cost is linear in the number of atoms.
+    * \throws std::invalid_argument if the cutoff is more than half the box */
     void calculateRDF(const Frame &frame);
+
+    /** \brief Save or restore accumulated histograms */
+    void checkpoint(Checkpoint &cp);
+
+    /** \brief Normalise RDFs and write to file.
+    * Requested pairs are written to rdf_<a>_<b>.dat with columns r, g(r) and
+    * coordination number.  The default RDF is written to rdf.dat. */
     void normalize();
+
+    /** \brief Radial distribution function of a pair - valid after normalize() */
+    const LightArray<double> &rdf(const int pair=0) const{
+        return rdfs_[pair];
+    }
+
+    /** \brief Coordination number of a pair - valid after normalize() */
+    const LightArray<double> &coordination(const int pair=0) const{
+        return coordination_[pair];
+    }
 };
 
 #endif //CGTOOL_RDF_H
@@ -28,6 +28,8 @@ double end_timer(const double since);
 /** \brief Check if a file exists, if so, rename it.
 *
 * Makes sure we're not overwriting any existing file.
+* Each file is only backed up the first time in a run, so output refreshed
+* during the run is overwritten.
 * Returns true if it's safe to continue */
 bool backup_old_file(const std::string name);
 
@@ -0,0 +1,70 @@
+#ifndef CGTOOL_STRUCTURE_FACTOR_H
+#define CGTOOL_STRUCTURE_FACTOR_H
+
+#include <vector>
+#include <array>
+#include <complex>
+#include <string>
+
+#include "frame.h"
+#include "histogram_nd.h"
+
+/**
+* \brief Static structure factor S(q) of all atoms in a frame.
+*
+* Atoms are spread onto a periodic grid with cubic B-spline weights, the grid
+* is Fourier transformed and |rho(q)|^2, corrected for the spline, is averaged
+* over shells of constant |q|.  Cost is linear in the number of atoms plus
+* N log N in the number of grid points.  Only wavevectors below half of the
+* grid Nyquist frequency are used, where the effect of aliasing is small.
+*/
+class StructureFactor{
+protected:
+    /** Number of grid points along each axis */
+    int grid_ = 64;
+    /** Number of |q| bins */
+    int bins_ = 100;
+
+    int frames_ = 0;
+    /** Sum over frames of number of atoms - S(q) is normalised per atom */
+    double numAtoms_ = 0.;
+
+    /** Sum of |rho(q)|^2 in each |q| shell */
+    HistogramND<double, 1> power_;
+    /** Number of wavevectors sampled in each |q| shell */
+    HistogramND<double, 1> count_;
+    /** Normalised structure factor - valid after normalize() */
+    std::vector<double> sq_;
+
+    /** Density grid - reused between frames */
+    std::vector<std::complex<double>> rho_;
+
+    /** \brief Spread atoms onto rho_ with cubic B-spline weights */
+    void spread(const Frame &frame, const std::array<double, 3> &box);
+
+public:
+    /** \brief Structure factor on grid^3 points binned into bins |q| shells */
+    StructureFactor(const int grid=64, const int bins=100);
+
+    /** \brief Add the structure factor of frame to the average.
+    * Assumes cubic/orthorhombic box.  The |q| range is fixed by the first frame. */
+    void calculate(const Frame &frame);
+
+    /** \brief Save or restore accumulated power spectrum */
+    void checkpoint(Checkpoint &cp);
+
+    /** \brief Normalise and write S(q) to file */
+    void normalize(const std::string &filename="sq.dat");
+
+    /** \brief Structure factor in each |q| bin - valid after normalize() */
+    const std::vector<double> &sq() const{
+        return sq_;
+    }
+
+    /** \brief |q| bins in nm^-1 - valid after the first frame */
+    const HistogramAxis &axis() const{
+        return power_.axis(0);
+    }
+};
+
+#endif //CGTOOL_STRUCTURE_FACTOR_H
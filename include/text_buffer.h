@@ -0,0 +1,72 @@
+#ifndef CGTOOL_TEXT_BUFFER_H
+#define CGTOOL_TEXT_BUFFER_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+* \brief Buffer for formatting text output, written to file in one call.
+*
+* Fields are formatted as by printf with the equivalent format string
+* but without parsing a format for each field.  Fixed point numbers are
+* produced from a rounded integer, falling back to snprintf when the value
+* is too close to a rounding tie or too large for this to be exact.
+*/
+class TextBuffer{
+protected:
+    std::vector<char> data_;
+    size_t size_ = 0;
+
+    /** \brief Make space for n more characters */
+    char *reserve(const size_t n){
+        if(size_ + n > data_.size()) data_.resize(2 * (size_ + n));
+        return data_.data() + size_;
+    }
+
+    /** \brief Right align the last n characters written in width */
+    void pad(const size_t n, const int width);
+
+public:
+    explicit TextBuffer(const size_t capacity=1 << 16){
+        data_.resize(capacity);
+    }
+
+    /** \brief Append a string - %s */
+    void append(const char *str);
+
+    /** \brief Append a string - %<width>s, or %-<width>s if left is true */
+    void append(const std::string &str, const int width, const bool left=false);
+
+    /** \brief Append a character */
+    void append(const char c){
+        *reserve(1) = c;
+        size_++;
+    }
+
+    /** \brief Append an integer - %<width>d */
+    void appendInt(const long value, const int width=0);
+
+    /** \brief Append a fixed point number - %<width>.<precision>f */
+    void appendFixed(const double value, const int width, const int precision);
+
+    /** \brief Append raw bytes - for binary output */
+    void appendBytes(const void *bytes, const size_t n);
+
+    const char *data() const{
+        return data_.data();
+    }
+
+    size_t size() const{
+        return size_;
+    }
+
+    void clear(){
+        size_ = 0;
+    }
+
+    /** \brief Write contents to file in one call and clear.  Returns true on success. */
+    bool write(FILE *file);
+};
+
+#endif //CGTOOL_TEXT_BUFFER_H
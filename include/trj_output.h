@@ -6,8 +6,10 @@
 #define CGTOOL_TRJOUTPUT_H
 
 #include <string>
+#include <stdexcept>
 
 #include "frame.h"
+#include "checkpoint.h"
 
 class TrjOutput{
 protected:
@@ -23,6 +25,9 @@ public:
     /** \brief Write a Frame to output file.  Pure virtual function. */
     virtual int writeFrame(const Frame &frame) = 0;
 
+    /** \brief Save or restore length of output file.  Does not have to be supported. */
+    virtual void checkpoint(Checkpoint &cp){};
+
     /** \brief Empty destructor to be overwritten. */
     virtual ~TrjOutput(){};
 
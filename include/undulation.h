@@ -0,0 +1,80 @@
+#ifndef CGTOOL_UNDULATION_H
+#define CGTOOL_UNDULATION_H
+
+#include <vector>
+#include <array>
+#include <string>
+
+#include "light_array.h"
+#include "histogram_nd.h"
+
+/**
+* \brief Fluctuation spectrum of membrane height and thickness fields.
+*
+* Each frame the fields are Fourier transformed and A |h(q)|^2 is averaged over
+* shells of constant |q|, with h(q) the mean of h(r) exp(-iq.r) over the grid.
+* In the Helfrich model A <|h(q)|^2> = kT / (kappa q^4 + sigma q^2) so the
+* bending modulus kappa and tension sigma are the intercept and slope of
+* kT / <q^4 A |h(q)|^2> against <q^-2>, averaged over each shell.
+*/
+class UndulationSpectrum{
+protected:
+    /** Number of grid points along each axis */
+    int grid_ = 0;
+    /** Number of |q| bins - shells are one reciprocal lattice spacing wide, centred on multiples of it */
+    int bins_ = 0;
+    int frames_ = 0;
+
+    /** Sum of A |h(q)|^2 in each |q| shell */
+    HistogramND<double, 1> height_;
+    /** Sum of A |t(q)|^2 in each |q| shell */
+    HistogramND<double, 1> thickness_;
+    /** Number of wavevectors sampled in each |q| shell */
+    HistogramND<double, 1> count_;
+    /** Sum of |q| of wavevectors in each shell */
+    HistogramND<double, 1> qSum_;
+    /** Sum of q^4 A |h(q)|^2 in each shell - fitting these per wavevector avoids bias from shell width */
+    HistogramND<double, 1> heightQ4_;
+    /** Sum of q^-2 in each shell */
+    HistogramND<double, 1> invQ2_;
+
+public:
+    UndulationSpectrum(){};
+
+    /** \brief Add height and thickness fields on a square grid covering the box in xy.
+    * The |q| range is fixed by the first frame. */
+    void add(const LightArray<double> &height, const LightArray<double> &thickness,
+             const std::array<double, 3> &box);
+
+    /** \brief Save or restore accumulated spectrum */
+    void checkpoint(Checkpoint &cp);
+
+    /** \brief Fit bending modulus and surface tension to shells with q < q_max.
+    * \param kT Thermal energy - kappa is returned in the same units, sigma per nm^2
+    * \return false if fewer than two shells were available */
+    bool fit(const double q_max, const double kT, double &kappa, double &sigma) const;
+
+    /** \brief Mean |q| of wavevectors in shell i */
+    double q(const int i) const;
+
+    /** \brief Mean A |h(q)|^2 in shell i */
+    double height(const int i) const;
+
+    /** \brief Mean A |t(q)|^2 in shell i */
+    double thickness(const int i) const;
+
+    /** \brief |q| bins in nm^-1 - valid after the first frame */
+    const HistogramAxis &axis() const{
+        return count_.axis(0);
+    }
+
+    int frames() const{
+        return frames_;
+    }
+
+    /** \brief Print spectra to file with fitted constants in the header */
+    void print(const std::string &filename, const double q_max, const double kT,
+               const bool header=true) const;
+};
+
+#endif //CGTOOL_UNDULATION_H
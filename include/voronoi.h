@@ -0,0 +1,50 @@
+#ifndef CGTOOL_VORONOI_H
+#define CGTOOL_VORONOI_H
+
+#include <vector>
+#include <array>
+
+#include "checkpoint.h"
+
+/**
+* \brief Periodic 2d Voronoi tessellation of points in the xy plane.
+*
+* Each cell is built independently by clipping the rectangle bounded by the
+* point's own periodic images with the perpendicular bisectors of nearby points,
+* closest first.  Once every vertex is closer to the point than half the search
+* radius no further point can clip the cell, otherwise the radius is doubled.
+* Cells are exact and cost is linear in the number of evenly spread points.
+*/
+class Voronoi{
+protected:
+    /** Area of the cell of each point */
+    std::vector<double> areas_;
+    /** Points sharing an edge with each point's cell */
+    std::vector<std::vector<int>> neighbours_;
+
+public:
+    Voronoi(){};
+
+    /** \brief Tessellate points - z coordinates are ignored.
+    * Assumes orthorhombic box.  Points need not be inside the box. */
+    void tessellate(const std::vector<std::array<double, 3>> &coords,
+                    const std::array<double, 3> &box);
+
+    /** \brief Save or restore the last tessellation */
+    void checkpoint(Checkpoint &cp){
+        cp.sync(areas_);
+        cp.sync(neighbours_);
+    }
+
+    /** \brief Area of the cell of each point - sums to the area of the box */
+    const std::vector<double> &areas() const{
+        return areas_;
+    }
+
+    /** \brief Indices of points sharing an edge with each point's cell - sorted */
+    const std::vector<std::vector<int>> &neighbours() const{
+        return neighbours_;
+    }
+};
+
+#endif //CGTOOL_VORONOI_H
@@ -74,6 +74,8 @@
 #ifndef _XDRFILE_H_
 #define _XDRFILE_H_
 
+#include <stdio.h>
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -125,6 +127,23 @@ XDRFILE *
         const char *mode);
 
 
+/*! \brief Use an already open C stream as a portable binary file
+ *
+ *  The stream may be any FILE handle, e.g. from open_memstream() to
+ *  encode data in memory.  It belongs to the returned handle and is
+ *  closed by xdrfile_close().
+ *
+ *  \param fp    Open stream
+ *  \param mode  "r" for reading, "w" for writing, "a" for append.
+ *
+ *  \return Pointer to abstract xdr file datatype, or NULL if an error occurs.
+ *
+ */
+XDRFILE *
+        xdrfile_open_stream(FILE *fp,
+        const char *mode);
+
+
 /*! \brief Close a previously opened portable binary file, just like fclose()
  *
  *  Use this routine much like calls to the standard library function
@@ -139,6 +158,30 @@ int
         xdrfile_close(XDRFILE *xfp);
 
 
+/*! \brief Get the current position in a portable binary file, just like ftell()
+ *
+ *  \param xfp  Pointer to an abstract XDRFILE datatype
+ *
+ *  \return     Offset in bytes from the start of the file, or -1 on error.
+ */
+long
+        xdrfile_tell(XDRFILE *xfp);
+
+
+/*! \brief Move to a position in a portable binary file, just like fseek()
+ *
+ *  \param xfp     Pointer to an abstract XDRFILE datatype
+ *  \param offset  Offset in bytes relative to whence
+ *  \param whence  SEEK_SET, SEEK_CUR or SEEK_END
+ *
+ *  \return     0 on success, non-zero on error.
+ */
+int
+        xdrfile_seek(XDRFILE *xfp,
+        long offset,
+        int whence);
+
+
 /*! \brief Read one or more \a char type variable(s)
  *
  *  \param ptr    Pointer to memory where data should be written
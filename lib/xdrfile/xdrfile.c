@@ -240,6 +240,34 @@ xdrfile_open(const char *path, const char *mode){
     return xfp;
 }
 
+XDRFILE *
+xdrfile_open_stream(FILE *fp, const char *mode){
+    enum xdr_op xdrmode;
+    XDRFILE *xfp;
+
+    if(fp == NULL)
+        return NULL;
+    if(*mode == 'w' || *mode == 'W' || *mode == 'a' || *mode == 'A'){
+        xdrmode = XDR_ENCODE;
+    } else if(*mode == 'r' || *mode == 'R'){
+        xdrmode = XDR_DECODE;
+    } else /* cannot determine mode */
+        return NULL;
+
+    if((xfp = (XDRFILE *) malloc(sizeof(XDRFILE))) == NULL)
+        return NULL;
+    if((xfp->xdr = (XDR *) malloc(sizeof(XDR))) == NULL){
+        free(xfp);
+        return NULL;
+    }
+    xfp->fp = fp;
+    xfp->mode = *mode;
+    xdrstdio_create((XDR *) (xfp->xdr), xfp->fp, xdrmode);
+    xfp->buf1 = xfp->buf2 = NULL;
+    xfp->buf1size = xfp->buf2size = 0;
+    return xfp;
+}
+
 int
 xdrfile_close(XDRFILE *xfp){
     int ret = exdrCLOSE;
@@ -259,6 +287,21 @@ xdrfile_close(XDRFILE *xfp){
     return ret; /* return 0 if ok */
 }
 
+long
+xdrfile_tell(XDRFILE *xfp){
+    if(xfp == NULL)
+        return -1;
+    return ftell(xfp->fp);
+}
+
+int
+xdrfile_seek(XDRFILE *xfp, long offset, int whence){
+    if(xfp == NULL)
+        return -1;
+    /* stdio XDR streams keep no state of their own so seeking the file is enough */
+    return fseek(xfp->fp, offset, whence);
+}
+
 
 int
 xdrfile_read_int(int *ptr, int ndata, XDRFILE *xfp){
@@ -37,19 +37,21 @@ int GROOutput::closeFile(){
 }
 
 int GROOutput::writeFrame(const Frame &frame){
-    // Print atoms
+    // Print atoms - equivalent to "%5d%-5s%5s%5d%8.3f%8.3f%8.3f\n"
     Residue &res = frame.residues_[0];
     for(int i=0; i < natoms_; i++){
         const Atom &atom = frame.atoms_[i];
-        fprintf(file_, "%5d%-5s%5s%5d%8.3f%8.3f%8.3f\n",
-                1+(i/res.num_atoms), res.resname.c_str(),
-                atom.atom_name.c_str(), i+1,
-                atom.coords[0], atom.coords[1], atom.coords[2]);
+        buffer_.appendInt(1+(i/res.num_atoms), 5);
+        buffer_.append(res.resname, 5, true);
+        buffer_.append(atom.atom_name, 5);
+        buffer_.appendInt(i+1, 5);
+        for(int j=0; j<3; j++) buffer_.appendFixed(atom.coords[j], 8, 3);
+        buffer_.append('\n');
     }
 
     // Print box
-    fprintf(file_, "%10.5f%10.5f%10.5f\n",
-            frame.box_[0][0], frame.box_[1][1], frame.box_[2][2]);
+    for(int j=0; j<3; j++) buffer_.appendFixed(frame.box_[j][j], 10, 5);
+    buffer_.append('\n');
 
-    return 0;
+    return buffer_.write(file_) ? 0 : 1;
 }
@@ -61,18 +61,34 @@ int LammpsDataOutput::writeFrame(const Frame &frame){
     fprintf(file_, "        %8.3f %8.3f    zlo zhi\n\n", -box[2], box[2]);
 
     fprintf(file_, "Atoms\n");
+    // Equivalent to " %6d %4d %10.4f %10.4f %10.4f %6d %6.2f %9.5f %9.5f %9.5f %4.1f %4.1f\n"
     for(int i=0; i < natoms_; i++){
         const Atom &atom = frame.atoms_[i];
         //TODO change 2nd column to actual atom type number
-        fprintf(file_, " %6d %4d %10.4f %10.4f %10.4f %6d %6.2f %9.5f %9.5f %9.5f %4.1f %4.1f\n",
-                i+1, i+1,
-                10*atom.coords[0]-box[0], 10*atom.coords[1]-box[1], 10*atom.coords[2]-box[2],
-                atom.resnum, atom.charge,
-                10*atom.dipole[0], 10*atom.dipole[1], 10*atom.dipole[2],
-                3.f, 2.7f);
+        buffer_.append(' ');
+        buffer_.appendInt(i+1, 6);
+        buffer_.append(' ');
+        buffer_.appendInt(i+1, 4);
+        for(int j=0; j<3; j++){
+            buffer_.append(' ');
+            buffer_.appendFixed(10*atom.coords[j]-box[j], 10, 4);
+        }
+        buffer_.append(' ');
+        buffer_.appendInt(atom.resnum, 6);
+        buffer_.append(' ');
+        buffer_.appendFixed(atom.charge, 6, 2);
+        for(int j=0; j<3; j++){
+            buffer_.append(' ');
+            buffer_.appendFixed(10*atom.dipole[j], 9, 5);
+        }
+        buffer_.append(' ');
+        buffer_.appendFixed(3.f, 4, 1);
+        buffer_.append(' ');
+        buffer_.appendFixed(2.7f, 4, 1);
+        buffer_.append('\n');
     }
 
     //TODO Print bond types
 
-    return 0;
+    return buffer_.write(file_) ? 0 : 1;
 }
@@ -5,12 +5,19 @@
 #include "LammpsTrjOutput.h"
 
 #include <cstdio>
+#include <cstdint>
+#include <cstring>
 
 #include "small_functions.h"
 
 using std::string;
 
-LammpsTrjOutput::LammpsTrjOutput(const int natoms, const string &filename){
+/** \brief Columns written for each atom. */
+static const char *columns = "id type mol x y z mux muy muz mass diameter";
+static const int num_columns = 11;
+
+LammpsTrjOutput::LammpsTrjOutput(const int natoms, const string &filename, const bool binary) :
+        binary_(binary){
     natoms_ = natoms;
     if(openFile(filename))
         throw std::runtime_error("ERROR: Could not open Lammps Trj file for writing");
@@ -21,8 +28,7 @@ LammpsTrjOutput::~LammpsTrjOutput(){
 }
 
 int LammpsTrjOutput::openFile(const string &filename){
-    backup_old_file(filename);
-    file_ = std::fopen(filename.c_str(), "w");
+    file_ = open_stream_file(filename, binary_);
     if(!file_) return 1;
     return 0;
 }
@@ -34,6 +40,15 @@ int LammpsTrjOutput::closeFile(){
 }
 
 int LammpsTrjOutput::writeFrame(const Frame &frame){
+    if(binary_){
+        formatBinary(frame);
+    }else{
+        formatText(frame);
+    }
+    return buffer_.write(file_) ? 0 : 1;
+}
+
+void LammpsTrjOutput::formatText(const Frame &frame){
     // Have to multiply all coords by 10 - Gromacs is in A, Lammps in nm
     double box[3];
     for(int i=0; i<3; i++){
@@ -41,20 +56,102 @@ int LammpsTrjOutput::writeFrame(const Frame &frame){
     }
 
     // Print headers
-    fprintf(file_, "ITEM: TIMESTEP\n%d\n", frame.num_);
-    fprintf(file_, "ITEM: NUMBER OF ATOMS\n%d\n", frame.numAtoms_);
-    fprintf(file_, "ITEM: BOX BOUNDS pp pp pp\n%f %f\n%f %f\n%f %f\n",
-            -box[0], box[0], -box[1], box[1], -box[2], box[2]);
-    fprintf(file_, "ITEM: ATOMS id type mol x y z mux muy muz mass diameter\n");
+    buffer_.append("ITEM: TIMESTEP\n");
+    buffer_.appendInt(frame.num_);
+    buffer_.append("\nITEM: NUMBER OF ATOMS\n");
+    buffer_.appendInt(frame.numAtoms_);
+    buffer_.append("\nITEM: BOX BOUNDS pp pp pp\n");
+    for(int i=0; i<3; i++){
+        buffer_.appendFixed(-box[i], 0, 6);
+        buffer_.append(' ');
+        buffer_.appendFixed(box[i], 0, 6);
+        buffer_.append('\n');
+    }
+    buffer_.append("ITEM: ATOMS ");
+    buffer_.append(columns);
+    buffer_.append('\n');
+
+    // Equivalent to " %6d %4d %4d %10.4f %10.4f %10.4f %9.5f %9.5f %9.5f %4.1f %4.1f\n"
+    for(int i=0; i < natoms_; i++){
+        const Atom &atom = frame.atoms_[i];
+        buffer_.append(' ');
+        buffer_.appendInt(i+1, 6);
+        buffer_.append(' ');
+        buffer_.appendInt(i+1, 4);
+        buffer_.append(' ');
+        buffer_.appendInt(1, 4);
+        for(int j=0; j<3; j++){
+            buffer_.append(' ');
+            buffer_.appendFixed(10*atom.coords[j]-box[j], 10, 4);
+        }
+        for(int j=0; j<3; j++){
+            buffer_.append(' ');
+            buffer_.appendFixed(10*atom.dipole[j], 9, 5);
+        }
+        buffer_.append(' ');
+        buffer_.appendFixed(atom.mass, 4, 1);
+        buffer_.append(' ');
+        buffer_.appendFixed(2.7f, 4, 1);
+        buffer_.append('\n');
+    }
+}
+
+void LammpsTrjOutput::formatBinary(const Frame &frame){
+    double box[3];
+    for(int i=0; i<3; i++){
+        box[i] = 10 * frame.box_[i][i] / 2;
+    }
+
+    // Header of revision 2 of the LAMMPS binary dump format - see LAMMPS tools/binary2txt.cpp
+    // Sizes are those of LAMMPS' default build - bigint is int64, all other integers int32
+    const std::int64_t magic_length = 8;
+    const std::int64_t marker = -magic_length;
+    const std::int32_t endian = 0x0001;
+    const std::int32_t revision = 0x0002;
+    const std::int64_t timestep = frame.num_;
+    const std::int64_t natoms = natoms_;
+    const std::int32_t triclinic = 0;
+    // Periodic in all directions
+    const std::int32_t boundary[6] = {0, 0, 0, 0, 0, 0};
+    const double bounds[6] = {-box[0], box[0], -box[1], box[1], -box[2], box[2]};
+    const std::int32_t size_one = num_columns;
+    const std::int32_t unit_style_length = 0;
+    const char time_flag = 1;
+    const double time = frame.time_;
+    const std::int32_t columns_length = static_cast<std::int32_t>(std::strlen(columns));
+    // All atoms are written as a single chunk
+    const std::int32_t num_chunks = 1;
+    const std::int32_t chunk_size = natoms_ * num_columns;
+
+    buffer_.appendBytes(&marker, sizeof(marker));
+    buffer_.appendBytes("DUMPATOM", magic_length);
+    buffer_.appendBytes(&endian, sizeof(endian));
+    buffer_.appendBytes(&revision, sizeof(revision));
+    buffer_.appendBytes(&timestep, sizeof(timestep));
+    buffer_.appendBytes(&natoms, sizeof(natoms));
+    buffer_.appendBytes(&triclinic, sizeof(triclinic));
+    buffer_.appendBytes(boundary, sizeof(boundary));
+    buffer_.appendBytes(bounds, sizeof(bounds));
+    buffer_.appendBytes(&size_one, sizeof(size_one));
+    buffer_.appendBytes(&unit_style_length, sizeof(unit_style_length));
+    buffer_.appendBytes(&time_flag, sizeof(time_flag));
+    buffer_.appendBytes(&time, sizeof(time));
+    buffer_.appendBytes(&columns_length, sizeof(columns_length));
+    buffer_.appendBytes(columns, columns_length);
+    buffer_.appendBytes(&num_chunks, sizeof(num_chunks));
+    buffer_.appendBytes(&chunk_size, sizeof(chunk_size));
 
     for(int i=0; i < natoms_; i++){
         const Atom &atom = frame.atoms_[i];
-        fprintf(file_, " %6d %4d %4d %10.4f %10.4f %10.4f %9.5f %9.5f %9.5f %4.1f %4.1f\n",
-                i+1, i+1, 1,
+        const double values[num_columns] = {
+                static_cast<double>(i+1), static_cast<double>(i+1), 1.,
                 10*atom.coords[0]-box[0], 10*atom.coords[1]-box[1], 10*atom.coords[2]-box[2],
                 10*atom.dipole[0], 10*atom.dipole[1], 10*atom.dipole[2],
-                atom.mass, 2.7f);
+                atom.mass, 2.7};
+        buffer_.appendBytes(values, sizeof(values));
     }
+}
 
-    return 0;
+void LammpsTrjOutput::checkpoint(Checkpoint &cp){
+    cp.syncFile(file_);
 }
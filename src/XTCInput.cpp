@@ -71,4 +71,15 @@ int XTCInput::readFrame(Frame &frame){
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+long XTCInput::tell() const{
+    return xdrfile_tell(file_);
+}
+
+void XTCInput::seek(const long pos){
+    // Seeking past the end would succeed but leave nothing to read
+    if(xdrfile_seek(file_, 0, SEEK_END) != 0 || xdrfile_tell(file_) < pos ||
+       xdrfile_seek(file_, pos, SEEK_SET) != 0)
+        throw std::runtime_error("Could not seek in input XTC - has it been truncated?");
+}
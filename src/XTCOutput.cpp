@@ -4,49 +4,151 @@
 
 #include "XTCOutput.h"
 
+#include <cstdlib>
+
 #include "xdrfile_xtc.h"
 
 #include "small_functions.h"
 
 using std::string;
+using std::vector;
+
+XTCOutput::Job::~Job(){
+    free(data);
+}
 
-XTCOutput::XTCOutput(const int natoms, const string &filename){
-    natoms_ = natoms;
-    x_ = new rvec[natoms_];
+XTCOutput::XTCOutput(const int natoms, const string &filename, const float precision,
+                     const vector<int> &atoms, const int threads) :
+        precision_(precision), atoms_(atoms){
+    for(const int atom : atoms_){
+        if(atom < 0 || atom >= natoms) throw std::out_of_range("Output atom is not in frame");
+    }
+    natoms_ = atoms_.empty() ? natoms : static_cast<int>(atoms_.size());
     openFile(filename);
+
+    // Hold enough frames to keep every worker busy while the oldest is written
+    if(threads > 0) maxPending_ = 2 * threads;
+    for(int i=0; i<threads; i++) workers_.emplace_back(&XTCOutput::worker, this);
 }
 
 XTCOutput::~XTCOutput(){
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    workCv_.notify_all();
+    for(std::thread &thread : workers_) thread.join();
+
+    commitFrames(0);
     closeFile();
-    if(x_) delete[] x_;
 }
 
 int XTCOutput::openFile(const string &filename){
-    backup_old_file(filename);
-    file_ = xdrfile_open(filename.c_str(), "w");
+    file_ = open_stream_file(filename, true);
     if(file_) return 0;
     return 1;
 }
 
 int XTCOutput::closeFile(){
-    if(file_) xdrfile_close(file_);
+    if(file_) fclose(file_);
     if(!file_) return 0;
     return 1;
 }
 
+void XTCOutput::encode(Job &job) const{
+    FILE *stream = open_memstream(&job.data, &job.size);
+    XDRFILE *xd = xdrfile_open_stream(stream, "w");
+    if(xd == nullptr){
+        if(stream) fclose(stream);
+        job.status = exdrFILENOTFOUND;
+        return;
+    }
+    job.status = write_xtc(xd, natoms_, job.step, job.time, job.box,
+                           reinterpret_cast<rvec *>(job.x.data()), precision_);
+    // Closing the stream finalises data and size
+    xdrfile_close(xd);
+}
+
+void XTCOutput::worker(){
+    while(true){
+        Job *job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            workCv_.wait(lock, [this]{return stop_ || !queue_.empty();});
+            // Finish queued frames before stopping
+            if(queue_.empty()) return;
+            job = queue_.front();
+            queue_.pop_front();
+        }
+
+        encode(*job);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            job->done = true;
+        }
+        doneCv_.notify_all();
+    }
+}
+
+int XTCOutput::commitFrames(const size_t max_pending){
+    int status = 0;
+    while(true){
+        std::unique_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if(pending_.empty()) break;
+            if(!pending_.front()->done){
+                if(pending_.size() <= max_pending) break;
+                doneCv_.wait(lock, [this]{return pending_.front()->done;});
+            }
+            job = std::move(pending_.front());
+            pending_.pop_front();
+        }
+
+        if(job->status != exdrOK || fwrite(job->data, 1, job->size, file_) != job->size) status = 1;
+    }
+    return status;
+}
+
 int XTCOutput::writeFrame(const Frame &frame){
+    std::unique_ptr<Job> job(new Job);
     for(int i=0; i<3; i++){
         for(int j=0; j<3; j++){
-            box_[i][j] = frame.box_[i][j];
+            job->box[i][j] = frame.box_[i][j];
         }
     }
 
+    job->x.resize(3 * natoms_);
     for(int i=0; i<natoms_; i++){
-        x_[i][0] = float(frame.atoms_[i].coords[0]);
-        x_[i][1] = float(frame.atoms_[i].coords[1]);
-        x_[i][2] = float(frame.atoms_[i].coords[2]);
+        const int atom = atoms_.empty() ? i : atoms_[i];
+        job->x[3*i  ] = float(frame.atoms_[atom].coords[0]);
+        job->x[3*i+1] = float(frame.atoms_[atom].coords[1]);
+        job->x[3*i+2] = float(frame.atoms_[atom].coords[2]);
     }
+    job->step = frame.step_;
+    job->time = frame.time_;
 
-    return exdrOK == write_xtc(file_, natoms_, frame.step_,
-                               frame.time_, box_, x_, 500.f);
-}
\ No newline at end of file
+    // No workers - compress here
+    if(workers_.empty()){
+        encode(*job);
+        job->done = true;
+        pending_.push_back(std::move(job));
+        return commitFrames(0);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(job.get());
+        pending_.push_back(std::move(job));
+    }
+    workCv_.notify_one();
+
+    // Write any frames which are ready, waiting if too many are held
+    return commitFrames(maxPending_ - 1);
+}
+
+void XTCOutput::checkpoint(Checkpoint &cp){
+    if(commitFrames(0)) throw std::runtime_error("Could not write XTC frame before checkpoint");
+    cp.syncFile(file_);
+}
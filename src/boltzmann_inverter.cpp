@@ -2,20 +2,24 @@
 
 #include <iostream>
 #include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "fft.h"
+#include "small_functions.h"
 
 using std::cout;
 using std::endl;
 using std::vector;
+using std::array;
 
 BoltzmannInverter::BoltzmannInverter(const double temp, const int bins) :
                    temp_(temp), bins_(bins){
-    histogram_.init(bins_);
     gaussian_.alloc(bins_);
     harmonic_.alloc(bins_);
 }
 
 void BoltzmannInverter::calculate(BondStruct &bond){
-    histogram_.zero();
     gaussian_.zero();
     harmonic_.zero();
     n_ = bond.values_.size();
@@ -28,20 +32,24 @@ void BoltzmannInverter::calculate(BondStruct &bond){
 }
 
 double BoltzmannInverter::invertGaussianSimple(){
+    return harmonicConstant(mean_, sdev_);
+}
+
+double BoltzmannInverter::harmonicConstant(const double mean, const double sdev) const{
     const double RT = 8.314 * temp_ / 1000.;
 
     switch(type_){
         case BondType::LENGTH:
-            return RT / (sdev_*sdev_);
+            return RT / (sdev*sdev);
         case BondType::ANGLE:{
-            const double sinmean = sin(mean_ * M_PI / 180.);
-            const double sdevrad = sdev_ * M_PI / 180.;
+            const double sinmean = sin(mean * M_PI / 180.);
+            const double sdevrad = sdev * M_PI / 180.;
             return RT / (sinmean * sinmean * sdevrad * sdevrad);
         }
         case BondType::DIHEDRAL:{
             // Assumes multiplicity 1 - CG tends to be
-            // TODO try FFT to account for other multiplicities
-            const double sdevrad = sdev_ * M_PI / 180.;
+            // Other multiplicities are handled by fitDihedralSeries
+            const double sdevrad = sdev * M_PI / 180.;
             return RT / (sdevrad * sdevrad);
         }
     }
@@ -54,11 +62,11 @@ void BoltzmannInverter::binHistogram(const vector<double> &vec){
     step_ = (max_ - min_) / (bins_-1);
     meanBin_ = static_cast<int>((mean_ - min_) / step_);
 
-    int loc = 0;
-    for(const double val : vec){
-        loc = static_cast<int>((val - min_) / step_);
-        histogram_.increment(loc);
-    }
+    // Bins start at min_ so the maximum falls in the last bin
+    // A constant value gives zero width - put it all in one bin
+    const double width = step_ > 0. ? step_ : 1.;
+    histogram_.init({{HistogramAxis::fromWidth(min_, width, bins_)}});
+    histogram_.addBatch({{vec.data()}}, static_cast<int>(vec.size()));
 }
 
 double BoltzmannInverter::gaussianRSquared(){
@@ -119,3 +127,306 @@ double BoltzmannInverter::statisticalMoments(const vector<double> &vec){
     return mean_;
 }
 
+
+vector<double> BoltzmannInverter::kernelDensity(const vector<double> &vec, const double lo,
+                                                const double step, const int points,
+                                                const bool periodic, const double scale) const{
+    vector<double> density(points, 0.);
+    int n_in = 0;
+    for(const double val : vec){
+        int loc = nint((val - lo) / step);
+        if(periodic) loc = wrap(loc, 0, points);
+        if(loc < 0 || loc >= points) continue;
+        density[loc] += 1.;
+        n_in++;
+    }
+    if(n_in == 0) return density;
+
+    // Silverman's rule of thumb - bandwidth can't be smaller than a bin
+    const double bandwidth = std::max(step, scale * 1.06 * sdev_ * pow(n_in, -0.2));
+    const int half_width = std::min(static_cast<int>(ceil(4. * bandwidth / step)), points);
+    vector<double> kernel(half_width + 1);
+    double norm = 0.;
+    for(int i=0; i<=half_width; i++){
+        const double u = i * step / bandwidth;
+        kernel[i] = exp(-0.5 * u * u);
+        norm += i == 0 ? kernel[i] : 2. * kernel[i];
+    }
+    for(double &k : kernel) k /= norm * n_in * step;
+
+    fft_convolve(density, kernel, periodic);
+    return density;
+}
+
+void BoltzmannInverter::tabulate(BondStruct &bond, const double bandwidth_scale) const{
+    const double RT = 8.314 * temp_ / 1000.;
+
+    // Table ranges are those expected by GROMACS for each bond type
+    double lo = 0., step = 0.;
+    int points = 0;
+    bool periodic = false;
+    double force_scale = 1.;
+    switch(bond.type_){
+        case BondType::LENGTH:
+            step = 0.001;
+            points = static_cast<int>(ceil(3. * max_ / step)) + 1;
+            break;
+        case BondType::ANGLE:
+            step = 0.5;
+            points = 361;
+            force_scale = 180. / M_PI;
+            break;
+        case BondType::DIHEDRAL:
+            lo = -180.;
+            step = 1.;
+            points = 361;
+            periodic = true;
+            force_scale = 180. / M_PI;
+            break;
+    }
+
+    // Last dihedral point duplicates the first - work over the unique points only
+    const int n = periodic ? points - 1 : points;
+    vector<double> prob = kernelDensity(bond.values_, lo, step, n, periodic,
+                                        bandwidth_scale);
+
+    // Remove the Jacobian of the coordinate before inversion
+    for(int i=0; i<n; i++){
+        const double x = lo + i * step;
+        switch(bond.type_){
+            case BondType::LENGTH:
+                prob[i] = x > 0. ? prob[i] / (x * x) : 0.;
+                break;
+            case BondType::ANGLE:{
+                const double sin_x = sin(x * M_PI / 180.);
+                prob[i] = sin_x > 1e-6 ? prob[i] / sin_x : 0.;
+                break;
+            }
+            case BondType::DIHEDRAL:
+                break;
+        }
+    }
+
+    double p_max = 0.;
+    for(const double p : prob) p_max = std::max(p_max, p);
+
+    // Unsampled regions are walled off harmonically from the nearest sampled point
+    // Periodic coordinates sweep twice round so distances wrap
+    const double p_min = 1e-3 * p_max;
+    const double v_cap = -RT * log(1e-3);
+    const double k_wall = var_ > 0. ? RT / var_ : RT;
+    const double inf = std::numeric_limits<double>::infinity();
+    const int sweep = periodic ? 2 * n : n;
+    vector<double> dist_valid(n, inf);
+    double last = -inf;
+    for(int j=0; j<sweep; j++){
+        const int i = j % n;
+        if(prob[i] > p_min) last = j;
+        dist_valid[i] = std::min(dist_valid[i], j - last);
+    }
+    last = inf;
+    for(int j=sweep-1; j>=0; j--){
+        const int i = j % n;
+        if(prob[i] > p_min) last = j;
+        dist_valid[i] = std::min(dist_valid[i], last - j);
+    }
+
+    vector<double> pot(n, 0.);
+    double v_min = inf;
+    for(int i=0; i<n; i++){
+        if(prob[i] > p_min){
+            pot[i] = -RT * log(prob[i] / p_max);
+        }else if(p_max > 0.){
+            const double d = dist_valid[i] * step;
+            pot[i] = v_cap + 0.5 * k_wall * d * d;
+        }
+        v_min = std::min(v_min, pot[i]);
+    }
+
+    // Central differences, wrapping if periodic, one sided at the ends otherwise
+    bond.table_.assign(points, array<double, 3>{{0., 0., 0.}});
+    for(int i=0; i<n; i++){
+        int prev = i - 1, next = i + 1;
+        if(periodic){
+            prev = (prev + n) % n;
+            next = next % n;
+        }else{
+            prev = std::max(prev, 0);
+            next = std::min(next, n - 1);
+        }
+        const double dx = periodic ? 2. * step : (next - prev) * step;
+        bond.table_[i][0] = lo + i * step;
+        bond.table_[i][1] = pot[i] - v_min;
+        bond.table_[i][2] = -force_scale * (pot[next] - pot[prev]) / dx;
+    }
+
+    if(periodic){
+        bond.table_[n] = bond.table_[0];
+        bond.table_[n][0] = lo + n * step;
+    }
+}
+
+double BoltzmannInverter::fitMixtureEM(vector<GaussianMode> &modes, const int k) const{
+    vector<double> x(bins_), count(bins_);
+    for(int i=0; i<bins_; i++){
+        x[i] = min_ + (i + 0.5) * step_;
+        count[i] = histogram_.at(i);
+    }
+
+    // Start from means at evenly spaced quantiles so the fit is deterministic
+    modes.assign(k, GaussianMode());
+    int bin = 0;
+    double cumulative = 0.;
+    for(int j=0; j<k; j++){
+        const double target = (j + 0.5) * n_ / k;
+        while(bin < bins_ - 1 && cumulative + count[bin] < target) cumulative += count[bin++];
+        modes[j].weight = 1. / k;
+        modes[j].mean = x[bin];
+        modes[j].sdev = sdev_ / k;
+    }
+
+    // Don't let a component collapse onto a single bin
+    const double min_var = 0.25 * step_ * step_;
+    const int max_iter = 500;
+    const double tol = 1e-8;
+
+    vector<double> resp(bins_ * k);
+    double log_like = -std::numeric_limits<double>::infinity();
+    for(int iter=0; iter<max_iter; iter++){
+        // Expectation - responsibility of each component for each bin
+        double new_log_like = 0.;
+        for(int i=0; i<bins_; i++){
+            double total = 0.;
+            for(int j=0; j<k; j++){
+                const double z = (x[i] - modes[j].mean) / modes[j].sdev;
+                const double p = modes[j].weight * exp(-0.5 * z * z) / (modes[j].sdev * sqrt(2. * M_PI));
+                resp[i*k + j] = p;
+                total += p;
+            }
+            if(total <= 0.) total = std::numeric_limits<double>::min();
+            for(int j=0; j<k; j++) resp[i*k + j] /= total;
+            if(count[i] > 0.) new_log_like += count[i] * log(total * step_);
+        }
+
+        // Maximisation - weighted moments of each component
+        for(int j=0; j<k; j++){
+            double norm = 0., sum = 0.;
+            for(int i=0; i<bins_; i++){
+                const double w = count[i] * resp[i*k + j];
+                norm += w;
+                sum += w * x[i];
+            }
+            if(norm <= 0.) continue;
+            const double mean = sum / norm;
+            double var = 0.;
+            for(int i=0; i<bins_; i++){
+                const double dev = x[i] - mean;
+                var += count[i] * resp[i*k + j] * dev * dev;
+            }
+            modes[j].weight = norm / n_;
+            modes[j].mean = mean;
+            modes[j].sdev = sqrt(std::max(var / norm, min_var));
+        }
+
+        const bool converged = fabs(new_log_like - log_like) <= tol * fabs(new_log_like);
+        log_like = new_log_like;
+        if(converged) break;
+    }
+
+    return log_like;
+}
+
+void BoltzmannInverter::fitModes(BondStruct &bond, const int max_modes) const{
+    bond.modes_.clear();
+    if(n_ < 2 || step_ <= 0.) return;
+
+    double best_bic = std::numeric_limits<double>::infinity();
+    vector<GaussianMode> modes;
+    for(int k=1; k<=max_modes; k++){
+        const double log_like = fitMixtureEM(modes, k);
+        // Each component has a weight, mean and sdev - weights are constrained to sum to one
+        const int params = 3 * k - 1;
+        const double bic = -2. * log_like + params * log(static_cast<double>(n_));
+        if(bic < best_bic){
+            best_bic = bic;
+            bond.modes_ = modes;
+        }
+    }
+
+    std::sort(bond.modes_.begin(), bond.modes_.end(),
+              [](const GaussianMode &a, const GaussianMode &b){return a.mean < b.mean;});
+    for(GaussianMode &mode : bond.modes_){
+        mode.forceConstant = harmonicConstant(mode.mean, mode.sdev);
+    }
+}
+
+void BoltzmannInverter::fitDihedralSeries(BondStruct &bond, const int max_mult,
+                                          const double min_frac) const{
+    bond.terms_.clear();
+    bond.rbCoeffs_.fill(0.);
+    if(bond.type_ != BondType::DIHEDRAL || n_ == 0) return;
+
+    const double RT = 8.314 * temp_ / 1000.;
+
+    // One degree bins starting at -180 - same grid as the tabulated potential
+    const int points = 360;
+    const double lo = -180.;
+    const double step = 360. / points;
+    // Silverman's rule over-smooths multimodal data so narrow the kernel
+    vector<double> prob = kernelDensity(bond.values_, lo, step, points, true, 0.25);
+
+    double p_max = 0.;
+    for(const double p : prob) p_max = std::max(p_max, p);
+    if(p_max <= 0.) return;
+
+    // Cap the free energy in unsampled regions so the series is well behaved
+    const double p_min = 1e-3 * p_max;
+    vector<std::complex<double>> energy(points);
+    for(int i=0; i<points; i++){
+        energy[i] = -RT * log(std::max(prob[i], p_min) / p_max);
+    }
+
+    const FFT fft(points);
+    fft.forward(energy);
+
+    // F(phi) = a_0 + sum a_n cos(n phi) + b_n sin(n phi)
+    // Grid starts at phi = -pi so coefficient n picks up a factor (-1)^n
+    const int num_harmonics = std::max(max_mult, 5);
+    vector<double> a(num_harmonics + 1), b(num_harmonics + 1);
+    for(int n=0; n<=num_harmonics; n++){
+        const std::complex<double> c = (n % 2 ? -1. : 1.) * energy[n] / static_cast<double>(points);
+        a[n] = n == 0 ? c.real() : 2. * c.real();
+        b[n] = n == 0 ? 0. : -2. * c.imag();
+    }
+
+    // a_n cos(n phi) + b_n sin(n phi) = k (1 + cos(n phi - phi_s)) - k
+    double amp_max = 0.;
+    for(int n=1; n<=max_mult; n++) amp_max = std::max(amp_max, sqrt(a[n]*a[n] + b[n]*b[n]));
+    for(int n=1; n<=max_mult; n++){
+        const double amp = sqrt(a[n]*a[n] + b[n]*b[n]);
+        if(amp <= 0. || amp < min_frac * amp_max) continue;
+        DihedralTerm term;
+        term.multiplicity = n;
+        term.forceConstant = amp;
+        term.phase = atan2(b[n], a[n]) * 180. / M_PI;
+        bond.terms_.push_back(term);
+    }
+
+    // Ryckaert-Bellemans uses powers of cos(psi) with psi = phi - 180 so can't
+    // represent sine terms.  cos(n phi) = T_n(cos phi) = T_n(-cos psi)
+    array<array<double, 6>, 6> cheb;
+    for(auto &row : cheb) row.fill(0.);
+    cheb[0][0] = 1.;
+    cheb[1][1] = 1.;
+    for(int n=2; n<6; n++){
+        for(int m=0; m<6; m++){
+            cheb[n][m] = -cheb[n-2][m];
+            if(m > 0) cheb[n][m] += 2. * cheb[n-1][m-1];
+        }
+    }
+    for(int m=0; m<6; m++){
+        double sum = 0.;
+        for(int n=0; n<6; n++) sum += a[n] * cheb[n][m];
+        bond.rbCoeffs_[m] = m % 2 ? -sum : sum;
+    }
+}
@@ -5,12 +5,14 @@
 #include <sstream>
 #include <ctime>
 #include <cmath>
+#include <stdexcept>
 
 #include <boost/algorithm/string.hpp>
 
 #include "parser.h"
 #include "boltzmann_inverter.h"
 #include "small_functions.h"
+#include "histogram_nd.h"
 
 using std::vector;
 using std::string;
@@ -21,6 +23,7 @@ using std::fprintf;
 BondSet::BondSet(const string &cfgname, const vector<Residue> &residues,
                  const PotentialType potentials[3], const double temp) :
         residues_(residues), temp_(temp){
+    for(int i=0; i<3; i++) potentials_[i] = potentials[i];
     fromFile(cfgname);
 }
 
@@ -61,6 +64,15 @@ void BondSet::fromFile(const string &filename){
         dihedrals_.back().atomNums_[2] = beadNums_[tokens[2]];
         dihedrals_.back().atomNums_[3] = beadNums_[tokens[3]];
     }
+
+    // Angle and dihedral numbers counting from zero in order of the sections
+    while(parser.getLineFromSection("correlation", tokens, 2)){
+        const int a = std::stoi(tokens[0]);
+        const int d = std::stoi(tokens[1]);
+        if(a < 0 || a >= angles_.size() || d < 0 || d >= dihedrals_.size())
+            throw std::runtime_error("Correlation refers to angle or dihedral which does not exist");
+        correlations_.push_back({{a, d}});
+    }
 }
 
 void BondSet::calcBondsInternal(Frame &frame){
@@ -98,17 +110,109 @@ void BondSet::calcBondsInternal(Frame &frame){
 
 // Angles can't just be averaged like this - they wrap around
 // Fine as approximation though, we won't deal much with angles close to 0
-void BondSet::BoltzmannInversion(){
+void BondSet::BoltzmannInversion(const bool tabulate, const double bandwidth_scale,
+                                 const int max_modes){
     if(numMeasures_ > 0){
         printf("Measured %'d molecules\n", numMeasures_);
     }else{
         printf("No bonds measured\n");
         return;
     }
-    BoltzmannInverter bi(temp_);
-    for(BondStruct &bond : bonds_) bi.calculate(bond);
-    for(BondStruct &bond : angles_) bi.calculate(bond);
-    for(BondStruct &bond : dihedrals_) bi.calculate(bond);
+
+    vector<BondStruct *> all_bonds;
+    for(BondStruct &bond : bonds_) all_bonds.push_back(&bond);
+    for(BondStruct &bond : angles_) all_bonds.push_back(&bond);
+    for(BondStruct &bond : dihedrals_) all_bonds.push_back(&bond);
+    const int num_bonds = static_cast<int>(all_bonds.size());
+    const bool fourier = potentials_[2] == PotentialType::COS ||
+                         potentials_[2] == PotentialType::RB;
+
+    // Inverters hold working arrays so each thread needs its own
+    #pragma omp parallel default(shared)
+    {
+        BoltzmannInverter bi(temp_);
+        #pragma omp for schedule(dynamic)
+        for(int i=0; i<num_bonds; i++){
+            bi.calculate(*all_bonds[i]);
+            if(tabulate) bi.tabulate(*all_bonds[i], bandwidth_scale);
+            if(max_modes > 1) bi.fitModes(*all_bonds[i], max_modes);
+            if(fourier && all_bonds[i]->type_ == BondType::DIHEDRAL)
+                bi.fitDihedralSeries(*all_bonds[i]);
+        }
+    }
+}
+
+/** \brief Write a single tabulated potential in GROMACS XVG format */
+static void write_table(const string &filename, const BondStruct &bond, const char *xunit,
+                        const char *funit){
+    backup_old_file(filename);
+    FILE *f = fopen(filename.c_str(), "w");
+    if(!f) throw std::runtime_error("Could not open table file " + filename);
+
+    fprintf(f, "# Tabulated potential prepared by CGTOOL Boltzmann Inversion\n");
+    fprintf(f, "# x (%s)  V (kJ/mol)  -dV/dx (%s)\n", xunit, funit);
+    for(const auto &row : bond.table_){
+        fprintf(f, "%12.5f %15.6e %15.6e\n", row[0], row[1], row[2]);
+    }
+    fclose(f);
+}
+
+void BondSet::writeTables() const{
+    for(int i=0; i<bonds_.size(); i++)
+        write_table("table_b" + std::to_string(i) + ".xvg", bonds_[i], "nm", "kJ/mol/nm");
+    for(int i=0; i<angles_.size(); i++)
+        write_table("table_a" + std::to_string(i) + ".xvg", angles_[i], "deg", "kJ/mol/rad");
+    for(int i=0; i<dihedrals_.size(); i++)
+        write_table("table_d" + std::to_string(i) + ".xvg", dihedrals_[i], "deg", "kJ/mol/rad");
+    printf("Written %'d tabulated potentials\n",
+           static_cast<int>(bonds_.size() + angles_.size() + dihedrals_.size()));
+}
+
+void BondSet::writeCorrelations() const{
+    const int num_pairs = static_cast<int>(correlations_.size());
+    if(num_pairs == 0) return;
+
+    // Five degree bins - dihedral axis is periodic
+    const std::array<HistogramAxis, 2> axes = {{HistogramAxis(0., 180., 36),
+                                                HistogramAxis(-180., 180., 72, true)}};
+    vector<HistogramND<double, 2>> hists(num_pairs, HistogramND<double, 2>(axes));
+
+    #pragma omp parallel for default(shared) schedule(dynamic)
+    for(int i=0; i<num_pairs; i++){
+        const BondStruct &angle = angles_[correlations_[i][0]];
+        const BondStruct &dihedral = dihedrals_[correlations_[i][1]];
+        // Values from the same molecule share an index
+        const int n = static_cast<int>(std::min(angle.values_.size(), dihedral.values_.size()));
+        hists[i].addBatch({{angle.values_.data(), dihedral.values_.data()}}, n);
+    }
+
+    for(int i=0; i<num_pairs; i++){
+        const string filename = "corr_a" + std::to_string(correlations_[i][0]) +
+                                "_d" + std::to_string(correlations_[i][1]) + ".dat";
+        backup_old_file(filename);
+        FILE *f = fopen(filename.c_str(), "w");
+        if(!f) throw std::runtime_error("Could not open correlation file " + filename);
+
+        fprintf(f, "# Angle - dihedral probability density prepared by CGTOOL\n");
+        fprintf(f, "# angle (deg)  dihedral (deg)  P (deg^-2)\n");
+        const vector<double> density = hists[i].density();
+        for(int a=0; a<axes[0].bins(); a++){
+            for(int d=0; d<axes[1].bins(); d++){
+                fprintf(f, "%8.2f %8.2f %12.5e\n", axes[0].centre(a), axes[1].centre(d),
+                        density[a * axes[1].bins() + d]);
+            }
+            fprintf(f, "\n");
+        }
+        fclose(f);
+    }
+    printf("Written %'d angle-dihedral correlations\n", num_pairs);
+}
+
+void BondSet::checkpoint(Checkpoint &cp){
+    cp.sync(numMeasures_);
+    for(vector<BondStruct> *set : {&bonds_, &angles_, &dihedrals_}){
+        for(BondStruct &bond : *set) cp.sync(bond.values_);
+    }
 }
 
 void BondSet::calcAvgs(){
@@ -0,0 +1,80 @@
+#include "cell_list.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+using std::vector;
+using std::array;
+
+void CellList::setupCells(const array<double, 3> &box){
+    for(int d=0; d<3; d++){
+        if(cutoff_ > 0.5 * box[d])
+            throw std::invalid_argument("Neighbour search cutoff is more than half the box");
+    }
+
+    array<int, 3> num_cells;
+    for(int d=0; d<3; d++) num_cells[d] = std::max(1, static_cast<int>(box[d] / cutoff_));
+    box_ = box;
+    for(int d=0; d<3; d++) halfBox_[d] = 0.5 * box[d];
+    if(num_cells == numCells_) return;
+
+    numCells_ = num_cells;
+    halfShell_ = numCells_[0] >= 3 && numCells_[1] >= 3 && numCells_[2] >= 3;
+    const int total = numCells_[0] * numCells_[1] * numCells_[2];
+    neighbours_.assign(total, vector<int>());
+
+    for(int x=0; x<numCells_[0]; x++){
+        for(int y=0; y<numCells_[1]; y++){
+            for(int z=0; z<numCells_[2]; z++){
+                const int c = cellIndex(x, y, z);
+                for(int dx=-1; dx<=1; dx++){
+                    for(int dy=-1; dy<=1; dy++){
+                        for(int dz=-1; dz<=1; dz++){
+                            // Half shell is the 13 offsets lexicographically after (0, 0, 0)
+                            if(halfShell_ && (dx < 0 || (dx == 0 && (dy < 0 || (dy == 0 && dz <= 0)))))
+                                continue;
+                            const int n = cellIndex((x + dx + numCells_[0]) % numCells_[0],
+                                                    (y + dy + numCells_[1]) % numCells_[1],
+                                                    (z + dz + numCells_[2]) % numCells_[2]);
+                            if(n == c) continue;
+                            vector<int> &list = neighbours_[c];
+                            if(std::find(list.begin(), list.end(), n) == list.end()) list.push_back(n);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void CellList::build(const vector<array<double, 3>> &coords, const array<double, 3> &box){
+    setupCells(box);
+
+    const int num = static_cast<int>(coords.size());
+    const int num_cells = static_cast<int>(neighbours_.size());
+    vector<int> cell(num);
+    cellStart_.assign(num_cells + 1, 0);
+
+    // Counting sort of particles into cells
+    vector<array<double, 3>> wrapped(num);
+    for(int i=0; i<num; i++){
+        array<int, 3> loc;
+        for(int d=0; d<3; d++){
+            wrapped[i][d] = coords[i][d] - box_[d] * std::floor(coords[i][d] / box_[d]);
+            loc[d] = std::min(static_cast<int>(wrapped[i][d] / box_[d] * numCells_[d]), numCells_[d] - 1);
+        }
+        cell[i] = cellIndex(loc[0], loc[1], loc[2]);
+        cellStart_[cell[i] + 1]++;
+    }
+    for(int c=0; c<num_cells; c++) cellStart_[c+1] += cellStart_[c];
+
+    vector<int> next(cellStart_.begin(), cellStart_.end() - 1);
+    sortedIndex_.resize(num);
+    sortedCoords_.resize(num);
+    for(int i=0; i<num; i++){
+        const int pos = next[cell[i]]++;
+        sortedIndex_[pos] = i;
+        sortedCoords_[pos] = wrapped[i];
+    }
+}
@@ -60,6 +60,7 @@ void CGMap::initFrame(const Frame &aa_frame, Frame &cg_frame){
     cgRes_[0].start = 0;
     cgRes_[0].num_atoms = numBeads_;
     cgRes_[0].num_residues = aaRes_[0].num_residues;
+    cgRes_[0].ref_atom_name = aaRes_[0].ref_atom_name;
     cgRes_[0].calc_total();
     cgRes_[0].populated = true;
     cgRes_[0].print();
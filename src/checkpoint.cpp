@@ -0,0 +1,115 @@
+#include "checkpoint.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "small_functions.h"
+
+using std::string;
+
+static const char checkpoint_magic[] = "CGTOOLCP";
+static const uint32_t checkpoint_version = 1;
+
+bool Checkpoint::resuming_ = false;
+
+Checkpoint::Checkpoint(const string &filename, const Mode mode) :
+        mode_(mode), filename_(filename){
+    if(loading()){
+        std::ifstream file(filename_, std::ios::binary);
+        if(!file) throw std::runtime_error("Could not open checkpoint " + filename_);
+        data_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        if(data_.size() < sizeof(checkpoint_magic) ||
+           std::memcmp(data_.data(), checkpoint_magic, sizeof(checkpoint_magic)) != 0)
+            throw std::runtime_error("File " + filename_ + " is not a checkpoint");
+        pos_ = sizeof(checkpoint_magic);
+    }else{
+        data_.assign(checkpoint_magic, checkpoint_magic + sizeof(checkpoint_magic));
+    }
+
+    uint32_t version = checkpoint_version;
+    sync(version);
+    if(version != checkpoint_version)
+        throw std::runtime_error("Checkpoint " + filename_ + " was written by a different version");
+}
+
+void Checkpoint::raw(void *bytes, const size_t n){
+    if(loading()){
+        if(pos_ + n > data_.size()) throw std::runtime_error("Checkpoint " + filename_ + " is truncated");
+        std::memcpy(bytes, data_.data() + pos_, n);
+        pos_ += n;
+    }else{
+        const char *start = static_cast<const char *>(bytes);
+        data_.insert(data_.end(), start, start + n);
+    }
+}
+
+uint64_t Checkpoint::syncSize(const size_t size){
+    uint64_t stored = size;
+    sync(stored);
+    // Every item takes at least a byte so a larger size can only come from a damaged file
+    if(loading() && stored > data_.size() - pos_)
+        throw std::runtime_error("Checkpoint " + filename_ + " is truncated");
+    return stored;
+}
+
+void Checkpoint::section(const string &name){
+    string stored = name;
+    sync(stored);
+    if(stored != name)
+        throw std::runtime_error("Checkpoint " + filename_ + " has section " + stored +
+                                 " where " + name + " was expected");
+}
+
+void Checkpoint::sync(string &str){
+    const uint64_t size = syncSize(str.size());
+    if(loading()){
+        str.assign(data_.data() + pos_, size);
+        pos_ += size;
+    }else{
+        raw(&str[0], size);
+    }
+}
+
+void Checkpoint::syncFile(FILE *file){
+    int64_t length = 0;
+    if(file){
+        fflush(file);
+        length = ftell(file);
+    }
+    sync(length);
+    if(!loading() || !file) return;
+
+    struct stat st;
+    if(fstat(fileno(file), &st) != 0 || st.st_size < length)
+        throw std::runtime_error("Output file is shorter than when checkpoint " + filename_ + " was written");
+    if(ftruncate(fileno(file), length) != 0)
+        throw std::runtime_error("Could not truncate output file to resume from checkpoint " + filename_);
+    fseek(file, 0, SEEK_END);
+}
+
+void Checkpoint::rewind(){
+    mode_ = Mode::LOAD;
+    pos_ = sizeof(checkpoint_magic) + sizeof(checkpoint_version);
+}
+
+void Checkpoint::save(){
+    const string tmpname = filename_ + ".tmp";
+    FILE *file = fopen(tmpname.c_str(), "wb");
+    if(!file) throw std::runtime_error("Could not open checkpoint " + tmpname + " for writing");
+    const bool ok = fwrite(data_.data(), 1, data_.size(), file) == data_.size();
+    // Checkpoint must be on disk before it replaces the old one
+    if(fflush(file) != 0 || fsync(fileno(file)) != 0 || fclose(file) != 0 || !ok)
+        throw std::runtime_error("Could not write checkpoint " + tmpname);
+    if(rename(tmpname.c_str(), filename_.c_str()) != 0)
+        throw std::runtime_error("Could not replace checkpoint " + filename_);
+}
+
+FILE *open_stream_file(const string &filename, const bool binary){
+    if(Checkpoint::resuming()) return fopen(filename.c_str(), binary ? "ab" : "a");
+    backup_old_file(filename);
+    return fopen(filename.c_str(), binary ? "wb" : "w");
+}
@@ -44,8 +44,9 @@ CMD::CMD(const string &help_header, const string &help_string,
             case ArgType::FLOAT:
                 break;
             case ArgType::BOOL:
+                // May be given as a bare flag
                 desc_.add_options()((arg).c_str(),
-                                    po::value<bool>()->default_value(stoi(parts[3])),
+                                    po::value<bool>()->default_value(stoi(parts[3]))->implicit_value(true),
                                     parts[1].c_str());
                 break;
         }
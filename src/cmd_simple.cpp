@@ -40,6 +40,9 @@ CMDSimple::CMDSimple(const string &help_header, const string &help_string,
             // String gets a short form
             shortForm_[arg.at(0)] = arg;
             options_[arg] = "";
+        }else if(type_[arg] == ArgType::BOOL){
+            // Bools are flags - set if default is true
+            options_[arg] = std::stoi(parts[3]) ? "true" : "";
         }else{
             // Everything else gets a default value
             options_[arg] = parts[3];
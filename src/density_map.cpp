@@ -0,0 +1,265 @@
+#include "density_map.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "small_functions.h"
+
+using std::vector;
+using std::array;
+using std::string;
+
+DensityMap::DensityMap(const string &selection, const string &axes, const vector<int> &bins,
+                       const string &centre) :
+        selection_(selection), centre_(centre){
+    int given = 0;
+    for(const char axis : axes){
+        if(axis < 'x' || axis > 'z') throw std::invalid_argument("Density axes must be x, y or z");
+        if(given >= bins.size()) throw std::invalid_argument("Density map needs a bin count for each axis");
+        if(bins[given] < 1) throw std::invalid_argument("Density map needs at least one bin");
+        bins_[axis - 'x'] = bins[given++];
+    }
+
+    const array<HistogramAxis, 3> frac_axes = {{HistogramAxis(0., 1., bins_[0]),
+                                                HistogramAxis(0., 1., bins_[1]),
+                                                HistogramAxis(0., 1., bins_[2])}};
+#ifdef _OPENMP
+    numShards_ = omp_get_max_threads();
+#endif
+    shards_.assign(numShards_, HistogramND<double, 3>(frac_axes));
+    density_.init(frac_axes);
+}
+
+vector<int> DensityMap::resolveSelection(const string &name, const Frame &frame,
+                                         const vector<Residue> &residues){
+    vector<int> atoms;
+
+    // Residue name - take every atom of each residue
+    for(const Residue &res : residues){
+        if(res.resname != name) continue;
+        for(int i=0; i<res.num_residues * res.num_atoms; i++) atoms.push_back(res.start + i);
+    }
+    if(!atoms.empty()) return atoms;
+
+    // Atom or bead name, then type
+    for(int i=0; i<frame.numAtoms_; i++){
+        if(frame.atoms_[i].atom_name == name) atoms.push_back(i);
+    }
+    if(atoms.empty()){
+        for(int i=0; i<frame.numAtoms_; i++){
+            if(frame.atoms_[i].atom_type == name) atoms.push_back(i);
+        }
+    }
+
+    if(atoms.empty()) throw std::runtime_error("Density selection " + name + " matches no atoms");
+    return atoms;
+}
+
+void DensityMap::setup(const Frame &frame, const vector<Residue> &residues){
+    atoms_ = resolveSelection(selection_, frame, residues);
+    if(!centre_.empty()) centreAtoms_ = resolveSelection(centre_, frame, residues);
+}
+
+void DensityMap::add(const Frame &frame){
+    array<double, 3> box;
+    for(int d=0; d<3; d++){
+        box[d] = frame.box_[d][d];
+        boxSum_[d] += box[d];
+    }
+    const double cell_volume = box[0] * box[1] * box[2] / (bins_[0] * bins_[1] * bins_[2]);
+
+    // Shift to move the centre selection to the middle of the box - periodic mean by angle
+    array<double, 3> shift = {{0., 0., 0.}};
+    if(!centreAtoms_.empty()){
+        for(int d=0; d<3; d++){
+            double c = 0., s = 0.;
+            for(const int atom : centreAtoms_){
+                const double angle = 2. * M_PI * frame.atoms_[atom].coords[d] / box[d];
+                c += std::cos(angle);
+                s += std::sin(angle);
+            }
+            shift[d] = 0.5 - std::atan2(s, c) / (2. * M_PI);
+        }
+    }
+
+    const int num = static_cast<int>(atoms_.size());
+    #pragma omp parallel num_threads(numShards_) default(shared)
+    {
+#ifdef _OPENMP
+        const int shard = omp_get_thread_num();
+        const int threads = omp_get_num_threads();
+#else
+        const int shard = 0;
+        const int threads = 1;
+#endif
+        // Each thread bins a contiguous block of atoms into its own shard
+        const int lo = static_cast<int>(static_cast<long>(num) * shard / threads);
+        const int hi = static_cast<int>(static_cast<long>(num) * (shard + 1) / threads);
+        const int len = hi - lo;
+        vector<double> frac[3];
+        for(int d=0; d<3; d++){
+            frac[d].resize(len);
+            const double inv_box = 1. / box[d];
+            for(int i=0; i<len; i++){
+                double s = frame.atoms_[atoms_[lo + i]].coords[d] * inv_box + shift[d];
+                s -= std::floor(s);
+                frac[d][i] = s < 1. ? s : 0.;
+            }
+        }
+        const vector<double> weights(len, 1. / cell_volume);
+        shards_[shard].addBatch({{frac[0].data(), frac[1].data(), frac[2].data()}}, len, weights.data());
+    }
+    frames_++;
+}
+
+void DensityMap::reduce(){
+    reduce_partials(shards_);
+    density_.merge(shards_[0]);
+    // All shards are cleared so reducing again does not count samples twice
+    for(auto &shard : shards_) shard.zero();
+}
+
+void DensityMap::checkpoint(Checkpoint &cp){
+    reduce();
+    density_.checkpoint(cp);
+    cp.sync(boxSum_);
+    cp.sync(frames_);
+}
+
+double DensityMap::density(const int x, const int y, const int z) const{
+    if(frames_ == 0) return 0.;
+    return density_.at({{x, y, z}}) / frames_;
+}
+
+array<double, 3> DensityMap::meanBox() const{
+    array<double, 3> box = {{0., 0., 0.}};
+    if(frames_ == 0) return box;
+    for(int d=0; d<3; d++) box[d] = boxSum_[d] / frames_;
+    return box;
+}
+
+void DensityMap::printText(const string &filename, const bool header) const{
+    const string file = filename + ".dat";
+    // Backup using small_functions.h
+    backup_old_file(file);
+    FILE *f = fopen(file.c_str(), "w");
+    if(f == nullptr) throw std::runtime_error("Could not open output file.");
+
+    const array<double, 3> box = meanBox();
+    vector<int> binned;
+    for(int d=0; d<3; d++) if(bins_[d] > 1) binned.push_back(d);
+
+    if(header){
+        fprintf(f, "@legend Number density of %s (nm^-3)\n", selection_.c_str());
+        // Binned axes are the axes of the plot
+        if(binned.size() <= 2){
+            for(int i=0; i<binned.size(); i++){
+                fprintf(f, "@%clabel %c (nm)\n", "xy"[i], "XYZ"[binned[i]]);
+                fprintf(f, "@%cwidth %f\n", "xy"[i], box[binned[i]]);
+            }
+        }
+    }
+
+    if(binned.size() == 1){
+        const int d = binned[0];
+        for(int i=0; i<bins_[d]; i++){
+            array<int, 3> cell = {{0, 0, 0}};
+            cell[d] = i;
+            fprintf(f, "%10.4f%12.5f\n", (i + 0.5) * box[d] / bins_[d], density(cell[0], cell[1], cell[2]));
+        }
+    }else if(binned.size() == 2){
+        for(int i=0; i<bins_[binned[0]]; i++){
+            for(int j=0; j<bins_[binned[1]]; j++){
+                array<int, 3> cell = {{0, 0, 0}};
+                cell[binned[0]] = i;
+                cell[binned[1]] = j;
+                fprintf(f, "%10.5f", density(cell[0], cell[1], cell[2]));
+            }
+            fprintf(f, "\n");
+        }
+    }else{
+        for(int x=0; x<bins_[0]; x++){
+            for(int y=0; y<bins_[1]; y++){
+                for(int z=0; z<bins_[2]; z++){
+                    fprintf(f, "%10.4f%10.4f%10.4f%12.5f\n", (x + 0.5) * box[0] / bins_[0],
+                            (y + 0.5) * box[1] / bins_[1], (z + 0.5) * box[2] / bins_[2],
+                            density(x, y, z));
+                }
+            }
+        }
+    }
+    fclose(f);
+}
+
+void DensityMap::printDX(const string &filename) const{
+    const string file = filename + ".dx";
+    // Backup using small_functions.h
+    backup_old_file(file);
+    FILE *f = fopen(file.c_str(), "w");
+    if(f == nullptr) throw std::runtime_error("Could not open output file.");
+
+    // DX lengths are conventionally in Angstrom
+    const array<double, 3> box = meanBox();
+    const int total = bins_[0] * bins_[1] * bins_[2];
+    fprintf(f, "# Number density of %s (nm^-3)\n", selection_.c_str());
+    fprintf(f, "object 1 class gridpositions counts %d %d %d\n", bins_[0], bins_[1], bins_[2]);
+    fprintf(f, "origin %f %f %f\n", 5. * box[0] / bins_[0], 5. * box[1] / bins_[1], 5. * box[2] / bins_[2]);
+    fprintf(f, "delta %f 0 0\n", 10. * box[0] / bins_[0]);
+    fprintf(f, "delta 0 %f 0\n", 10. * box[1] / bins_[1]);
+    fprintf(f, "delta 0 0 %f\n", 10. * box[2] / bins_[2]);
+    fprintf(f, "object 2 class gridconnections counts %d %d %d\n", bins_[0], bins_[1], bins_[2]);
+    fprintf(f, "object 3 class array type double rank 0 items %d data follows\n", total);
+
+    int count = 0;
+    for(int x=0; x<bins_[0]; x++){
+        for(int y=0; y<bins_[1]; y++){
+            for(int z=0; z<bins_[2]; z++){
+                fprintf(f, "%g", density(x, y, z));
+                fprintf(f, ++count % 3 == 0 || count == total ? "\n" : " ");
+            }
+        }
+    }
+    fprintf(f, "attribute \"dep\" string \"positions\"\n");
+    fprintf(f, "object \"density\" class field\n");
+    fprintf(f, "component \"positions\" value 1\n");
+    fprintf(f, "component \"connections\" value 2\n");
+    fprintf(f, "component \"data\" value 3\n");
+    fclose(f);
+}
+
+void DensityMap::printBinary(const string &filename) const{
+    const string file = filename + ".bin";
+    // Backup using small_functions.h
+    backup_old_file(file);
+    FILE *f = fopen(file.c_str(), "wb");
+    if(f == nullptr) throw std::runtime_error("Could not open output file.");
+
+    const array<double, 3> box = meanBox();
+    const std::int32_t counts[3] = {bins_[0], bins_[1], bins_[2]};
+    float origin[3], spacing[3];
+    for(int d=0; d<3; d++){
+        spacing[d] = static_cast<float>(box[d] / bins_[d]);
+        origin[d] = 0.5f * spacing[d];
+    }
+
+    vector<float> data;
+    data.reserve(bins_[0] * bins_[1] * bins_[2]);
+    for(int x=0; x<bins_[0]; x++){
+        for(int y=0; y<bins_[1]; y++){
+            for(int z=0; z<bins_[2]; z++) data.push_back(static_cast<float>(density(x, y, z)));
+        }
+    }
+
+    fwrite("CGDM", 1, 4, f);
+    fwrite(counts, sizeof(std::int32_t), 3, f);
+    fwrite(origin, sizeof(float), 3, f);
+    fwrite(spacing, sizeof(float), 3, f);
+    fwrite(data.data(), sizeof(float), data.size(), f);
+    fclose(f);
+}
@@ -0,0 +1,190 @@
+#include "diffusion.h"
+
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+
+#include "fft.h"
+#include "small_functions.h"
+
+using std::vector;
+using std::array;
+using std::string;
+using std::complex;
+
+Diffusion::Diffusion(const vector<int> &group, const vector<string> &names,
+                     const vector<unsigned> &reference) :
+        numParticles_(static_cast<int>(group.size())), group_(group), groupNames_(names),
+        reference_(reference){
+    if(reference_.size() != groupNames_.size())
+        throw std::invalid_argument("Diffusion needs a reference for every group");
+    groupSize_.assign(groupNames_.size(), 0);
+    for(const int g : group_){
+        if(g < 0 || g >= groupNames_.size()) throw std::invalid_argument("Diffusion group out of range");
+        groupSize_[g]++;
+    }
+    prevWrapped_.resize(numParticles_);
+    unwrapped_.assign(numParticles_, {{0., 0.}});
+}
+
+void Diffusion::add(const vector<array<double, 2>> &positions, const array<double, 2> &box,
+                    const double time){
+    if(positions.size() != numParticles_)
+        throw std::invalid_argument("Number of particles changed between frames");
+
+    const int num_groups = numGroups();
+    vector<array<double, 2>> group_sum(num_groups, {{0., 0.}});
+
+    // Unwrap by taking the minimum image of each step
+    if(!times_.empty()){
+        for(int p=0; p<numParticles_; p++){
+            for(int d=0; d<2; d++){
+                double step = positions[p][d] - prevWrapped_[p][d];
+                step -= box[d] * std::round(step / box[d]);
+                unwrapped_[p][d] += step;
+                group_sum[group_[p]][d] += unwrapped_[p][d];
+            }
+        }
+    }
+    prevWrapped_ = positions;
+
+    // Drift of pooled centre of mass of the reference groups since the first frame
+    vector<array<double, 2>> drift(num_groups, {{0., 0.}});
+    for(int g=0; g<num_groups; g++){
+        int count = 0;
+        for(int r=0; r<num_groups; r++){
+            if(!(reference_[g] >> r & 1u)) continue;
+            count += groupSize_[r];
+            for(int d=0; d<2; d++) drift[g][d] += group_sum[r][d];
+        }
+        if(count > 0) for(int d=0; d<2; d++) drift[g][d] /= count;
+    }
+
+    const size_t offset = series_.size();
+    series_.resize(offset + 2 * numParticles_);
+    for(int p=0; p<numParticles_; p++){
+        for(int d=0; d<2; d++){
+            series_[offset + 2 * p + d] = static_cast<float>(unwrapped_[p][d] - drift[group_[p]][d]);
+        }
+    }
+    times_.push_back(time);
+}
+
+void Diffusion::calculate(){
+    const int num_frames = frames();
+    const int num_groups = numGroups();
+    msd_.assign(num_groups, vector<double>(num_frames, 0.));
+    if(num_frames == 0) return;
+
+    // Zero padding to at least twice the length prevents circular wraparound
+    const int len = next_pow2(2 * num_frames);
+    const FFT plan(len);
+
+    #pragma omp parallel default(shared)
+    {
+        vector<vector<double>> local(num_groups, vector<double>(num_frames, 0.));
+        vector<complex<double>> work(len);
+        vector<double> x(num_frames), sq(num_frames);
+
+        #pragma omp for schedule(dynamic, 16)
+        for(int p=0; p<numParticles_; p++){
+            vector<double> &msd = local[group_[p]];
+            for(int d=0; d<2; d++){
+                for(int t=0; t<num_frames; t++) x[t] = series_[(static_cast<size_t>(t) * numParticles_ + p) * 2 + d];
+
+                // Autocorrelation sum_t x(t) x(t+m) from the power spectrum
+                for(int t=0; t<num_frames; t++) work[t] = x[t];
+                std::fill(work.begin() + num_frames, work.end(), complex<double>(0., 0.));
+                plan.forward(work);
+                for(complex<double> &w : work) w = std::norm(w);
+                plan.inverse(work);
+
+                // Sum over time origins of x(t)^2 + x(t+m)^2 by recursion on m
+                for(int t=0; t<num_frames; t++) sq[t] = x[t] * x[t];
+                double q = 0.;
+                for(int t=0; t<num_frames; t++) q += 2. * sq[t];
+                for(int m=0; m<num_frames; m++){
+                    if(m > 0) q -= sq[m-1] + sq[num_frames-m];
+                    msd[m] += (q - 2. * work[m].real()) / (num_frames - m);
+                }
+            }
+        }
+
+        #pragma omp critical
+        {
+            for(int g=0; g<num_groups; g++){
+                for(int m=0; m<num_frames; m++) msd_[g][m] += local[g][m];
+            }
+        }
+    }
+
+    for(int g=0; g<num_groups; g++){
+        if(groupSize_[g] == 0) continue;
+        for(double &val : msd_[g]) val /= groupSize_[g];
+    }
+}
+
+double Diffusion::lagTime(const int lag) const{
+    if(times_.size() < 2) return 0.;
+    return lag * (times_.back() - times_.front()) / (times_.size() - 1);
+}
+
+bool Diffusion::fit(const int group, const double t_start, const double t_end, double &D) const{
+    const int num_frames = static_cast<int>(msd_.at(group).size());
+    const double end = t_end < 0. ? lagTime(num_frames / 2) : t_end;
+
+    // Least squares line through MSD against lag time
+    double sx = 0., sy = 0., sxx = 0., sxy = 0.;
+    int n = 0;
+    for(int m=1; m<num_frames; m++){
+        const double t = lagTime(m);
+        if(t < t_start || t > end) continue;
+        sx += t;
+        sy += msd_[group][m];
+        sxx += t * t;
+        sxy += t * msd_[group][m];
+        n++;
+    }
+    if(n < 2) return false;
+    const double slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+    D = slope / 4.;
+    return true;
+}
+
+void Diffusion::print(const string &filename, const double t_start, const double t_end,
+                      const bool header) const{
+    const string file = filename + ".dat";
+    // Backup using small_functions.h
+    backup_old_file(file);
+    FILE *f = fopen(file.c_str(), "w");
+    if(f == nullptr) throw std::runtime_error("Could not open output file.");
+
+    const int num_groups = numGroups();
+    if(header){
+        fprintf(f, "@legend Lateral mean squared displacement\n");
+        for(int g=0; g<num_groups; g++){
+            double D;
+            if(fit(g, t_start, t_end, D))
+                fprintf(f, "@D %s %f um^2/s\n", groupNames_[g].c_str(), D * 1e6);
+        }
+        fprintf(f, "@columns lag (ps)");
+        for(int g=0; g<num_groups; g++) fprintf(f, "  %s (nm^2)", groupNames_[g].c_str());
+        fprintf(f, "\n");
+    }
+
+    for(int m=0; m<frames(); m++){
+        fprintf(f, "%12.3f", lagTime(m));
+        for(int g=0; g<num_groups; g++) fprintf(f, "%12.5f", msd_[g][m]);
+        fprintf(f, "\n");
+    }
+    fclose(f);
+}
+
+void Diffusion::checkpoint(Checkpoint &cp){
+    cp.sync(prevWrapped_);
+    cp.sync(unwrapped_);
+    cp.sync(series_);
+    cp.sync(times_);
+    if(prevWrapped_.size() != numParticles_ || unwrapped_.size() != numParticles_)
+        throw std::runtime_error("Diffusion checkpoint does not match the number of particles");
+}
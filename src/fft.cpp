@@ -0,0 +1,194 @@
+#include "fft.h"
+
+#include <cmath>
+#include <cassert>
+#include <stdexcept>
+
+using std::vector;
+using std::complex;
+
+typedef complex<double> cplx;
+
+int next_pow2(const int n){
+    int p = 1;
+    while(p < n) p <<= 1;
+    return p;
+}
+
+FFT::FFT(const int size) : size_(size){
+    if(size_ < 1) throw std::invalid_argument("FFT size must be positive");
+    pow2_ = (size_ & (size_ - 1)) == 0;
+
+    if(pow2_){
+        twiddles_.resize(size_ / 2 + 1);
+        for(int i=0; i<=size_/2; i++){
+            const double ang = -2. * M_PI * i / size_;
+            twiddles_[i] = cplx(cos(ang), sin(ang));
+        }
+
+        int bits = 0;
+        while((1 << bits) < size_) bits++;
+        bitrev_.resize(size_);
+        for(int i=0; i<size_; i++){
+            int rev = 0;
+            for(int b=0; b<bits; b++) if(i & (1 << b)) rev |= 1 << (bits - 1 - b);
+            bitrev_[i] = rev;
+        }
+        return;
+    }
+
+    // Bluestein - take k^2 mod 2N to keep the chirp accurate for large k
+    chirp_.resize(size_);
+    const long long two_n = 2LL * size_;
+    for(long long k=0; k<size_; k++){
+        const double ang = -M_PI * static_cast<double>((k * k) % two_n) / size_;
+        chirp_[k] = cplx(cos(ang), sin(ang));
+    }
+
+    const int padded = next_pow2(2 * size_ - 1);
+    inner_.reset(new FFT(padded));
+    chirpFT_.assign(padded, cplx(0., 0.));
+    chirpFT_[0] = std::conj(chirp_[0]);
+    for(int k=1; k<size_; k++){
+        chirpFT_[k] = std::conj(chirp_[k]);
+        chirpFT_[padded - k] = std::conj(chirp_[k]);
+    }
+    inner_->transform(chirpFT_.data(), false);
+}
+
+void FFT::radix2(cplx *data, const bool inverse) const{
+    for(int i=0; i<size_; i++){
+        const int j = bitrev_[i];
+        if(i < j) std::swap(data[i], data[j]);
+    }
+
+    for(int len=2; len<=size_; len<<=1){
+        const int half = len / 2;
+        const int step = size_ / len;
+        for(int i=0; i<size_; i+=len){
+            for(int j=0; j<half; j++){
+                const cplx w = inverse ? std::conj(twiddles_[j * step]) : twiddles_[j * step];
+                const cplx u = data[i + j];
+                const cplx v = data[i + j + half] * w;
+                data[i + j] = u + v;
+                data[i + j + half] = u - v;
+            }
+        }
+    }
+}
+
+void FFT::bluestein(cplx *data, const bool inverse) const{
+    const int padded = inner_->size();
+    vector<cplx> work(padded, cplx(0., 0.));
+
+    // Inverse is the conjugate of the forward transform of the conjugate
+    for(int k=0; k<size_; k++){
+        const cplx x = inverse ? std::conj(data[k]) : data[k];
+        work[k] = x * chirp_[k];
+    }
+
+    inner_->transform(work.data(), false);
+    for(int k=0; k<padded; k++) work[k] *= chirpFT_[k];
+    inner_->transform(work.data(), true);
+
+    for(int k=0; k<size_; k++){
+        const cplx x = work[k] * chirp_[k];
+        data[k] = inverse ? std::conj(x) : x;
+    }
+}
+
+void FFT::transform(cplx *data, const bool inverse) const{
+    if(pow2_){
+        radix2(data, inverse);
+    }else{
+        bluestein(data, inverse);
+    }
+
+    if(inverse){
+        const double norm = 1. / size_;
+        for(int i=0; i<size_; i++) data[i] *= norm;
+    }
+}
+
+void FFT::forward(vector<cplx> &data) const{
+    assert(static_cast<int>(data.size()) == size_);
+    transform(data.data(), false);
+}
+
+void FFT::inverse(vector<cplx> &data) const{
+    assert(static_cast<int>(data.size()) == size_);
+    transform(data.data(), true);
+}
+
+/** \brief Transform every line along one axis of a 3d row major array */
+static void transform_axis(vector<cplx> &data, const int nx, const int ny, const int nz,
+                           const int axis, const bool inverse){
+    const int dims[3] = {nx, ny, nz};
+    const int strides[3] = {ny * nz, nz, 1};
+    const int len = dims[axis];
+    if(len == 1) return;
+    const FFT plan(len);
+
+    // Lines are indexed by the two remaining axes
+    const int a = (axis + 1) % 3;
+    const int b = (axis + 2) % 3;
+    const int num_lines = dims[a] * dims[b];
+    const int stride = strides[axis];
+
+    #pragma omp parallel default(shared)
+    {
+        vector<cplx> line(len);
+        #pragma omp for schedule(static)
+        for(int l=0; l<num_lines; l++){
+            const int offset = (l / dims[b]) * strides[a] + (l % dims[b]) * strides[b];
+            if(stride == 1){
+                plan.transform(&data[offset], inverse);
+                continue;
+            }
+            for(int i=0; i<len; i++) line[i] = data[offset + i*stride];
+            plan.transform(line.data(), inverse);
+            for(int i=0; i<len; i++) data[offset + i*stride] = line[i];
+        }
+    }
+}
+
+void fft2D(vector<cplx> &data, const int nx, const int ny, const bool inverse){
+    assert(static_cast<int>(data.size()) == nx * ny);
+    transform_axis(data, nx, ny, 1, 1, inverse);
+    transform_axis(data, nx, ny, 1, 0, inverse);
+}
+
+void fft3D(vector<cplx> &data, const int nx, const int ny, const int nz,
+           const bool inverse){
+    assert(static_cast<int>(data.size()) == nx * ny * nz);
+    transform_axis(data, nx, ny, nz, 2, inverse);
+    transform_axis(data, nx, ny, nz, 1, inverse);
+    transform_axis(data, nx, ny, nz, 0, inverse);
+}
+
+void fft_convolve(vector<double> &data, const vector<double> &kernel,
+                  const bool periodic){
+    const int n = static_cast<int>(data.size());
+    const int k = static_cast<int>(kernel.size());
+    if(n == 0 || k == 0) return;
+
+    // Zero padding of at least the kernel width prevents wraparound
+    const int len = periodic ? n : next_pow2(n + k);
+    vector<cplx> sig(len, cplx(0., 0.));
+    vector<cplx> ker(len, cplx(0., 0.));
+    for(int i=0; i<n; i++) sig[i] = data[i];
+
+    ker[0] += kernel[0];
+    for(int i=1; i<k; i++){
+        ker[i % len] += kernel[i];
+        ker[(len - i % len) % len] += kernel[i];
+    }
+
+    const FFT plan(len);
+    plan.forward(sig);
+    plan.forward(ker);
+    for(int i=0; i<len; i++) sig[i] *= ker[i];
+    plan.inverse(sig);
+
+    for(int i=0; i<n; i++) data[i] = sig[i].real();
+}
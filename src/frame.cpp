@@ -1,6 +1,8 @@
 #include "frame.h"
 
 #include <sstream>
+#include <cstdlib>
+#include <stdexcept>
 
 #include <assert.h>
 #include <sysexits.h>
@@ -29,6 +31,19 @@ Frame::Frame(const string &xtcname, const string &groname,
     isSetup_ = true;
 };
 
+Frame::Frame(const int natoms, const double box, vector<Residue> &residues) :
+        residues_(residues){
+    numAtoms_ = natoms;
+    atoms_.resize(natoms);
+    for(int i=0; i<3; i++){
+        for(int j=0; j<3; j++) box_[i][j] = i == j ? box : 0.f;
+        boxDiag_[i] = box;
+    }
+    atomHas_.created = true;
+    atomHas_.coords = true;
+    isSetup_ = true;
+}
+
 Frame::~Frame(){
     isSetup_ = false;
     if(trjIn_) delete trjIn_;
@@ -112,36 +127,47 @@ void Frame::initFromITP(const string &itpname){
     // Require that atoms have been created
     assert(atomHas_.created);
 
-    // Process topology file
-    vector<string> substrs;
+    // Process topology file - one pass over [atoms], keeping lines for the residue
     Parser itp_parser(itpname, FileFormat::GROMACS);
+    vector<boost::string_ref> substrs;
+    vector<vector<boost::string_ref>> atom_lines;
+    int first_line = -1;
 
     // How many atoms are there?  Per residue?  In total?
-    if(residues_[0].num_atoms < 0){
-        while(itp_parser.getLineFromSection("atoms", substrs, 4)){
-            // Loop through all atoms in residue and take the last number
-            if(substrs[3] == residues_[0].resname) residues_[0].num_atoms++;
+    const bool count_atoms = residues_[0].num_atoms < 0;
+    while(itp_parser.getLineFromSection("atoms", substrs, 4)){
+        // Loop through all atoms in residue and take the last number
+        if(count_atoms && substrs[3] == residues_[0].resname) residues_[0].num_atoms++;
+        if(substrs.size() >= 5){
+            // Included topologies may define other molecules first - start from our residue
+            if(first_line < 0 && substrs[3] == residues_[0].resname) first_line = atom_lines.size();
+            atom_lines.push_back(substrs);
         }
     }
     residues_[0].calc_total();
+    if(first_line < 0) first_line = 0;
+
+    if(atom_lines.size() < first_line + residues_[0].num_atoms)
+        throw std::runtime_error("Too few atoms in ITP file " + itpname);
 
     for(int i = 0; i < residues_[0].num_atoms; i++){
         // Read data from topology file for each atom
-        itp_parser.getLineFromSection("atoms", substrs, 5);
-        const string type = substrs[1];
-        const string name = substrs[4];
+        const vector<boost::string_ref> &tokens = atom_lines[first_line + i];
+        const string type = tokens[1].to_string();
+        const string name = tokens[4].to_string();
         atomHas_.atom_type = true;
         atomHas_.atom_name = true;
 
+        // Tokens are followed by a delimiter in the Parser's buffer so can be converted in place
         double charge = 0.;
-        if(substrs.size() >= 7){
-            charge = atof(substrs[6].c_str());
+        if(tokens.size() >= 7){
+            charge = strtod(tokens[6].data(), nullptr);
             atomHas_.charge = true;
         }
 
         double mass = 1.;
-        if(substrs.size() >= 8){
-            mass = atof(substrs[7].c_str());
+        if(tokens.size() >= 8){
+            mass = strtod(tokens[7].data(), nullptr);
             atomHas_.mass = true;
         }
 
@@ -167,10 +193,11 @@ void Frame::initFromFLD(const std::string &fldname){
     map<string, double> c06;
     map<string, double> c12;
 
-    vector<string> tokens;
+    vector<boost::string_ref> tokens;
     while(parser.getLineFromSection("atomtypes", tokens, 7)){
-        c06[tokens[0]] = stof(tokens[5]);
-        c12[tokens[0]] = stof(tokens[6]);
+        const string type = tokens[0].to_string();
+        c06[type] = std::strtof(tokens[5].data(), nullptr);
+        c12[type] = std::strtof(tokens[6].data(), nullptr);
     }
 
     for(int i=0; i<residues_[0].total_atoms; i++){
@@ -185,6 +212,14 @@ bool Frame::readNext(){
     return trjIn_->readFrame(*this) == 0;
 }
 
+long Frame::trajectoryPosition() const{
+    return trjIn_->tell();
+}
+
+void Frame::seekTrajectory(const long pos){
+    trjIn_->seek(pos);
+}
+
 void Frame::printAtoms(int natoms) const{
     assert(isSetup_);
     if(natoms == -1) natoms = numAtoms_;
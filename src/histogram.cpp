@@ -9,6 +9,10 @@
 
 #include <cstdio>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 Histogram::Histogram(const int size, const bool fast){
     init(size, fast);
 }
@@ -18,77 +22,135 @@ Histogram::~Histogram(){
 }
 
 void Histogram::init(const int size, const bool fast){
-    assert(size > 0);
-    if(array_) free();
-
+    init(0., size, size);
     fast_ = fast;
-    allocated_ = false;
+}
 
+void Histogram::init(const double min, const double max, const int size){
+    assert(size > 0);
+    if(allocated_) free();
+
+    fast_ = false;
     size_ = size;
-    array_ = new int[size];
-    if(array_ == nullptr) throw std::runtime_error("Array alloc failed - Histogram");
+    min_ = min;
+    max_ = max;
+    step_ = (max - min) / size;
+#ifdef _OPENMP
+    numShards_ = omp_get_max_threads();
+#else
+    numShards_ = 1;
+#endif
+    // Extra shard is shared by any threads beyond those expected and updated atomically
+    const std::array<HistogramAxis, 1> axes = {{HistogramAxis(min, max, size)}};
+    shards_.assign(numShards_ + 1, HistogramND<std::int64_t, 1>(axes));
     allocated_ = true;
-    if(!fast_) zero();
 }
 
 void Histogram::zero(const int set){
     // Where set is zero by default - but can be specified
-    for(int i=0; i<size_; i++) array_[i] = set;
+    // Set value is held by the first shard so it survives reduction
+    for(auto &shard : shards_) shard.zero();
+    if(!shards_.empty()) shards_[0].zero(set);
 }
 
 void Histogram::free(){
-    if(array_) delete[] array_;
+    shards_.clear();
     allocated_ = false;
-    array_ = nullptr;
 }
 
-void Histogram::increment(int loc){
-    if(fast_) array_[loc]++;
+int Histogram::shardNum() const{
+#ifdef _OPENMP
+    const int thread = omp_get_thread_num();
+    return thread < numShards_ ? thread : numShards_;
+#else
+    return 0;
+#endif
+}
 
-    assert(loc < size_);
-    if(loc < 0) loc = size_ + loc;
-    assert(loc >= 0);
+void Histogram::increment(int loc){
+    if(!fast_){
+        assert(loc < size_);
+        if(loc < 0) loc = size_ + loc;
+        assert(loc >= 0);
+    }
 
-    #pragma omp atomic
-    array_[loc]++;
+    const int shard = shardNum();
+    std::int64_t &bin = shards_[shard][loc];
+    if(shard < numShards_){
+        bin++;
+    }else{
+        #pragma omp atomic
+        bin++;
+    }
 }
 
 void Histogram::decrement(int loc){
-    if(fast_) array_[loc]--;
+    if(!fast_){
+        assert(loc < size_);
+        if(loc < 0) loc = size_ + loc;
+        assert(loc >= 0);
+    }
 
-    assert(loc < size_);
-    if(loc < 0) loc = size_ + loc;
-    assert(loc >= 0);
+    const int shard = shardNum();
+    std::int64_t &bin = shards_[shard][loc];
+    if(shard < numShards_){
+        bin--;
+    }else{
+        #pragma omp atomic
+        bin--;
+    }
+}
 
-    #pragma omp atomic
-    array_[loc]--;
+void Histogram::add(const double val, const int weight){
+    const int loc = shards_[0].axis(0).index(val);
+    if(loc < 0 || loc >= size_) return;
+
+    const int shard = shardNum();
+    std::int64_t &bin = shards_[shard][loc];
+    if(shard < numShards_){
+        bin += weight;
+    }else{
+        #pragma omp atomic
+        bin += weight;
+    }
 }
 
-int Histogram::at(int loc) const{
-    if(fast_) return array_[loc];
+std::int64_t Histogram::at(int loc) const{
+    if(!fast_){
+        assert(loc < size_);
+        if(loc < 0) loc = size_ + loc;
+        assert(loc >= 0);
+    }
 
-    assert(loc < size_);
-    if(loc < 0) loc = size_ + loc;
-    assert(loc >= 0);
+    return shards_[0].at(loc);
+}
 
-    return array_[loc];
+void Histogram::reduce(){
+    reduce_partials(shards_);
+    for(int i=1; i<shards_.size(); i++) shards_[i].zero();
 }
 
 void Histogram::scale(const double mult){
-    for(int i=0; i<size_; i++) array_[i] *= mult;
+    for(auto &shard : shards_) shard.scale(mult);
+}
+
+void Histogram::checkpoint(Checkpoint &cp){
+    // Partial counts are merged so the checkpoint does not depend on thread count
+    reduce();
+    shards_[0].checkpoint(cp);
 }
 
 void Histogram::print(const int width) const{
     assert(allocated_);
 
-    for(int i=0; i<size_; i++) printf("%*d", width, array_[i]);
+    for(int i=0; i<size_; i++) printf("%*lld", width, static_cast<long long>(at(i)));
     printf("\n");
 }
 
 void Histogram::printGraph(const int scale) const{
-    int max_num = 0;
+    std::int64_t max_num = 0;
     for(int i=0; i<size_; i++){
-        if(array_[i] > max_num) max_num = array_[i];
+        if(at(i) > max_num) max_num = at(i);
     }
 
     const double bar_scale = static_cast<double>(scale) / max_num;
@@ -97,7 +159,7 @@ void Histogram::printGraph(const int scale) const{
     for(int i=scale; i>0; i--){
         printf("%5.3f|", min_);
         for(int j=0; j<size_; j++){
-            if(array_[j]*bar_scale >= i){
+            if(at(j)*bar_scale >= i){
                 printf("#");
             }else{
                 printf(" ");
@@ -110,7 +172,7 @@ void Histogram::printGraph(const int scale) const{
 void Histogram::exportGraph() const{
     double x = min_;
     for(int i=0; i<size_; i++){
-        printf("%10.3f %10.3d\n", x, array_[i]);
+        printf("%10.3f %10.3lld\n", x, static_cast<long long>(at(i)));
         x += step_;
     }
 }
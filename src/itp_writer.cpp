@@ -122,6 +122,15 @@ void ITPWriter::printAtoms(const CGMap &map) const{
     }
 }
 
+void ITPWriter::printModes(const BondStruct &bond) const{
+    if(bond.modes_.size() < 2) return;
+    for(int i=0; i<bond.modes_.size(); i++){
+        const GaussianMode &mode = bond.modes_[i];
+        fprintf(itp_, "%c    mode %i  weight %5.3f  equilibrium %12.5f  force const %12.5f\n",
+                comment_, i+1, mode.weight, mode.mean, mode.forceConstant);
+    }
+}
+
 void ITPWriter::printBonds(const BondSet &bond_set, const bool round) const{
     const double scale = 3.;
     switch(format_){
@@ -134,6 +143,7 @@ void ITPWriter::printBonds(const BondSet &bond_set, const bool round) const{
                 fprintf(itp_, "%5i %5i %5i %12.5f %12.5f; %5.3f\n",
                         bond.atomNums_[0]+1, bond.atomNums_[1]+1, 1,
                         bond.avg_, f_const, bond.rsqr_);
+                printModes(bond);
             }
 
             newSection("angles");
@@ -145,9 +155,36 @@ void ITPWriter::printBonds(const BondSet &bond_set, const bool round) const{
                         bond.atomNums_[0]+1, bond.atomNums_[1]+1,
                         bond.atomNums_[2]+1, 2,
                         bond.avg_, f_const, bond.rsqr_);
+                printModes(bond);
             }
 
             newSection("dihedrals");
+            if(bond_set.potentials_[2] == PotentialType::COS){
+                // GROMACS type 9 allows several terms for the same atoms
+                fprintf(itp_, ";atm1  atm2  atm3  atm4  type  phase  force const  mult  unimodality\n");
+                for(const BondStruct &bond : bond_set.dihedrals_){
+                    for(const DihedralTerm &term : bond.terms_){
+                        fprintf(itp_, "%5i %5i %5i %5i %5i %12.5f %12.5f %5i; %5.3f\n",
+                                bond.atomNums_[0]+1, bond.atomNums_[1]+1,
+                                bond.atomNums_[2]+1, bond.atomNums_[3]+1,
+                                9, term.phase, term.forceConstant, term.multiplicity, bond.rsqr_);
+                    }
+                    printModes(bond);
+                }
+                break;
+            }
+            if(bond_set.potentials_[2] == PotentialType::RB){
+                fprintf(itp_, ";atm1  atm2  atm3  atm4  type  C0  C1  C2  C3  C4  C5  unimodality\n");
+                for(const BondStruct &bond : bond_set.dihedrals_){
+                    const auto &c = bond.rbCoeffs_;
+                    fprintf(itp_, "%5i %5i %5i %5i %5i %12.5f %12.5f %12.5f %12.5f %12.5f %12.5f; %5.3f\n",
+                            bond.atomNums_[0]+1, bond.atomNums_[1]+1,
+                            bond.atomNums_[2]+1, bond.atomNums_[3]+1,
+                            3, c[0], c[1], c[2], c[3], c[4], c[5], bond.rsqr_);
+                    printModes(bond);
+                }
+                break;
+            }
             fprintf(itp_, ";atm1  atm2  atm3  atm4  type  equilibrium  force const  mult  unimodality\n");
             for(const BondStruct &bond : bond_set.dihedrals_){
                 double f_const = bond.forceConstant_;
@@ -157,6 +194,7 @@ void ITPWriter::printBonds(const BondSet &bond_set, const bool round) const{
                         bond.atomNums_[2]+1, bond.atomNums_[3]+1,
                         // TODO support multiplicity
                         1, wrapOneEighty(bond.avg_ + 180), f_const, 1, bond.rsqr_);
+                printModes(bond);
             }
             break;
 
@@ -166,6 +204,7 @@ void ITPWriter::printBonds(const BondSet &bond_set, const bool round) const{
             for(const BondStruct &bond : bond_set.bonds_){
                 fprintf(itp_, "bond_coeff %4i %8.3f %8.3f  #  %8.3f\n",
                         i, bond.avg_, bond.forceConstant_, bond.rsqr_);
+                printModes(bond);
                 i++;
             }
 
@@ -174,14 +213,42 @@ void ITPWriter::printBonds(const BondSet &bond_set, const bool round) const{
             for(const BondStruct &bond : bond_set.angles_){
                 fprintf(itp_, "angle_coeff %4i  cosine/squared %8.3f %8.3f  #  %8.3f\n",
                         i, bond.avg_, bond.forceConstant_, bond.rsqr_);
+                printModes(bond);
                 i++;
             }
 
             fprintf(itp_, "\n#dihedrals     bond                    equil  f_const  unimodality\n");
             i = 1;
+            if(bond_set.potentials_[2] == PotentialType::COS){
+                // LAMMPS fourier is the same form as GROMACS type 9 - k, n, phase
+                for(const BondStruct &bond : bond_set.dihedrals_){
+                    fprintf(itp_, "dihedral_coeff %4i  fourier %i", i, static_cast<int>(bond.terms_.size()));
+                    for(const DihedralTerm &term : bond.terms_){
+                        fprintf(itp_, " %8.3f %i %8.3f", term.forceConstant, term.multiplicity, term.phase);
+                    }
+                    fprintf(itp_, "  #  %8.3f\n", bond.rsqr_);
+                    printModes(bond);
+                    i++;
+                }
+                break;
+            }
+            if(bond_set.potentials_[2] == PotentialType::RB){
+                // LAMMPS nharmonic uses powers of cos(phi) rather than cos(psi)
+                for(const BondStruct &bond : bond_set.dihedrals_){
+                    fprintf(itp_, "dihedral_coeff %4i  nharmonic 6", i);
+                    for(int m=0; m<6; m++){
+                        fprintf(itp_, " %8.3f", m % 2 ? -bond.rbCoeffs_[m] : bond.rbCoeffs_[m]);
+                    }
+                    fprintf(itp_, "  #  %8.3f\n", bond.rsqr_);
+                    printModes(bond);
+                    i++;
+                }
+                break;
+            }
             for(const BondStruct &bond : bond_set.dihedrals_){
                 fprintf(itp_, "angle_coeff %4i  cosine/squared %8.3f %8.3f  #  %8.3f\n",
                         i, bond.avg_, bond.forceConstant_, bond.rsqr_);
+                printModes(bond);
                 i++;
             }
 
@@ -189,6 +256,45 @@ void ITPWriter::printBonds(const BondSet &bond_set, const bool round) const{
     }
 }
 
+void ITPWriter::printBondsTabulated(const BondSet &bond_set) const{
+    // GROMACS type 8 - tabulated with exclusions - force constant scales table
+    const int type = 8;
+    const double scale = 1.;
+    switch(format_){
+        case FileFormat::GROMACS:
+            newSection("bonds");
+            fprintf(itp_, ";atm1  atm2  type  table  scale\n");
+            for(int i=0; i<bond_set.bonds_.size(); i++){
+                const BondStruct &bond = bond_set.bonds_[i];
+                fprintf(itp_, "%5i %5i %5i %5i %12.5f\n",
+                        bond.atomNums_[0]+1, bond.atomNums_[1]+1, type, i, scale);
+            }
+
+            newSection("angles");
+            fprintf(itp_, ";atm1  atm2  atm3  type  table  scale\n");
+            for(int i=0; i<bond_set.angles_.size(); i++){
+                const BondStruct &bond = bond_set.angles_[i];
+                fprintf(itp_, "%5i %5i %5i %5i %5i %12.5f\n",
+                        bond.atomNums_[0]+1, bond.atomNums_[1]+1,
+                        bond.atomNums_[2]+1, type, i, scale);
+            }
+
+            newSection("dihedrals");
+            fprintf(itp_, ";atm1  atm2  atm3  atm4  type  table  scale\n");
+            for(int i=0; i<bond_set.dihedrals_.size(); i++){
+                const BondStruct &bond = bond_set.dihedrals_[i];
+                fprintf(itp_, "%5i %5i %5i %5i %5i %5i %12.5f\n",
+                        bond.atomNums_[0]+1, bond.atomNums_[1]+1,
+                        bond.atomNums_[2]+1, bond.atomNums_[3]+1, type, i, scale);
+            }
+            break;
+
+        case FileFormat::LAMMPS:
+            printf("LAMMPS tabulated bonds not yet supported\n");
+            exit(EX_USAGE);
+    }
+}
+
 void ITPWriter::printAtomTypes(const CGMap &cgmap) const{
     switch(format_){
         case FileFormat::GROMACS:
@@ -38,7 +38,9 @@ int main(const int argc, const char *argv[]){
             "--gro\tGROMACS GRO file\t0\n"
             "--itp\tGROMACS ITP file\t0\n"
             "--fld\tGROMACS forcefield file\t0\n"
-            "--frames\tNumber of frames to read\t1\t-1";
+            "--frames\tNumber of frames to read\t1\t-1\n"
+            "--resume\tContinue from checkpoint\t3\t0\n"
+            "--follow\tKeep reading XTC as it is written\t3\t0";
 
     const string compile_info =
             #include "compile_info.inc"
@@ -57,6 +59,7 @@ int main(const int argc, const char *argv[]){
 
 void Cgtool::readConfig(){
     Parser cfg_parser(inputFiles_["cfg"].name);
+    checkpointFile_ = "cgtool.cpt";
 
     if(cfg_parser.findSection("membrane")){
         printf("CGTOOL no longer performs membrane analysis - use RAMSi\n");
@@ -75,14 +78,46 @@ void Cgtool::readConfig(){
     settings_["csv"]["molecules"] =
             cfg_parser.getIntKeyFromSection("csv", "molecules", 10000);
 
+    settings_["tables"]["on"] =
+            cfg_parser.findSection("tables");
+    settings_["tables"]["bandwidth"] =
+            cfg_parser.getIntKeyFromSection("tables", "bandwidth", 100);
+
+    settings_["modes"]["on"] =
+            cfg_parser.findSection("modes");
+    settings_["modes"]["max"] =
+            cfg_parser.getIntKeyFromSection("modes", "max", 3);
+
     settings_["rdf"]["on"] =
-            cfg_parser.findSection("rdf");
+            cfg_parser.findSection("rdf") || cfg_parser.findSection("rdf_pairs");
     settings_["rdf"]["freq"] =
             cfg_parser.getIntKeyFromSection("rdf", "freq", 1);
-    settings_["rdf"]["cutoff"] =
-            cfg_parser.getIntKeyFromSection("rdf", "cutoff", 2);
+    // Cutoff is stored in hundredths of a nm since settings are integers
+    settings_["rdf"]["cutoff"] = static_cast<int>(
+            100 * cfg_parser.getDoubleKeyFromSection("rdf", "cutoff", 2.) + 0.5);
     settings_["rdf"]["resolution"] =
             cfg_parser.getIntKeyFromSection("rdf", "resolution", 100);
+    settings_["sq"]["on"] =
+            cfg_parser.findSection("sq");
+    settings_["sq"]["freq"] =
+            cfg_parser.getIntKeyFromSection("sq", "freq", 1);
+    settings_["sq"]["grid"] =
+            cfg_parser.getIntKeyFromSection("sq", "grid", 64);
+    settings_["sq"]["bins"] =
+            cfg_parser.getIntKeyFromSection("sq", "bins", 100);
+
+    vector<string> tokens;
+    while(cfg_parser.getLineFromSection("rdf_pairs", tokens, 2))
+        rdfPairs_.push_back({{tokens[0], tokens[1]}});
+
+    settings_["output"]["precision"] =
+            cfg_parser.getIntKeyFromSection("output", "precision", 500);
+    settings_["output"]["threads"] =
+            cfg_parser.getIntKeyFromSection("output", "threads", 0);
+    settings_["output"]["binary"] =
+            cfg_parser.getIntKeyFromSection("output", "binary", 0);
+    while(cfg_parser.getLineFromSection("output_atoms", tokens))
+        outputAtoms_.insert(outputAtoms_.end(), tokens.begin(), tokens.end());
 
     temperature_ = cfg_parser.getDoubleKeyFromSection("general", "temp", 310);
 
@@ -130,11 +165,14 @@ void Cgtool::setupObjects(){
         switch(outProgram_){
             case FileFormat::GROMACS:
                 outname += ".xtc";
-                trjOutput_ = new XTCOutput(cgFrame_->numAtoms_, outname);
+                trjOutput_ = new XTCOutput(cgFrame_->numAtoms_, outname,
+                                           settings_["output"]["precision"], selectOutputAtoms(),
+                                           settings_["output"]["threads"]);
                 break;
             case FileFormat::LAMMPS:
-                outname += ".trj";
-                trjOutput_ = new LammpsTrjOutput(cgFrame_->numAtoms_, outname);
+                outname += settings_["output"]["binary"] ? ".bin" : ".trj";
+                trjOutput_ = new LammpsTrjOutput(cgFrame_->numAtoms_, outname,
+                                                 settings_["output"]["binary"]);
                 break;
 
         }
@@ -146,9 +184,37 @@ void Cgtool::setupObjects(){
                                    potentialTypes_, temperature_);
     }
 
-    if(settings_["rdf"]["on"])
-        rdf_ = new RDF(residues_, settings_["rdf"]["cutoff"]/100.,
-                       settings_["rdf"]["resolution"]);
+    // RDF uses the CG frame if mapping, which is the atomistic frame otherwise
+    if(settings_["rdf"]["on"]){
+        rdf_ = new RDF(settings_["map"]["on"] ? cgResidues_ : residues_,
+                       settings_["rdf"]["cutoff"]/100., settings_["rdf"]["resolution"]);
+        for(const std::array<string, 2> &pair : rdfPairs_) rdf_->addPair(pair[0], pair[1]);
+    }
+
+    if(settings_["sq"]["on"])
+        sq_ = new StructureFactor(settings_["sq"]["grid"], settings_["sq"]["bins"]);
+}
+
+vector<int> Cgtool::selectOutputAtoms() const{
+    vector<int> atoms;
+    if(outputAtoms_.empty()) return atoms;
+
+    vector<bool> selected(cgFrame_->numAtoms_, false);
+    for(const string &name : outputAtoms_){
+        bool found = false;
+        for(int i=0; i<cgFrame_->numAtoms_; i++){
+            const Atom &atom = cgFrame_->atoms_[i];
+            if(atom.atom_name == name || atom.atom_type == name){
+                selected[i] = true;
+                found = true;
+            }
+        }
+        if(!found) throw std::runtime_error("Output atom " + name + " matches no beads");
+    }
+
+    // Keep the order of the frame
+    for(int i=0; i<cgFrame_->numAtoms_; i++) if(selected[i]) atoms.push_back(i);
+    return atoms;
 }
 
 void Cgtool::mainLoop(){
@@ -163,13 +229,39 @@ void Cgtool::mainLoop(){
     }
 
     if(settings_["rdf"]["on"] && currFrame_ % settings_["rdf"]["freq"] == 0){
-        rdf_->calculateRDF(*frame_);
+        rdf_->calculateRDF(*cgFrame_);
+    }
+
+    if(settings_["sq"]["on"] && currFrame_ % settings_["sq"]["freq"] == 0){
+        sq_->calculate(*cgFrame_);
+    }
+}
+
+void Cgtool::checkpoint(Checkpoint &cp){
+    cp.section("cgtool");
+    if(bondSet_){
+        cp.section("bonds");
+        bondSet_->checkpoint(cp);
+    }
+    if(rdf_){
+        cp.section("rdf");
+        rdf_->checkpoint(cp);
+    }
+    if(sq_){
+        cp.section("sq");
+        sq_->checkpoint(cp);
+    }
+    if(trjOutput_){
+        cp.section("output");
+        trjOutput_->checkpoint(cp);
     }
 }
 
 void Cgtool::postProcess(){
     if(settings_["bonds"]["on"]){
-        bondSet_->BoltzmannInversion();
+        bondSet_->BoltzmannInversion(settings_["tables"]["on"],
+                                     settings_["tables"]["bandwidth"] / 100.,
+                                     settings_["modes"]["on"] ? settings_["modes"]["max"] : 1);
 
         printf("Printing results to ITP\n");
         ITPWriter itp(&residues_, outProgram_, outField_);
@@ -183,6 +275,18 @@ void Cgtool::postProcess(){
 
         itp.printBonds(*bondSet_);
 
+        // Tabulated potentials get their own ITP so the harmonic one remains usable
+        if(settings_["tables"]["on"]){
+            printf("Printing tabulated potentials\n");
+            bondSet_->writeTables();
+            ITPWriter itp_tab(&residues_, outProgram_, outField_,
+                              residues_[0].resname + "_tab.itp");
+            if(settings_["map"]["on"]) itp_tab.printAtoms(*cgMap_);
+            itp_tab.printBondsTabulated(*bondSet_);
+        }
+
+        bondSet_->writeCorrelations();
+
         // Write out all frame bond lengths/angles/dihedrals to file
         // This bit is slow - IO limited
         if(settings_["csv"]["on"])
@@ -212,10 +316,12 @@ void Cgtool::postProcess(){
         }
     }
     if(settings_["rdf"]["on"]) rdf_->normalize();
+    if(settings_["sq"]["on"]) sq_->normalize();
 }
 
 Cgtool::~Cgtool(){
     if(bondSet_) delete bondSet_;
     if(rdf_) delete rdf_;
+    if(sq_) delete sq_;
     if(trjOutput_) delete trjOutput_;
 }
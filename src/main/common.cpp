@@ -5,9 +5,16 @@
 #include "common.h"
 
 #include <iostream>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <cstdint>
+#include <thread>
+#include <chrono>
 
 #include <sysexits.h>
 #include <locale.h>
+#include <signal.h>
 
 #include "small_functions.h"
 
@@ -23,6 +30,24 @@ using std::cin;
 using std::endl;
 using std::vector;
 
+/** \brief Signal received during the main loop - stop and checkpoint at the end of the frame */
+static volatile sig_atomic_t stop_signal = 0;
+
+static void handle_stop_signal(int sig){
+    stop_signal = sig;
+}
+
+/** \brief FNV-1a hash of file contents - to notice a changed config on resume */
+static std::uint64_t hash_file(const string &filename){
+    std::ifstream file(filename, std::ios::binary);
+    std::uint64_t hash = 14695981039346656037ULL;
+    for(auto it = std::istreambuf_iterator<char>(file); it != std::istreambuf_iterator<char>(); ++it){
+        hash ^= static_cast<unsigned char>(*it);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
 Common::Common(){
     // Allow comma separators in numbers for printf
     setlocale(LC_ALL, "");
@@ -74,20 +99,34 @@ void Common::collectInput(const int argc, const char *argv[],
     }
 
     if(cmd_parser.getIntArg("frames") != 0) numFramesMax_ = cmd_parser.getIntArg("frames");
+
+    // Output files are appended to when resuming so must know before they are opened
+    Checkpoint::setResuming(cmd_parser.getBoolArg("resume"));
+    follow_ = cmd_parser.getBoolArg("follow");
 }
 
 int Common::run(){
     readConfig();
+    readDensityConfig();
+    readCheckpointConfig();
+    readFollowConfig();
     getResidues();
 
     // Open files and do setup
     split_text_output("Frame setup", sectionStart_);
     setupObjects();
+    for(DensityMap &map : densityMaps_)
+        map.setup(*cgFrame_, settings_["map"]["on"] ? cgResidues_ : residues_);
+    if(Checkpoint::resuming()) loadCheckpoint();
 
-    doMainLoop();
+    if(!doMainLoop()){
+        split_text_output("Interrupted - continue with --resume", veryStart_);
+        return EX_TEMPFAIL;
+    }
 
     split_text_output("Post processing", sectionStart_);
     postProcess();
+    printDensity();
 
     // Final timer
     split_text_output("Finished", veryStart_);
@@ -124,13 +163,169 @@ void Common::getResidues(){
 }
 
 
-void Common::doMainLoop(){
+void Common::readDensityConfig(){
+    Parser cfg_parser(inputFiles_["cfg"].name);
+
+    settings_["density"]["freq"] =
+            cfg_parser.getIntKeyFromSection("density", "freq", 1);
+    settings_["density"]["binary"] =
+            cfg_parser.getIntKeyFromSection("density", "binary", 0);
+
+    // Each line is selection, axes, a bin count per axis then optionally a selection to centre
+    vector<string> tokens;
+    while(cfg_parser.getLineFromSection("density_maps", tokens, 3)){
+        const string &axes = tokens[1];
+        if(tokens.size() < 2 + axes.size())
+            throw std::runtime_error("Density map " + tokens[0] + " needs a bin count for each axis");
+        vector<int> bins;
+        for(int i=0; i<axes.size(); i++) bins.push_back(std::stoi(tokens[2 + i]));
+        const string centre = tokens.size() > 2 + axes.size() ? tokens[2 + axes.size()] : "";
+        densityMaps_.emplace_back(tokens[0], axes, bins, centre);
+    }
+}
+
+void Common::readCheckpointConfig(){
+    Parser cfg_parser(inputFiles_["cfg"].name);
+
+    settings_["checkpoint"]["on"] =
+            cfg_parser.findSection("checkpoint");
+    settings_["checkpoint"]["freq"] =
+            cfg_parser.getIntKeyFromSection("checkpoint", "freq", 0);
+}
+
+void Common::readFollowConfig(){
+    Parser cfg_parser(inputFiles_["cfg"].name);
+
+    settings_["follow"]["poll"] =
+            cfg_parser.getIntKeyFromSection("follow", "poll", 1000);
+    settings_["follow"]["refresh"] =
+            cfg_parser.getIntKeyFromSection("follow", "refresh", 60);
+    settings_["follow"]["timeout"] =
+            cfg_parser.getIntKeyFromSection("follow", "timeout", 0);
+}
+
+bool Common::waitForFrames(const long size){
+    const string &xtc = inputFiles_["xtc"].name;
+    const double start = start_timer();
+    const int timeout = settings_["follow"]["timeout"];
+    while(true){
+        if(file_size(xtc) != size) return true;
+        if(stop_signal) return false;
+        if(timeout > 0 && end_timer(start) > timeout){
+            printf("\nNo new frames for %ds - finishing\n", timeout);
+            return false;
+        }
+        // Keep output current while the simulation is between frames
+        if(refreshDue()) refreshOutput();
+        std::this_thread::sleep_for(std::chrono::milliseconds(settings_["follow"]["poll"]));
+    }
+}
+
+bool Common::refreshDue() const{
+    const int refresh = settings_.at("follow").at("refresh");
+    return refresh > 0 && currFrame_ != refreshFrame_ && end_timer(lastRefresh_) >= refresh;
+}
+
+void Common::refreshOutput(){
+    cout << string(80, ' ') << "\r";
+    printf("Refreshing output after %'d frames\n", currFrame_ - 1);
+
+    Checkpoint snapshot(checkpointFile_, Checkpoint::Mode::SAVE);
+    syncCheckpoint(snapshot);
+    try{
+        postProcess();
+        printDensity();
+    }catch(const std::logic_error &e){
+        // Some analyses need more frames - try again next time
+        printf("WARNING: Could not refresh output - %s\n", e.what());
+    }
+    snapshot.rewind();
+    syncCheckpoint(snapshot);
+
+    refreshFrame_ = currFrame_;
+    lastRefresh_ = start_timer();
+}
+
+void Common::syncCheckpoint(Checkpoint &cp){
+    cp.section("common");
+    const std::uint64_t cfg_hash = hash_file(inputFiles_["cfg"].name);
+    std::uint64_t saved_hash = cfg_hash;
+    cp.sync(saved_hash);
+    if(saved_hash != cfg_hash)
+        printf("WARNING: Config file has changed since checkpoint was written\n");
+
+    cp.sync(currFrame_);
+    // Last frame is used in final output if there are no new frames
+    cp.sync(cgFrame_->time_);
+    cp.sync(cgFrame_->step_);
+    for(int i=0; i<3; i++){
+        for(int j=0; j<3; j++) cp.sync(cgFrame_->box_[i][j]);
+        if(cp.loading()) cgFrame_->boxDiag_[i] = cgFrame_->box_[i][i];
+    }
+
+    string xtc = inputFiles_["xtc"].name;
+    std::int64_t position = xtcPosition_;
+    cp.sync(xtc);
+    cp.sync(position);
+    if(cp.loading()){
+        // A different XTC is taken to be the next part of the trajectory
+        if(xtc == inputFiles_["xtc"].name){
+            frame_->seekTrajectory(position);
+        }else{
+            printf("Continuing from %s with new XTC %s\n", xtc.c_str(), inputFiles_["xtc"].name.c_str());
+            // Opening the XTC reads its first frame - which is part of the trajectory here
+            frame_->seekTrajectory(0);
+        }
+    }
+
+    int num_maps = static_cast<int>(densityMaps_.size());
+    cp.sync(num_maps);
+    if(num_maps != densityMaps_.size())
+        throw std::runtime_error("Checkpoint does not match the requested density maps");
+    for(DensityMap &map : densityMaps_) map.checkpoint(cp);
+
+    checkpoint(cp);
+}
+
+void Common::saveCheckpoint(){
+    Checkpoint cp(checkpointFile_, Checkpoint::Mode::SAVE);
+    syncCheckpoint(cp);
+    cp.save();
+}
+
+void Common::loadCheckpoint(){
+    Checkpoint cp(checkpointFile_, Checkpoint::Mode::LOAD);
+    syncCheckpoint(cp);
+    printf("Resuming from checkpoint %s after %'d frames\n", checkpointFile_.c_str(), currFrame_ - 1);
+}
+
+void Common::printDensity(){
+    for(DensityMap &map : densityMaps_){
+        map.reduce();
+        string name = "density_" + map.selection() + "_";
+        for(int d=0; d<3; d++) if(map.bins()[d] > 1) name += "xyz"[d];
+
+        // Volumetric maps as OpenDX, profiles and 2d maps as text
+        if(map.bins()[0] > 1 && map.bins()[1] > 1 && map.bins()[2] > 1){
+            map.printDX(name);
+        }else{
+            map.printText(name);
+        }
+        if(settings_["density"]["binary"]) map.printBinary(name);
+    }
+}
+
+bool Common::doMainLoop(){
     // Read and process simulation frames
     split_text_output("Reading frames", sectionStart_);
     sectionStart_ = start_timer();
 
     wholeXTCFrames_ = get_xtc_num_frames(inputFiles_["xtc"].name);
-    printf("%'8d frames in XTC\n", wholeXTCFrames_);
+    if(follow_){
+        printf("%'8d frames in XTC so far - following as it is written\n", wholeXTCFrames_);
+    }else{
+        printf("%'8d frames in XTC\n", wholeXTCFrames_);
+    }
 
     untilEnd_ = numFramesMax_ < 0;
     if(untilEnd_){
@@ -140,16 +335,54 @@ void Common::doMainLoop(){
     }
 
     lastUpdate_ = start_timer();
+    lastRefresh_ = lastUpdate_;
+    refreshFrame_ = currFrame_;
+
+    // Stop cleanly at the end of a frame - a second signal is not caught
+    struct sigaction action = {};
+    action.sa_handler = handle_stop_signal;
+    action.sa_flags = SA_RESETHAND;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
 
     // Process each frame as we read it, frames are not retained
+    xtcPosition_ = frame_->trajectoryPosition();
+    const int checkpoint_freq = settings_["checkpoint"]["freq"];
     bool end = false;
     while(!end){
-        end = !(frame_->readNext() && (untilEnd_ || currFrame_ < numFramesMax_));
+        // Size before reading - so growth after a short read is not missed
+        const long size = follow_ ? file_size(inputFiles_["xtc"].name) : 0;
+        bool read = frame_->readNext();
+        if(follow_){
+            // Last frame may be partly written - go back to the end of the previous frame and retry
+            long read_size = size;
+            while(!read && waitForFrames(read_size)){
+                read_size = file_size(inputFiles_["xtc"].name);
+                frame_->seekTrajectory(xtcPosition_);
+                read = frame_->readNext();
+            }
+        }
+        // No new frame - don't process the previous one again
+        if(!read) break;
+        xtcPosition_ = frame_->trajectoryPosition();
+
+        end = !(untilEnd_ || currFrame_ < numFramesMax_);
         if(currFrame_ % updateFreq_[updateLoc_] == 0) updateProgress();
         currFrame_++;
         mainLoop();
+        if(currFrame_ % settings_["density"]["freq"] == 0){
+            for(DensityMap &map : densityMaps_) map.add(*cgFrame_);
+        }
+
+        if(stop_signal) break;
+        if(checkpoint_freq > 0 && currFrame_ % checkpoint_freq == 0) saveCheckpoint();
+        if(follow_ && refreshDue()) refreshOutput();
     }
 
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    if(stop_signal || settings_["checkpoint"]["on"]) saveCheckpoint();
+
     // Print some data at the end
     cout << string(80, ' ') << "\r";
     printf("Read %'10d frames", currFrame_);
@@ -163,6 +396,12 @@ void Common::doMainLoop(){
     }
     printf("\n");
 
+    if(stop_signal){
+        printf("Stopped by signal %d - checkpoint written to %s\n",
+               static_cast<int>(stop_signal), checkpointFile_.c_str());
+        return false;
+    }
+    return true;
 }
 
 void Common::updateProgress(){
@@ -179,8 +418,13 @@ void Common::updateProgress(){
     double t_remain = (numFramesMax_ - currFrame_) / fps;
     if(numFramesMax_ < 0) t_remain = (wholeXTCFrames_ - currFrame_) / fps;
 
-    printf("Read %'10d frames @ %'d FPS %6.1fs remaining\r",
-           currFrame_, static_cast<int>(fps), t_remain);
+    // Length of a growing XTC is not known
+    if(follow_ && numFramesMax_ < 0){
+        printf("Read %'10d frames @ %'d FPS\r", currFrame_, static_cast<int>(fps));
+    }else{
+        printf("Read %'10d frames @ %'d FPS %6.1fs remaining\r",
+               currFrame_, static_cast<int>(fps), t_remain);
+    }
     std::flush(cout);
 
     lastUpdate_ = start_timer();
@@ -1,5 +1,6 @@
 #include <string>
 #include <vector>
+#include <array>
 
 #include "ramsi.h"
 
@@ -28,7 +29,9 @@ int main(const int argc, const char *argv[]){
             "--cfg\tRAMSi config file\t0\n"
             "--xtc\tGROMACS XTC file\t0\n"
             "--gro\tGROMACS GRO file\t0\n"
-            "--frames\tNumber of frames\t1\t-1";
+            "--frames\tNumber of frames\t1\t-1\n"
+            "--resume\tContinue from checkpoint\t3\t0\n"
+            "--follow\tKeep reading XTC as it is written\t3\t0";
 
     const string compile_info =
             #include "compile_info.inc"
@@ -47,6 +50,7 @@ int main(const int argc, const char *argv[]){
 
 void Ramsi::readConfig(){
     Parser cfg_parser(inputFiles_["cfg"].name);
+    checkpointFile_ = "ramsi.cpt";
 
     settings_["map"]["on"] =
             cfg_parser.findSection("mapping");
@@ -63,6 +67,26 @@ void Ramsi::readConfig(){
             cfg_parser.getIntKeyFromSection("membrane", "blocks", 4);
     settings_["mem"]["header"] =
             cfg_parser.getIntKeyFromSection("membrane", "header", 1);
+    settings_["mem"]["voronoi"] =
+            cfg_parser.getIntKeyFromSection("membrane", "voronoi", 1);
+    settings_["mem"]["track"] =
+            cfg_parser.getIntKeyFromSection("membrane", "track", 1);
+    settings_["mem"]["spectrum"] =
+            cfg_parser.getIntKeyFromSection("membrane", "spectrum", 1);
+    spectrumQMax_ = cfg_parser.getDoubleKeyFromSection("membrane", "spectrum_qmax", 1.);
+    temperature_ = cfg_parser.getDoubleKeyFromSection("general", "temp", 310.);
+    proteinRadius_ = cfg_parser.getDoubleKeyFromSection("membrane", "protein_radius", 0.3);
+    smoothSigma_ = cfg_parser.getDoubleKeyFromSection("membrane", "smooth", 0.);
+
+    vector<string> tokens;
+    while(cfg_parser.getLineFromSection("order", tokens, 3))
+        orderChains_.push_back(tokens);
+    settings_["order"]["on"] = !orderChains_.empty();
+
+    settings_["diff"]["on"] =
+            cfg_parser.findSection("diffusion");
+    diffusionStart_ = cfg_parser.getDoubleKeyFromSection("diffusion", "start", 0.);
+    diffusionEnd_ = cfg_parser.getDoubleKeyFromSection("diffusion", "end", -1.);
 
     if(numFramesMax_ == 0)
         numFramesMax_ = cfg_parser.getIntKeyFromSection("general", "frames", -1);
@@ -84,7 +108,37 @@ void Ramsi::setupObjects(){
     }
 
     membrane_ = new Membrane(residues_, *frame_, settings_["mem"]["resolution"],
-                             settings_["mem"]["blocks"], settings_["mem"]["header"]);
+                             settings_["mem"]["blocks"], settings_["mem"]["header"],
+                             settings_["mem"]["voronoi"], proteinRadius_,
+                             settings_["mem"]["track"], settings_["mem"]["spectrum"],
+                             smoothSigma_);
+
+    if(settings_["order"]["on"]){
+        order_ = new OrderParameter(cgResidues_, settings_["mem"]["resolution"]);
+        for(const vector<string> &chain : orderChains_)
+            order_->addChain(chain[0], vector<string>(chain.begin() + 1, chain.end()));
+    }
+
+    if(settings_["diff"]["on"]){
+        // Lipids keep the leaflet they start in - drift is removed per leaflet
+        // and from protein relative to the whole membrane
+        vector<int> group;
+        for(const int head : membrane_->lipidHeads()){
+            diffusionAtoms_.push_back(head);
+            group.push_back(membrane_->leaflet(head) > 0 ? 0 : 1);
+        }
+        vector<string> names = {"upper", "lower"};
+        vector<unsigned> reference = {1u, 2u};
+        if(!membrane_->proteinAtoms().empty()){
+            for(const int atom : membrane_->proteinAtoms()){
+                diffusionAtoms_.push_back(atom);
+                group.push_back(2);
+            }
+            names.push_back("protein");
+            reference.push_back(3u);
+        }
+        diffusion_ = new Diffusion(group, names, reference);
+    }
 }
 
 void Ramsi::mainLoop(){
@@ -94,9 +148,21 @@ void Ramsi::mainLoop(){
 
     // Membrane calculations
     if(currFrame_ % settings_["mem"]["freq"] == 0){
-        thickness_.push_back(membrane_->thickness(*cgFrame_));
-        membrane_->curvature(*cgFrame_);
+        // Membrane was set up from the unmapped residues so uses atom numbers of the unmapped frame
+        thickness_.push_back(membrane_->thickness(*frame_));
+        membrane_->curvature(*frame_);
         membrane_->printCSVAreaPerLipid(cgFrame_->time_);
+        // Membrane leaflets refer to the unmapped residues - use lipid orientation if mapping
+        if(order_) order_->calculate(*cgFrame_, settings_["map"]["on"] ? nullptr : membrane_);
+
+        if(diffusion_){
+            vector<std::array<double, 2>> positions(diffusionAtoms_.size());
+            for(int i=0; i<diffusionAtoms_.size(); i++){
+                const std::array<double, 3> &coords = frame_->atoms_[diffusionAtoms_[i]].coords;
+                positions[i] = {{coords[0], coords[1]}};
+            }
+            diffusion_->add(positions, {{frame_->box_[0][0], frame_->box_[1][1]}}, frame_->time_);
+        }
     }
 
     if(settings_["mem"]["export"] > 0){
@@ -104,24 +170,72 @@ void Ramsi::mainLoop(){
             membrane_->normalize(0);
             membrane_->printCSV("thickness_" + std::to_string(currFrame_));
             membrane_->printCSVCurvature("curvature_" + std::to_string(currFrame_));
+            if(settings_["mem"]["voronoi"])
+                membrane_->printCSVVoronoi("voronoi_" + std::to_string(currFrame_));
+            membrane_->printCSVProtein("protein_" + std::to_string(currFrame_));
             membrane_->reset();
+            if(order_){
+                order_->print("order_" + std::to_string(currFrame_), settings_["mem"]["header"]);
+                order_->printCSVMaps("order_map_" + std::to_string(currFrame_), settings_["mem"]["header"]);
+                order_->reset();
+            }
         }
     }
 }
 
+void Ramsi::checkpoint(Checkpoint &cp){
+    cp.section("ramsi");
+    cp.sync(thickness_);
+    cp.section("membrane");
+    membrane_->checkpoint(cp);
+    if(order_){
+        cp.section("order");
+        order_->checkpoint(cp);
+    }
+    if(diffusion_){
+        cp.section("diffusion");
+        diffusion_->checkpoint(cp);
+    }
+}
+
 void Ramsi::postProcess(){
     if(settings_["mem"]["export"] < 0){
         membrane_->normalize(0);
         membrane_->printCSV("thickness_avg");
         membrane_->printCSVCurvature("curvature_final");
+        if(settings_["mem"]["voronoi"]) membrane_->printCSVVoronoi("voronoi_final");
+        membrane_->printCSVProtein("protein_avg");
         membrane_->printCSVAreaPerLipid(cgFrame_->time_);
+        if(order_){
+            order_->print("order", settings_["mem"]["header"]);
+            order_->printCSVMaps("order_map", settings_["mem"]["header"]);
+        }
     }
     double mean = vector_mean(thickness_);
     double se = vector_stderr(thickness_);
 
     printf("Thickness mean: %8.3f, SE %8.3e\n", mean, se);
+
+    if(settings_["mem"]["spectrum"]){
+        membrane_->printSpectrum("spectrum", spectrumQMax_, temperature_);
+        double kappa, sigma;
+        if(membrane_->elasticConstants(spectrumQMax_, temperature_, kappa, sigma))
+            printf("Bending modulus: %8.3f kJ/mol, tension %8.3f kJ/mol/nm^2\n", kappa, sigma);
+    }
+
+    if(diffusion_){
+        diffusion_->calculate();
+        diffusion_->print("msd", diffusionStart_, diffusionEnd_, settings_["mem"]["header"]);
+        for(int g=0; g<diffusion_->numGroups(); g++){
+            double D;
+            if(diffusion_->fit(g, diffusionStart_, diffusionEnd_, D))
+                printf("Lateral diffusion %7s: %8.3f um^2/s\n", diffusion_->groupName(g).c_str(), D * 1e6);
+        }
+    }
 }
 
 Ramsi::~Ramsi(){
     if(membrane_) delete membrane_;
+    if(order_) delete order_;
+    if(diffusion_) delete diffusion_;
 }
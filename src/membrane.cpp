@@ -4,37 +4,60 @@
 
 #include "membrane.h"
 
+#include <set>
+#include <algorithm>
+
 #include "small_functions.h"
+#include "plane_grid.h"
 
 using std::string;
 using std::vector;
 using std::array;
-using std::map;
 using std::set;
 using std::abs;
 
 Membrane::Membrane(const vector<Residue> &residues, const Frame &frame,
-                   const int resolution, const int blocks, const bool header) :
-        residues_(residues), header_(header){
+                   const int resolution, const int blocks, const bool header,
+                   const bool voronoi, const double protein_radius, const bool track,
+                   const bool spectrum, const double smooth_sigma) :
+        track_(track), blocks_(blocks), proteinRadius_(protein_radius), residues_(residues),
+        voronoi_(voronoi), spectrum_(spectrum), smoothSigma_(smooth_sigma), header_(header){
     setResolution(resolution);
     sortBilayer(frame, blocks);
     prepCSVAreaPerLipid();
     prepCSVAvgThickness();
+    if(track_) prepCSVFlipFlop();
 }
 
 Membrane::~Membrane(){
     fclose(aplFile_);
     fclose(avgFile_);
+    if(flipFile_) fclose(flipFile_);
 };
 
 void Membrane::sortBilayer(const Frame &frame, const int blocks){
     // Reset running values
     numLipids_ = 0;
-    upperHeads_.clear();
-    lowerHeads_.clear();
+    lipidHead_.clear();
+    headLipid_.clear();
+    lipidTail_.clear();
+    lipidType_.clear();
+    lipidUpper_.clear();
     protAtoms_.clear();
-    lowerNumRes_.clear();
-    upperNumRes_.clear();
+
+    // Residues with the same name are one type - set keeps them sorted
+    set<string> names;
+    for(const Residue &res : residues_){
+        if(res.ref_atom >= 0) names.insert(res.resname);
+    }
+    resTypes_.assign(names.begin(), names.end());
+    const int num_types = static_cast<int>(resTypes_.size());
+    upperLipidFrames_.assign(num_types, 0);
+    lowerLipidFrames_.assign(num_types, 0);
+    upperResPPL_.assign(num_types, 0);
+    lowerResPPL_.assign(num_types, 0);
+    upperResArea_.assign(num_types, 0.);
+    lowerResArea_.assign(num_types, 0.);
 
     // Copy box from Frame - assume orthorhombic
     box_[0] = frame.box_[0][0];
@@ -66,6 +89,8 @@ void Membrane::sortBilayer(const Frame &frame, const int blocks){
     // Separate membrane into upper and lower
     for(const Residue &res : residues_){
         if(res.ref_atom < 0) continue;
+        const int type = static_cast<int>(std::lower_bound(resTypes_.begin(), resTypes_.end(), res.resname)
+                                          - resTypes_.begin());
         int num_in_leaflet[2] = {0, 0};
         for(int i = 0; i < res.num_residues; i++){
             const int num = res.ref_atom + i * res.num_atoms + res.start;
@@ -76,19 +101,18 @@ void Membrane::sortBilayer(const Frame &frame, const int blocks){
             minz = std::min(minz, z);
             maxz = std::max(maxz, z);
 
-            if(z < block_avg_z(x, y)){
-                lowerHeads_.push_back(num);
-                num_in_leaflet[0]++;
-                lowerNumRes_[res.resname]++;
-            }else{
-                upperHeads_.push_back(num);
-                num_in_leaflet[1]++;
-                upperNumRes_[res.resname]++;
-            }
+            const bool upper = !(z < block_avg_z(x, y));
+            headLipid_[num] = static_cast<int>(lipidHead_.size());
+            lipidHead_.push_back(num);
+            lipidTail_.push_back(res.start + (i + 1) * res.num_atoms - 1);
+            lipidType_.push_back(type);
+            lipidUpper_.push_back(upper);
+            num_in_leaflet[upper]++;
         }
         printf("%5s: %'4d lower, %'4d upper\n",
                res.resname.c_str(), num_in_leaflet[0], num_in_leaflet[1]);
     }
+    rebuildLeaflets();
 
     for(const Residue &res : residues_){
         if(res.resname != "PROT") continue;
@@ -102,6 +126,119 @@ void Membrane::sortBilayer(const Frame &frame, const int blocks){
     }
 }
 
+void Membrane::rebuildLeaflets(){
+    upperHeads_.clear();
+    lowerHeads_.clear();
+    upperHeadType_.clear();
+    lowerHeadType_.clear();
+    upperNumRes_.assign(resTypes_.size(), 0);
+    lowerNumRes_.assign(resTypes_.size(), 0);
+
+    for(int l=0; l<lipidHead_.size(); l++){
+        if(lipidUpper_[l]){
+            upperHeads_.push_back(lipidHead_[l]);
+            upperHeadType_.push_back(lipidType_[l]);
+            upperNumRes_[lipidType_[l]]++;
+        }else{
+            lowerHeads_.push_back(lipidHead_[l]);
+            lowerHeadType_.push_back(lipidType_[l]);
+            lowerNumRes_[lipidType_[l]]++;
+        }
+    }
+}
+
+void Membrane::updateLeaflets(const Frame &frame){
+    const int num = static_cast<int>(lipidHead_.size());
+    if(num == 0) return;
+
+    // Local midplane is the mean head group height in each block
+    LightArray<double> block_z(blocks_, blocks_);
+    LightArray<double> block_num(blocks_, blocks_);
+    vector<int> block(num);
+    double mean_z = 0.;
+    for(int l=0; l<num; l++){
+        const array<double, 3> &coords = frame.atoms_[lipidHead_[l]].coords;
+        const int x = wrap(static_cast<int>(std::floor(coords[0] * blocks_ / box_[0])), 0, blocks_);
+        const int y = wrap(static_cast<int>(std::floor(coords[1] * blocks_ / box_[1])), 0, blocks_);
+        block[l] = x * blocks_ + y;
+        block_z(x, y) += coords[2];
+        block_num(x, y)++;
+        mean_z += coords[2];
+    }
+    mean_z /= num;
+
+    vector<double> mid(blocks_ * blocks_);
+    for(int x=0; x<blocks_; x++){
+        for(int y=0; y<blocks_; y++){
+            mid[x * blocks_ + y] = block_num(x, y) > 0 ? block_z(x, y) / block_num(x, y) : mean_z;
+        }
+    }
+
+    // Lipids further than this from the midplane on their own side need no checking
+    double margin = 0.;
+    for(int l=0; l<num; l++) margin += abs(frame.atoms_[lipidHead_[l]].coords[2] - mid[block[l]]);
+    margin *= 0.5 / num;
+
+    bool changed = false;
+    for(int l=0; l<num; l++){
+        const double height = frame.atoms_[lipidHead_[l]].coords[2] - mid[block[l]];
+        const bool upper = lipidUpper_[l];
+        if(upper ? height > margin : height < -margin) continue;
+
+        // Head above tail for upper leaflet - use position alone if lipid is a single particle
+        const bool side = height > 0.;
+        bool orient = side;
+        if(lipidTail_[l] != lipidHead_[l]){
+            double dz = frame.atoms_[lipidHead_[l]].coords[2] - frame.atoms_[lipidTail_[l]].coords[2];
+            dz -= box_[2] * nint(dz / box_[2]);
+            orient = dz > 0.;
+        }
+        if(side == upper || orient == upper) continue;
+
+        lipidUpper_[l] = side;
+        changed = true;
+        fprintf(flipFile_, "%12.3f%8d%8s%8s%8s\n", frame.time_, lipidHead_[l] + 1,
+                resTypes_[lipidType_[l]].c_str(), upper ? "upper" : "lower", side ? "upper" : "lower");
+    }
+
+    if(changed){
+        fflush(flipFile_);
+        rebuildLeaflets();
+    }
+}
+
+void Membrane::checkpoint(Checkpoint &cp){
+    cp.sync(numFrames_);
+    cp.sync(box_);
+    cp.sync(step_);
+    thickness_.checkpoint(cp);
+    protOccupancy_.checkpoint(cp);
+    closestUpper_.checkpoint(cp);
+    closestLower_.checkpoint(cp);
+    curvMean_.checkpoint(cp);
+    curvGaussian_.checkpoint(cp);
+    cp.sync(upperResPPL_);
+    cp.sync(lowerResPPL_);
+    cp.sync(upperResArea_);
+    cp.sync(lowerResArea_);
+    cp.sync(upperLipidFrames_);
+    cp.sync(lowerLipidFrames_);
+    undulation_.checkpoint(cp);
+    upperVoronoi_.checkpoint(cp);
+    lowerVoronoi_.checkpoint(cp);
+
+    // Lipids may have flipped since the first frame
+    const size_t num_lipids = lipidUpper_.size();
+    cp.sync(lipidUpper_);
+    if(lipidUpper_.size() != num_lipids)
+        throw std::runtime_error("Membrane checkpoint does not match the number of lipids");
+    if(cp.loading()) rebuildLeaflets();
+
+    cp.syncFile(aplFile_);
+    cp.syncFile(avgFile_);
+    cp.syncFile(flipFile_);
+}
+
 double Membrane::thickness(const Frame &frame, const bool with_reset){
     if(with_reset) reset();
 
@@ -113,21 +250,23 @@ double Membrane::thickness(const Frame &frame, const bool with_reset){
     step_[1] = box_[1] / grid_;
 
     double avg_thickness = 0;
-//    sortBilayer(frame, 4);
-
-#pragma omp parallel sections reduction(+:avg_thickness) default(shared)
-    {
-#pragma omp section
-        {
-            makePairs(frame, upperHeads_, lowerHeads_, upperPair_);
-            avg_thickness += closestLipid(frame, upperHeads_, upperPair_, upperResPPL_, closestUpper_);
-        }
-#pragma omp section
-        {
-            makePairs(frame, lowerHeads_, upperHeads_, lowerPair_);
-            avg_thickness += closestLipid(frame, lowerHeads_, lowerPair_, lowerResPPL_, closestLower_);
-        }
+    if(track_) updateLeaflets(frame);
+    for(int t=0; t<resTypes_.size(); t++){
+        upperLipidFrames_[t] += upperNumRes_[t];
+        lowerLipidFrames_[t] += lowerNumRes_[t];
     }
+    if(protein_ && proteinRadius_ > 0.) rasteriseProtein(frame);
+
+    // Leaflets are done in turn - each step is parallel inside
+    makePairs(frame, upperHeads_, lowerHeads_, upperPair_);
+    avg_thickness += closestLipid(frame, upperHeads_, upperHeadType_, upperPair_, upperResPPL_, closestUpper_);
+    if(voronoi_) voronoiArea(frame, upperHeads_, upperHeadType_, upperVoronoi_, upperResArea_);
+
+    makePairs(frame, lowerHeads_, upperHeads_, lowerPair_);
+    avg_thickness += closestLipid(frame, lowerHeads_, lowerHeadType_, lowerPair_, lowerResPPL_, closestLower_);
+    if(voronoi_) voronoiArea(frame, lowerHeads_, lowerHeadType_, lowerVoronoi_, lowerResArea_);
+
+    if(spectrum_) addSpectrum(frame);
 
     avg_thickness /= 2;
     fprintf(avgFile_, "%8.3f%8.3f\n", frame.time_, avg_thickness);
@@ -137,119 +276,194 @@ double Membrane::thickness(const Frame &frame, const bool with_reset){
 }
 
 void Membrane::makePairs(const Frame &frame, const vector<int> &ref,
-                         const vector<int> &other, map<int, double> &pairs){
-    // For each reference particle in the ref leaflet
-    for(const int i : ref){
-        double min_dist_2 = box_[0] * box_[1];
-        array<double, 3> r_i = frame.atoms_[i].coords;
-
-        // Find the closest reference particle in the other leaflet
-        array<double, 3> r_j = {{0., 0., 0.}};
-        for(const int j : other){
-            r_j[0] = frame.atoms_[j].coords[0];
-            r_j[1] = frame.atoms_[j].coords[1];
-
-            const double dist_2 = distSqrPlane(r_i, r_j, frame.boxDiag_);
-            if(dist_2 < min_dist_2){
-                min_dist_2 = dist_2;
-                r_j[2] = frame.atoms_[j].coords[2];
-            }
-        }
+                         const vector<int> &other, vector<double> &pairs){
+    const double box_diag2 = box_[0] * box_[1];
 
-        pairs[i] = abs(r_i[2] - r_j[2]);
+    vector<array<double, 3>> other_cache(other.size());
+    for(int k=0; k<other.size(); k++) other_cache[k] = frame.atoms_[other[k]].coords;
+    PlaneGrid other_grid;
+    other_grid.build(other_cache, box_);
+
+    pairs.resize(ref.size());
+
+    // For each reference particle in the ref leaflet find the closest in the other leaflet
+#pragma omp parallel for default(none) shared(frame, ref, other, other_grid, pairs, box_diag2)
+    for(int k=0; k<ref.size(); k++){
+        const array<double, 3> &r_i = frame.atoms_[ref[k]].coords;
+        double min_dist_2;
+        const int closest = other_grid.nearest(r_i, box_diag2, min_dist_2);
+        const double z_j = closest < 0 ? 0. : frame.atoms_[other[closest]].coords[2];
+        pairs[k] = abs(r_i[2] - z_j);
     }
 }
 
-//TODO optimise this more - it takes ~80% of runtime
 double Membrane::closestLipid(const Frame &frame, const vector<int> &ref,
-                              const map<int, double> &pairs,
-                              map<string, int> &resPPL, LightArray<int> &closest){
+                              const vector<int> &head_type, const vector<double> &pairs,
+                              vector<int> &resPPL, LightArray<int> &closest){
     const double box_diag2 = box_[0] * box_[1];
 
-    const size_t ref_len = ref.size();
     vector<array<double, 3>> ref_cache(ref.size());
-    vector<int> ref_lookup(ref.size());
-    {
-        int it = 0;
-        for(const int r : ref){
-            ref_cache[it] = frame.atoms_[r].coords;
-            ref_lookup[it] = r;
-            it++;
-        }
-    }
-
-    const size_t prot_len = protAtoms_.size();
-    vector<array<double, 3>> prot_cache(prot_len);
-    if(protein_){
-        int it = 0;
-        for(const int r : protAtoms_){
-            prot_cache[it] = frame.atoms_[r].coords;
-            it++;
-        }
+    for(int k=0; k<ref.size(); k++) ref_cache[k] = frame.atoms_[ref[k]].coords;
+    PlaneGrid ref_grid;
+    ref_grid.build(ref_cache, box_);
+
+    PlaneGrid prot_grid;
+    const bool use_mask = proteinRadius_ > 0.;
+    if(protein_ && !use_mask){
+        vector<array<double, 3>> prot_cache(protAtoms_.size());
+        for(int k=0; k<protAtoms_.size(); k++) prot_cache[k] = frame.atoms_[protAtoms_[k]].coords;
+        prot_grid.build(prot_cache, box_);
     }
 
     double sum = 0;
     int n_vals = 0;
+    const int num_types = static_cast<int>(resPPL.size());
 
-#pragma omp parallel for default(none) \
- shared(frame, ref, pairs, closest, ref_cache, ref_lookup, prot_cache, resPPL) \
+#pragma omp parallel default(none) \
+ shared(frame, ref, head_type, pairs, closest, ref_grid, prot_grid, resPPL, box_diag2, use_mask, num_types) \
  reduction(+: sum, n_vals)
-    for(int i=0; i<grid_; i++){
-        array<double, 3> grid_coords;
-        grid_coords[0] = (i + 0.5) * step_[0];
-
-        for(int j=0; j<grid_; j++){
-            grid_coords[1] = (j + 0.5) * step_[1];
-            double min_dist2 = box_diag2;
-
-            // Find closest lipid in reference leaflet
-            int closest_int = -1;
-            for(int k=0; k<ref_len; k++){
-                const double dist2 = distSqrPlane(grid_coords, ref_cache[k],
-                                                  frame.boxDiag_);
-                if(dist2 < min_dist2){
-                    closest_int = k;
-                    min_dist2 = dist2;
-                }
-            }
-
-            bool is_protein = false;
-            if(protein_){
-                for(int k=0; k<prot_len; k++){
-                    const double dist2 = distSqrPlane(grid_coords, prot_cache[k],
-                                                      frame.boxDiag_);
-                    if(dist2 < min_dist2){
-                        is_protein = true;
-                        break;
+    {
+        vector<int> local_ppl(num_types, 0);
+
+        // Each row of the grid belongs to one thread so closest and thickness_ need no synchronisation
+#pragma omp for schedule(static)
+        for(int i=0; i<grid_; i++){
+            array<double, 3> grid_coords = {{(i + 0.5) * step_[0], 0., 0.}};
+
+            for(int j=0; j<grid_; j++){
+                grid_coords[1] = (j + 0.5) * step_[1];
+
+                // Find closest lipid in reference leaflet - lowest index wins a tie
+                double min_dist2 = box_diag2;
+                const int closest_int = ref_grid.nearest(grid_coords, box_diag2, min_dist2);
+
+                // Grid point belongs to protein if covered by the mask
+                // Without a protein radius, if any protein atom is closer than the lipid
+                if(protein_){
+                    double prot_dist2;
+                    if(use_mask ? isProtein(i, j) : prot_grid.nearest(grid_coords, min_dist2, prot_dist2) >= 0){
+                        closest(i, j) = -1;
+                        continue;
                     }
                 }
-            }
 
-            if(is_protein){
-//#pragma omp atomic update
-//                resPPL["PROT"]++;
-            }else{
-                const int close_ref = ref_lookup[closest_int];
-                closest(i, j) = close_ref;
-                const double tmp = pairs.at(close_ref);
-                for(const Residue &res : residues_){
-                    if(close_ref >= res.start && close_ref < res.end){
-#pragma omp atomic update
-                        resPPL[res.resname]++;
-                    }
-                }
+                closest(i, j) = ref[closest_int];
+                local_ppl[head_type[closest_int]]++;
 
+                const double tmp = pairs[closest_int];
                 n_vals++;
                 sum += tmp;
-#pragma omp atomic update
                 thickness_(i, j) += tmp;
             }
         }
+
+#pragma omp critical
+        for(int t=0; t<num_types; t++) resPPL[t] += local_ppl[t];
     }
 
     return sum / n_vals;
 }
 
+void Membrane::rasteriseProtein(const Frame &frame){
+    std::fill(protMask_.begin(), protMask_.end(), 0);
+    const double r2 = proteinRadius_ * proteinRadius_;
+    // Grid points which may be within radius of an atom along each axis
+    const int reach[2] = {static_cast<int>(proteinRadius_ / step_[0]) + 1,
+                          static_cast<int>(proteinRadius_ / step_[1]) + 1};
+
+#pragma omp parallel for default(shared) schedule(static)
+    for(int k=0; k<protAtoms_.size(); k++){
+        const array<double, 3> &coords = frame.atoms_[protAtoms_[k]].coords;
+        const int ci = static_cast<int>(std::floor(coords[0] / step_[0]));
+        const int cj = static_cast<int>(std::floor(coords[1] / step_[1]));
+
+        for(int di=-reach[0]; di<=reach[0]; di++){
+            double dx = (ci + di + 0.5) * step_[0] - coords[0];
+            if(dx * dx > r2) continue;
+            const int i = ((ci + di) % grid_ + grid_) % grid_;
+            for(int dj=-reach[1]; dj<=reach[1]; dj++){
+                const double dy = (cj + dj + 0.5) * step_[1] - coords[1];
+                if(dx * dx + dy * dy > r2) continue;
+                const int j = ((cj + dj) % grid_ + grid_) % grid_;
+                const int bit = i * grid_ + j;
+#pragma omp atomic update
+                protMask_[bit / 64] |= std::uint64_t(1) << (bit % 64);
+            }
+        }
+    }
+
+    for(int i=0; i<grid_; i++){
+        for(int j=0; j<grid_; j++){
+            if(isProtein(i, j)) protOccupancy_(i, j)++;
+        }
+    }
+}
+
+void Membrane::voronoiArea(const Frame &frame, const vector<int> &heads, const vector<int> &head_type,
+                           Voronoi &voronoi, vector<double> &res_area){
+    vector<array<double, 3>> coords(heads.size());
+    for(int k=0; k<heads.size(); k++) coords[k] = frame.atoms_[heads[k]].coords;
+    voronoi.tessellate(coords, box_);
+
+    for(int k=0; k<heads.size(); k++){
+        res_area[head_type[k]] += voronoi.areas()[k];
+    }
+}
+
+void Membrane::leafletHeight(const Frame &frame, const LightArray<int> &closest,
+                             LightArray<double> &height) const{
+    height.alloc(grid_, grid_);
+    double sum = 0.;
+    int n_vals = 0;
+    for(int i=0; i<grid_; i++){
+        for(int j=0; j<grid_; j++){
+            const int head = closest.at(i, j);
+            if(head < 0) continue;
+            height(i, j) = frame.atoms_[head].coords[2];
+            sum += height(i, j);
+            n_vals++;
+        }
+    }
+
+    // Fill protein with the mean so it adds no fluctuation of its own
+    const double mean = n_vals > 0 ? sum / n_vals : 0.;
+    for(int i=0; i<grid_; i++){
+        for(int j=0; j<grid_; j++){
+            if(closest.at(i, j) < 0) height(i, j) = mean;
+        }
+    }
+}
+
+void Membrane::addSpectrum(const Frame &frame){
+    LightArray<double> upper, lower;
+    leafletHeight(frame, closestUpper_, upper);
+    leafletHeight(frame, closestLower_, lower);
+
+    LightArray<double> height(grid_, grid_);
+    LightArray<double> thick(grid_, grid_);
+    for(int i=0; i<grid_; i++){
+        for(int j=0; j<grid_; j++){
+            height(i, j) = 0.5 * (upper.at(i, j) + lower.at(i, j));
+            thick(i, j) = upper.at(i, j) - lower.at(i, j);
+        }
+    }
+
+    undulation_.add(height, thick, box_);
+}
+
+bool Membrane::elasticConstants(const double q_max, const double temperature,
+                                double &kappa, double &sigma) const{
+    const double kT = 8.314 * temperature / 1000.;
+    return undulation_.fit(q_max, kT, kappa, sigma);
+}
+
+void Membrane::printSpectrum(const std::string &filename, const double q_max,
+                             const double temperature) const{
+    if(undulation_.frames() == 0) return;
+    const double kT = 8.314 * temperature / 1000.;
+    undulation_.print(filename, q_max, kT, header_);
+}
+
 void Membrane::curvature(const Frame &frame){
     LightArray<double> avg_z(grid_, grid_);
 
@@ -263,18 +477,21 @@ void Membrane::curvature(const Frame &frame){
     double curv_y_avg = 0.;
 
     // Calculate average z coord on grid
+    LightArray<double> upper, lower;
+    leafletHeight(frame, closestUpper_, upper);
+    leafletHeight(frame, closestLower_, lower);
     for (int i = 0; i < grid_; i++) {
         for (int j = 0; j < grid_; j++) {
-            avg_z(i, j) = (frame.atoms_[closestUpper_.at(i, j)].coords[2] +
-                           frame.atoms_[closestLower_.at(i, j)].coords[2]) / 2.;
+            avg_z(i, j) = (upper.at(i, j) + lower.at(i, j)) / 2.;
         }
     }
 
-    // Do finite differences wrt x and y
-    for (int i = 1; i < grid_ - 1; i++) {
-        for (int j = 1; j < grid_ - 1; j++) {
-            respect_to_x(i, j) = inv_h2_x * (avg_z(i + 1, j) + avg_z(i - 1, j) - 2 * avg_z(i, j));
-            respect_to_y(i, j) = inv_h2_y * (avg_z(i, j + 1) + avg_z(i, j - 1) - 2 * avg_z(i, j));
+    // Do finite differences wrt x and y - across the periodic boundary if filtering
+    const int edge = smoothSigma_ > 0. ? 0 : 1;
+    for (int i = edge; i < grid_ - edge; i++) {
+        for (int j = edge; j < grid_ - edge; j++) {
+            respect_to_x(i, j) = inv_h2_x * (avg_z.at(i + 1, j) + avg_z.at(i + grid_ - 1, j) - 2 * avg_z(i, j));
+            respect_to_y(i, j) = inv_h2_y * (avg_z.at(i, j + 1) + avg_z.at(i, j + grid_ - 1) - 2 * avg_z(i, j));
 
             curv_x_avg += respect_to_x(i, j);
             curv_y_avg += respect_to_y(i, j);
@@ -291,8 +508,14 @@ void Membrane::curvature(const Frame &frame){
         }
     }
 
-    curvMean_.smooth(5);
-    curvGaussian_.smooth(5);
+    if(smoothSigma_ > 0.){
+        const double sigma = 2. * smoothSigma_ / (step_[0] + step_[1]);
+        curvMean_.gaussianFilter(sigma);
+        curvGaussian_.gaussianFilter(sigma);
+    }else{
+        curvMean_.smooth(5);
+        curvGaussian_.smooth(5);
+    }
 }
 
 void Membrane::printCSVCurvature(const std::string &filename) const{
@@ -325,9 +548,8 @@ void Membrane::printCSVCurvature(const std::string &filename) const{
 
 void Membrane::prepCSVAreaPerLipid(){
     const string file = "APL.dat";
-    // Backup using small_functions.h
-    backup_old_file(file);
-    aplFile_ = fopen(file.c_str(), "w");
+    // Appended to if resuming from a checkpoint
+    aplFile_ = open_stream_file(file);
     if(!aplFile_) throw std::runtime_error("Could not open output file");
 
     if(header_){
@@ -336,39 +558,108 @@ void Membrane::prepCSVAreaPerLipid(){
         fprintf(aplFile_, "@ylabel APL (nm^2)\n");
     }
 
-    for(const auto &ppl : upperResPPL_) fprintf(aplFile_, "%5s", ppl.first.c_str());
-    for(const auto &ppl : lowerResPPL_) fprintf(aplFile_, "%5s", ppl.first.c_str());
+    // Every lipid type in each leaflet so columns don't change if lipids flip
+    for(const string &type : resTypes_) fprintf(aplFile_, "%12s", type.c_str());
+    for(const string &type : resTypes_) fprintf(aplFile_, "%12s", type.c_str());
     fprintf(aplFile_, "\n");
 }
 
+void Membrane::printLeafletAPL(const vector<int> &lipid_frames, const vector<int> &res_ppl,
+                               const vector<double> &res_area) const{
+    for(int t=0; t<resTypes_.size(); t++){
+        const double area = voronoi_ ? res_area[t] : res_ppl[t] * step_[0] * step_[1];
+        const double APL = lipid_frames[t] > 0 ? area / lipid_frames[t] : 0.;
+        fprintf(aplFile_, "%12.3f", APL);
+    }
+}
+
 void Membrane::printCSVAreaPerLipid(const float time) const{
     fprintf(aplFile_, "%12.3f", time);
-    for(const auto &ppl : upperResPPL_){
-        const int num = ppl.second;
-        const double area = num * step_[0] * step_[1];
-        const double APL = area / (numFrames_ * upperNumRes_.at(ppl.first));
-        fprintf(aplFile_, "%12.3f", APL);
+    printLeafletAPL(upperLipidFrames_, upperResPPL_, upperResArea_);
+    printLeafletAPL(lowerLipidFrames_, lowerResPPL_, lowerResArea_);
+    fprintf(aplFile_, "\n");
+}
+
+void Membrane::printCSVProtein(const std::string &filename) const{
+    if(!protein_ || proteinRadius_ <= 0.) return;
+
+    LightArray<double> occupancy(protOccupancy_);
+    if(numFrames_ > 0) occupancy /= static_cast<double>(numFrames_);
+
+    if(header_){
+        const string file = filename + ".dat";
+        // Backup using small_functions.h
+        backup_old_file(file);
+        FILE *f = fopen(file.c_str(), "w");
+        if(f == nullptr) throw std::runtime_error("Could not open output file.");
+
+        fprintf(f, "@legend Protein occupancy\n");
+        fprintf(f, "@xlabel X (nm)\n");
+        fprintf(f, "@ylabel Y (nm)\n");
+        fprintf(f, "@xwidth %f\n", box_[0]);
+        fprintf(f, "@ywidth %f\n", box_[1]);
+        fclose(f);
+
+        // Print CSV - true suppresses backup - file has been opened already
+        occupancy.printCSV(filename, true);
+    }else{
+        occupancy.printCSV(filename);
     }
-    for(const auto &ppl : lowerResPPL_){
-        const int num = ppl.second;
-        const double area = num * step_[0] * step_[1];
-        const double APL = area / (numFrames_ * lowerNumRes_.at(ppl.first));
-        fprintf(aplFile_, "%12.3f", APL);
+}
+
+void Membrane::printCSVVoronoi(const std::string &filename) const{
+    const string file = filename + ".dat";
+    // Backup using small_functions.h
+    backup_old_file(file);
+    FILE *f = fopen(file.c_str(), "w");
+    if(f == nullptr) throw std::runtime_error("Could not open output file.");
+
+    if(header_){
+        fprintf(f, "@legend Voronoi area per lipid\n");
+        fprintf(f, "@columns atom resname leaflet area (nm^2) neighbour atoms\n");
     }
-    fprintf(aplFile_, "\n");
+
+    const vector<int> *heads[2] = {&upperHeads_, &lowerHeads_};
+    const vector<int> *head_type[2] = {&upperHeadType_, &lowerHeadType_};
+    const Voronoi *voronoi[2] = {&upperVoronoi_, &lowerVoronoi_};
+    const char *leaflet[2] = {"upper", "lower"};
+    for(int l=0; l<2; l++){
+        // Not yet calculated
+        if(voronoi[l]->areas().size() != heads[l]->size()) continue;
+        for(int k=0; k<heads[l]->size(); k++){
+            // Atom numbers count from one as in GRO files
+            fprintf(f, "%8d%8s%8s%10.4f", (*heads[l])[k] + 1,
+                    resTypes_[(*head_type[l])[k]].c_str(), leaflet[l], voronoi[l]->areas()[k]);
+            for(const int n : voronoi[l]->neighbours()[k]) fprintf(f, "%8d", (*heads[l])[n] + 1);
+            fprintf(f, "\n");
+        }
+    }
+
+    fclose(f);
 }
 
 void Membrane::prepCSVAvgThickness(){
     const string file = "avg_thickness.dat";
-    // Backup using small_functions.h
-    backup_old_file(file);
-    avgFile_ = fopen(file.c_str(), "w");
+    // Appended to if resuming from a checkpoint
+    avgFile_ = open_stream_file(file);
     if(!avgFile_) throw std::runtime_error("Could not open output file");
 
     if(header_){
-        fprintf(aplFile_, "@legend Average Thickness\n");
-        fprintf(aplFile_, "@xlabel Time (ps)\n");
-        fprintf(aplFile_, "@ylabel Thickness (nm)\n");
+        fprintf(avgFile_, "@legend Average Thickness\n");
+        fprintf(avgFile_, "@xlabel Time (ps)\n");
+        fprintf(avgFile_, "@ylabel Thickness (nm)\n");
+    }
+}
+
+void Membrane::prepCSVFlipFlop(){
+    const string file = "flipflop.dat";
+    // Appended to if resuming from a checkpoint
+    flipFile_ = open_stream_file(file);
+    if(!flipFile_) throw std::runtime_error("Could not open output file");
+
+    if(header_){
+        fprintf(flipFile_, "@legend Lipid flip-flop events\n");
+        fprintf(flipFile_, "@columns time (ps) atom resname from to\n");
     }
 }
 
@@ -379,6 +670,7 @@ double Membrane::mean() const{
 void Membrane::normalize(const int smooth_iter){
     // Apply iterations of Gauss-Seidel smoother
     thickness_.smooth(smooth_iter);
+    if(smoothSigma_ > 0.) thickness_.gaussianFilter(2. * smoothSigma_ / (step_[0] + step_[1]));
     thickness_ /= 2 * numFrames_;
 }
 
@@ -403,6 +695,12 @@ void Membrane::printCSV(const std::string &filename) const{
     }
 }
 
+int Membrane::leaflet(const int head) const{
+    const auto it = headLipid_.find(head);
+    if(it == headLipid_.end()) return 0;
+    return lipidUpper_[it->second] ? 1 : -1;
+}
+
 void Membrane::setResolution(const int n){
     grid_ = n;
     thickness_.alloc(grid_, grid_);
@@ -411,11 +709,18 @@ void Membrane::setResolution(const int n){
     closestLower_.alloc(n, n);
     curvMean_.alloc(grid_, grid_);
     curvGaussian_.alloc(grid_, grid_);
+    protMask_.assign((grid_ * grid_ + 63) / 64, 0);
+    protOccupancy_.alloc(grid_, grid_);
 }
 
 void Membrane::reset(){
     thickness_.zero();
-    for(auto &ppl : upperResPPL_) ppl.second = 0;
-    for(auto &ppl : lowerResPPL_) ppl.second = 0;
+    protOccupancy_.zero();
+    std::fill(upperResPPL_.begin(), upperResPPL_.end(), 0);
+    std::fill(lowerResPPL_.begin(), lowerResPPL_.end(), 0);
+    std::fill(upperResArea_.begin(), upperResArea_.end(), 0.);
+    std::fill(lowerResArea_.begin(), lowerResArea_.end(), 0.);
+    std::fill(upperLipidFrames_.begin(), upperLipidFrames_.end(), 0);
+    std::fill(lowerLipidFrames_.begin(), lowerLipidFrames_.end(), 0);
     numFrames_ = 0;
 }
@@ -0,0 +1,263 @@
+#include "order_parameter.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+
+#include "membrane.h"
+#include "small_functions.h"
+
+using std::string;
+using std::vector;
+using std::array;
+
+OrderParameter::OrderParameter(const vector<Residue> &residues, const int resolution) :
+        residues_(residues), grid_(resolution){
+    for(int l=0; l<2; l++){
+        mapSum_[l].alloc(grid_, grid_);
+        mapCount_[l].alloc(grid_, grid_);
+    }
+}
+
+void OrderParameter::addChain(const string &resname, const vector<string> &names){
+    if(names.size() < 2) throw std::invalid_argument("Order parameter chain needs at least two atoms");
+
+    Chain chain;
+    chain.resname = resname;
+    chain.names = names;
+
+    // A residue type may appear in more than one block of the system
+    for(const Residue &res : residues_){
+        if(res.resname != resname) continue;
+
+        vector<int> offsets;
+        for(const string &name : names){
+            const auto it = res.name_to_num.find(name);
+            if(it == res.name_to_num.end())
+                throw std::invalid_argument("Residue " + resname + " has no atom " + name);
+            offsets.push_back(it->second);
+        }
+        for(int r=0; r<res.num_residues; r++){
+            const int base = res.start + r * res.num_atoms;
+            for(const int offset : offsets) chain.atoms.push_back(base + offset);
+            chain.heads.push_back(base + (res.ref_atom >= 0 ? res.ref_atom : offsets.front()));
+        }
+    }
+    if(chain.heads.empty())
+        throw std::invalid_argument("Residue " + resname + " in order parameter chain does not exist");
+
+    for(int l=0; l<2; l++){
+        chain.scc[l].assign(names.size() - 1, 0.);
+        chain.scd[l].assign(names.size() - 2, 0.);
+    }
+    chains_.push_back(chain);
+}
+
+void OrderParameter::calculate(const Frame &frame, const Membrane *membrane){
+    for(int d=0; d<3; d++) box_[d] = frame.box_[d][d];
+
+    for(Chain &chain : chains_){
+        const int num_res = static_cast<int>(chain.heads.size());
+        const int num_bonds = static_cast<int>(chain.names.size()) - 1;
+        const int num_inner = num_bonds - 1;
+
+        // Gather minimum image bond vectors of every residue into contiguous arrays
+        vector<double> bx(num_res * num_bonds), by(num_res * num_bonds), bz(num_res * num_bonds);
+        vector<int> leaflet(num_res);
+        #pragma omp parallel for default(shared) schedule(static)
+        for(int r=0; r<num_res; r++){
+            const int *atoms = &chain.atoms[r * (num_bonds + 1)];
+            for(int b=0; b<num_bonds; b++){
+                const array<double, 3> &a = frame.atoms_[atoms[b]].coords;
+                const array<double, 3> &c = frame.atoms_[atoms[b+1]].coords;
+                double delta[3];
+                for(int d=0; d<3; d++){
+                    delta[d] = c[d] - a[d];
+                    if(box_[d] > 0.) delta[d] -= box_[d] * std::round(delta[d] / box_[d]);
+                }
+                const int k = r * num_bonds + b;
+                bx[k] = delta[0];
+                by[k] = delta[1];
+                bz[k] = delta[2];
+            }
+
+            // Leaflet from the membrane if it knows this lipid, otherwise from head-tail orientation
+            int side = membrane ? membrane->leaflet(chain.heads[r]) : 0;
+            if(side == 0){
+                double tail_z = 0.;
+                for(int b=0; b<num_bonds; b++) tail_z += bz[r * num_bonds + b];
+                side = tail_z < 0. ? 1 : -1;
+            }
+            leaflet[r] = side > 0 ? 0 : 1;
+        }
+
+        // S_CC only needs the z component of each normalised bond
+        vector<double> scc(num_res * num_bonds);
+        #pragma omp simd
+        for(int k=0; k<num_res*num_bonds; k++){
+            const double len2 = bx[k] * bx[k] + by[k] * by[k] + bz[k] * bz[k];
+            scc[k] = 1.5 * bz[k] * bz[k] / len2 - 0.5;
+        }
+
+        // S_CD from molecular axes at each interior atom - z along C(i-1) to C(i+1),
+        // x along the C-C-C bisector and y normal to the C-C-C plane
+        vector<double> scd(chain.heads.size() * chain.scd[0].size());
+        #pragma omp simd
+        for(int k=0; k<num_res*num_inner; k++){
+            const int b = (k / num_inner) * num_bonds + k % num_inner;
+            double zx = bx[b] + bx[b+1], zy = by[b] + by[b+1], zz = bz[b] + bz[b+1];
+            double xx = bx[b+1] - bx[b], xy = by[b+1] - by[b], xz = bz[b+1] - bz[b];
+            const double inv_z = 1. / std::sqrt(zx * zx + zy * zy + zz * zz);
+            zx *= inv_z;
+            zy *= inv_z;
+            zz *= inv_z;
+            const double proj = xx * zx + xy * zy + xz * zz;
+            xx -= proj * zx;
+            xy -= proj * zy;
+            xz -= proj * zz;
+            const double inv_x = 1. / std::sqrt(xx * xx + xy * xy + xz * xz);
+            xx *= inv_x;
+            xy *= inv_x;
+            xz *= inv_x;
+            const double yz = zx * xy - zy * xx;
+            const double s_xx = 1.5 * xz * xz - 0.5;
+            const double s_yy = 1.5 * yz * yz - 0.5;
+            scd[k] = (s_xx + 2. * s_yy) / 3.;
+        }
+
+        // Accumulate by leaflet - maps hold mean S_CC of each lipid at its head group
+        for(int r=0; r<num_res; r++){
+            const int l = leaflet[r];
+            double lipid_mean = 0.;
+            for(int b=0; b<num_bonds; b++){
+                chain.scc[l][b] += scc[r * num_bonds + b];
+                lipid_mean += scc[r * num_bonds + b];
+            }
+            for(int a=0; a<num_inner; a++) chain.scd[l][a] += scd[r * num_inner + a];
+            chain.samples[l]++;
+
+            int cell[2];
+            for(int d=0; d<2; d++){
+                const double x = frame.atoms_[chain.heads[r]].coords[d];
+                const double wrapped = x - box_[d] * std::floor(x / box_[d]);
+                cell[d] = std::min(static_cast<int>(wrapped / box_[d] * grid_), grid_ - 1);
+            }
+            mapSum_[l](cell[0], cell[1]) += lipid_mean / num_bonds;
+            mapCount_[l](cell[0], cell[1]) += 1.;
+        }
+    }
+    frames_++;
+}
+
+double OrderParameter::scc(const int chain, const int bond, const int leaflet) const{
+    const Chain &c = chains_.at(chain);
+    if(leaflet >= 0) return c.samples[leaflet] > 0 ? c.scc[leaflet].at(bond) / c.samples[leaflet] : 0.;
+    const int samples = c.samples[0] + c.samples[1];
+    return samples > 0 ? (c.scc[0].at(bond) + c.scc[1].at(bond)) / samples : 0.;
+}
+
+double OrderParameter::scd(const int chain, const int atom, const int leaflet) const{
+    const Chain &c = chains_.at(chain);
+    if(leaflet >= 0) return c.samples[leaflet] > 0 ? c.scd[leaflet].at(atom - 1) / c.samples[leaflet] : 0.;
+    const int samples = c.samples[0] + c.samples[1];
+    return samples > 0 ? (c.scd[0].at(atom - 1) + c.scd[1].at(atom - 1)) / samples : 0.;
+}
+
+void OrderParameter::print(const string &filename, const bool header) const{
+    const string file = filename + ".dat";
+    // Backup using small_functions.h
+    backup_old_file(file);
+    FILE *f = fopen(file.c_str(), "w");
+    if(f == nullptr) throw std::runtime_error("Could not open output file.");
+
+    if(header){
+        fprintf(f, "@legend Lipid tail order parameters\n");
+        fprintf(f, "@columns residue  atom  S_CC upper  S_CC lower  S_CC  S_CD upper  S_CD lower  S_CD\n");
+        fprintf(f, "@comment S_CC is of the bond to the next atom, S_CD of interior atoms only\n");
+    }
+
+    for(int c=0; c<chains_.size(); c++){
+        const Chain &chain = chains_[c];
+        const int num_atoms = static_cast<int>(chain.names.size());
+        for(int a=0; a<num_atoms; a++){
+            fprintf(f, "%6s%6s", chain.resname.c_str(), chain.names[a].c_str());
+            if(a < num_atoms - 1){
+                fprintf(f, "%10.4f%10.4f%10.4f", scc(c, a, 0), scc(c, a, 1), scc(c, a));
+            }else{
+                fprintf(f, "%10s%10s%10s", "nan", "nan", "nan");
+            }
+            if(a > 0 && a < num_atoms - 1){
+                fprintf(f, "%10.4f%10.4f%10.4f\n", scd(c, a, 0), scd(c, a, 1), scd(c, a));
+            }else{
+                fprintf(f, "%10s%10s%10s\n", "nan", "nan", "nan");
+            }
+        }
+    }
+    fclose(f);
+}
+
+void OrderParameter::printCSVMaps(const string &filename, const bool header) const{
+    const char *names[2] = {"_upper", "_lower"};
+    for(int l=0; l<2; l++){
+        LightArray<double> mean(grid_, grid_);
+        for(int i=0; i<grid_; i++){
+            for(int j=0; j<grid_; j++){
+                if(mapCount_[l].at(i, j) > 0.) mean(i, j) = mapSum_[l].at(i, j) / mapCount_[l].at(i, j);
+            }
+        }
+
+        const string name = filename + names[l];
+        if(header){
+            const string file = name + ".dat";
+            // Backup using small_functions.h
+            backup_old_file(file);
+            FILE *f = fopen(file.c_str(), "w");
+            if(f == nullptr) throw std::runtime_error("Could not open output file.");
+            fprintf(f, "@legend Mean S_CC of lipids in %s leaflet\n", l == 0 ? "upper" : "lower");
+            fprintf(f, "@xlabel X (nm)\n");
+            fprintf(f, "@ylabel Y (nm)\n");
+            fprintf(f, "@xwidth %f\n", box_[0]);
+            fprintf(f, "@ywidth %f\n", box_[1]);
+            fclose(f);
+
+            // Print CSV - true suppresses backup - file has been opened already
+            mean.printCSV(name, true);
+        }else{
+            mean.printCSV(name);
+        }
+    }
+}
+
+void OrderParameter::checkpoint(Checkpoint &cp){
+    cp.sync(frames_);
+    cp.sync(box_);
+    int num_chains = static_cast<int>(chains_.size());
+    cp.sync(num_chains);
+    if(num_chains != chains_.size())
+        throw std::runtime_error("Order parameter checkpoint does not match the requested chains");
+    for(Chain &chain : chains_){
+        cp.section(chain.resname);
+        cp.sync(chain.scc);
+        cp.sync(chain.scd);
+        cp.sync(chain.samples);
+    }
+    for(int l=0; l<2; l++){
+        mapSum_[l].checkpoint(cp);
+        mapCount_[l].checkpoint(cp);
+    }
+}
+
+void OrderParameter::reset(){
+    for(Chain &chain : chains_){
+        for(int l=0; l<2; l++){
+            std::fill(chain.scc[l].begin(), chain.scc[l].end(), 0.);
+            std::fill(chain.scd[l].begin(), chain.scd[l].end(), 0.);
+            chain.samples[l] = 0;
+        }
+    }
+    for(int l=0; l<2; l++){
+        mapSum_[l].zero();
+        mapCount_[l].zero();
+    }
+    frames_ = 0;
+}
@@ -1,103 +1,293 @@
 #include "parser.h"
 
-#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+#include <sys/stat.h>
 
 #include <boost/algorithm/string.hpp>
 
+#include "small_functions.h"
+
 using std::string;
 using std::vector;
-using std::cout;
-using std::endl;
+using boost::string_ref;
+
+static bool is_blank(const char c){
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+/** \brief Remove whitespace from both ends of a string_ref */
+static string_ref trim(string_ref str){
+    while(!str.empty() && is_blank(str.front())) str.remove_prefix(1);
+    while(!str.empty() && is_blank(str.back())) str.remove_suffix(1);
+    return str;
+}
+
+namespace{
+    /** \brief Modification time of a file - the field has a different name on OSX */
+    struct timespec modified_time(const struct stat &info){
+#ifdef __MACH__
+        return info.st_mtimespec;
+#else
+        return info.st_mtim;
+#endif
+    }
+
+    /** \brief Cached file and the modification time it was read at */
+    struct CacheEntry{
+        struct timespec mtime;
+        off_t size;
+        std::shared_ptr<const Parser::SourceFile> file;
+    };
+
+    std::map<string, CacheEntry> include_cache;
+    std::mutex include_cache_mutex;
+
+    /** Includes deeper than this are assumed to be circular */
+    const int max_include_depth = 32;
+
+    string directory_of(const string &filename){
+        const size_t slash = filename.rfind('/');
+        return slash == string::npos ? "" : filename.substr(0, slash + 1);
+    }
+
+    /** \brief Find an included file - relative to the including file, then working directory, then $GMXLIB */
+    string find_include(const string &name, const string &including){
+        if(!name.empty() && name[0] == '/') return file_exists(name) ? name : "";
+
+        vector<string> dirs = {directory_of(including), ""};
+        const char *gmxlib = std::getenv("GMXLIB");
+        if(gmxlib != nullptr){
+            vector<string> lib_dirs;
+            boost::split(lib_dirs, gmxlib, boost::is_any_of(":"), boost::algorithm::token_compress_on);
+            for(const string &dir : lib_dirs) if(!dir.empty()) dirs.push_back(dir + "/");
+        }
+
+        for(const string &dir : dirs){
+            if(file_exists(dir + name)) return dir + name;
+        }
+        return "";
+    }
+}
 
 Parser::Parser(const string filename, const FileFormat format) {
-    //TODO preprocess file to include ITPs
     format_ = format;
     filename_ = filename;
-    file_.open(filename);
-    if (!file_.is_open()) throw std::runtime_error("File " + filename + " could not be opened");
+    string section = "";
+    index(filename, section, 0);
 }
 
-Parser::~Parser(){
-    if(file_.is_open()) file_.close();
+std::shared_ptr<const Parser::SourceFile> Parser::load(const string &filename){
+    struct stat info;
+    char *resolved = realpath(filename.c_str(), nullptr);
+    if(resolved == nullptr || stat(resolved, &info) != 0){
+        free(resolved);
+        throw std::runtime_error("File " + filename + " could not be opened");
+    }
+    const string path(resolved);
+    free(resolved);
+
+    std::lock_guard<std::mutex> lock(include_cache_mutex);
+    const struct timespec mtime = modified_time(info);
+    const auto it = include_cache.find(path);
+    if(it != include_cache.end() && it->second.size == info.st_size &&
+       it->second.mtime.tv_sec == mtime.tv_sec && it->second.mtime.tv_nsec == mtime.tv_nsec){
+        return it->second.file;
+    }
+
+    std::ifstream stream(path);
+    if (!stream.is_open()) throw std::runtime_error("File " + filename + " could not be opened");
+    std::shared_ptr<SourceFile> file = std::make_shared<SourceFile>();
+    std::ostringstream buffer;
+    buffer << stream.rdbuf();
+    file->contents = buffer.str();
+
+    // Split lines once here - directives depend on defines so are followed in index()
+    const string_ref contents(file->contents);
+    size_t start = 0;
+    while(start < contents.size()){
+        size_t end = file->contents.find('\n', start);
+        if(end == string::npos) end = contents.size();
+        const string_ref line = trim(contents.substr(start, end - start));
+        start = end + 1;
+
+        // Skip empty lines and comments
+        if(line.empty() || line[0] == ';') continue;
+        file->lines.push_back(line);
+    }
+
+    include_cache[path] = CacheEntry{mtime, info.st_size, file};
+    return file;
+}
+
+int Parser::cacheSize(){
+    std::lock_guard<std::mutex> lock(include_cache_mutex);
+    return static_cast<int>(include_cache.size());
 }
 
-bool Parser::getLine(vector <string> &tokens){
-    while(true){
-        eof_ = !getline(file_, line_);
+void Parser::clearCache(){
+    std::lock_guard<std::mutex> lock(include_cache_mutex);
+    include_cache.clear();
+}
+
+/** \brief Split a line on whitespace */
+static void split(const string_ref line, vector<string_ref> &tokens){
+    tokens.clear();
+    size_t pos = 0;
+    while(pos < line.size()){
+        while(pos < line.size() && is_blank(line[pos])) pos++;
+        const size_t tok_start = pos;
+        while(pos < line.size() && !is_blank(line[pos])) pos++;
+        if(pos > tok_start) tokens.push_back(line.substr(tok_start, pos - tok_start));
+    }
+}
 
-        // Stop if we hit eof
-        if(eof_) return false;
-        boost::trim(line_);
+void Parser::index(const string &filename, string &section, const int depth){
+    if(depth > max_include_depth)
+        throw std::runtime_error("Includes nested too deeply in " + filename + " - is there a circular #include?");
 
-        // Skip comments
-        if(line_[0] == ';' || line_[0] == '#') continue;
+    const std::shared_ptr<const SourceFile> file = load(filename);
+    files_.push_back(file);
 
-        // Line is empty, ignore it
-        if(line_ == "") continue;
+    // Is each enclosing #ifdef/#ifndef/#else branch being read?
+    vector<bool> conditions;
+    bool active = true;
+    vector<string_ref> tokens;
+
+    for(string_ref line : file->lines){
+        if(line[0] == '#'){
+            // Only GROMACS files are preprocessed
+            if(format_ != FileFormat::GROMACS) continue;
+            split(line.substr(1), tokens);
+            if(tokens.empty()) continue;
+            const string_ref directive = tokens[0];
+
+            if(directive == "ifdef" || directive == "ifndef"){
+                if(tokens.size() < 2) throw std::runtime_error("Missing name after #" + directive.to_string() + " in " + filename);
+                const bool defined = defines_.count(tokens[1].to_string()) > 0;
+                conditions.push_back(directive == "ifdef" ? defined : !defined);
+            }else if(directive == "else"){
+                if(conditions.empty()) throw std::runtime_error("#else without #ifdef in " + filename);
+                conditions.back() = !conditions.back();
+            }else if(directive == "endif"){
+                if(conditions.empty()) throw std::runtime_error("#endif without #ifdef in " + filename);
+                conditions.pop_back();
+            }else if(active && directive == "define"){
+                if(tokens.size() < 2) throw std::runtime_error("Missing name after #define in " + filename);
+                defines_[tokens[1].to_string()].assign(tokens.begin() + 2, tokens.end());
+            }else if(active && directive == "undef"){
+                if(tokens.size() >= 2) defines_.erase(tokens[1].to_string());
+            }else if(active && directive == "include"){
+                if(tokens.size() < 2) throw std::runtime_error("Missing file after #include in " + filename);
+                string name = tokens[1].to_string();
+                boost::trim_if(name, boost::is_any_of("\"<>"));
+                const string path = find_include(name, filename);
+                // Topologies often include force fields which are not needed - carry on without them
+                if(path.empty()){
+                    printf("WARNING: Included file %s not found from %s - skipping\n", name.c_str(), filename.c_str());
+                }else{
+                    index(path, section, depth + 1);
+                }
+            }
+
+            active = std::find(conditions.begin(), conditions.end(), false) == conditions.end();
+            continue;
+        }
+        if(!active) continue;
 
         switch(format_){
             case FileFormat::GROMACS:
                 // Line is a section header
-                if(line_[0] == '['){
-                    section_ = line_.substr(line_.find_first_of('[')+1, line_.find_last_of(']')-1);
-                    boost::trim(section_);
+                if(line[0] == '['){
+                    const size_t close = line.rfind(']');
+                    const string_ref name = line.substr(1, close == string_ref::npos ? string_ref::npos : close - 1);
+                    section = trim(name).to_string();
                     continue;
                 }
                 break;
 
             case FileFormat::LAMMPS:
                 throw std::logic_error("Not implemented");
-            };
+        }
+
+        // Remove trailing comment then separate on whitespace
+        const size_t comment = line.find(';');
+        if(comment != string_ref::npos) line = trim(line.substr(0, comment));
+        split(line, tokens);
 
-        // Line isn't empty, accept it
-        break;
+        Line data = {static_cast<int>(tokens_.size()), 0};
+        for(const string_ref token : tokens){
+            // Substitute defined names - replacements refer into the file containing the #define
+            const auto def = defines_.empty() ? defines_.end() : defines_.find(token.to_string());
+            if(def == defines_.end()){
+                tokens_.push_back(token);
+                data.size++;
+            }else{
+                tokens_.insert(tokens_.end(), def->second.begin(), def->second.end());
+                data.size += def->second.size();
+            }
+        }
+        sections_[section].push_back(data);
     }
 
-    // Separate and trim whitespace from tokens
-    vector<string> tmp;
-    boost::split(tmp, line_, boost::is_any_of(";"), boost::algorithm::token_compress_on);
-    boost::trim(tmp[0]);
-    boost::split(tokens, tmp[0], boost::is_any_of("\t "), boost::algorithm::token_compress_on);
-    for(string &tok : tokens) boost::trim(tok);
+    if(!conditions.empty()) throw std::runtime_error("Unterminated #ifdef in " + filename);
+}
 
-    // Return true if there is still file to read
-    return true;
+const Parser::Line *Parser::nextLine(const string &find, const int len){
+    // Are we looking for a new section? - it might be above the last one
+    if(find != findPrevious_) rewind();
+    findPrevious_ = find;
+
+    const auto it = sections_.find(find);
+    if(it != sections_.end()){
+        const vector<Line> &lines = it->second;
+        while(cursor_ < lines.size()){
+            const Line &line = lines[cursor_++];
+            if(line.size >= len) return &line;
+        }
+    }
+    rewind();
+    return nullptr;
 }
 
 bool Parser::findSection(const string find){
     rewind();
-    vector<string> token_buffer;
-    while(section_ != find){
-        if(!getLine(token_buffer)) return false;
-    }
-    rewind();
-    return true;
+    const auto it = sections_.find(find);
+    return it != sections_.end() && !it->second.empty();
 }
 
 bool Parser::getLineFromSection(const string find, vector<string> &tokens, const int len){
-    // Are we looking for a new section? - it might be above the last one
-    if(find != findPrevious_) rewind();
-    findPrevious_ = find;
-    while(getLine(tokens)){
-        if(section_ == find && tokens.size() >= len) return true;
-    }
-    rewind();
-    return false;
+    const Line *line = nextLine(find, len);
+    if(!line) return false;
+    tokens.resize(line->size);
+    for(int i=0; i<line->size; i++) tokens[i] = tokens_[line->first + i].to_string();
+    return true;
+}
+
+bool Parser::getLineFromSection(const string find, vector<string_ref> &tokens, const int len){
+    const Line *line = nextLine(find, len);
+    if(!line) return false;
+    tokens.assign(tokens_.begin() + line->first, tokens_.begin() + line->first + line->size);
+    return true;
 }
 
 void Parser::rewind(){
-    // Clear eof and rewind
-    eof_ = false;
-    file_.clear();
-    file_.seekg(0, std::ios::beg);
+    cursor_ = 0;
 }
 
 bool Parser::getKeyFromSection(const string &section, const string &key,
                                string &value){
-    vector<string> tmp;
-    while(getLineFromSection(section, tmp, 2)){
-        if(tmp[0] == key){
-            value = tmp[1];
+    const auto it = sections_.find(section);
+    if(it == sections_.end()) return false;
+    for(const Line &line : it->second){
+        if(line.size >= 2 && tokens_[line.first] == key){
+            value = tokens_[line.first + 1].to_string();
             return true;
         }
     }
@@ -106,7 +296,6 @@ bool Parser::getKeyFromSection(const string &section, const string &key,
 
 int Parser::getIntKeyFromSection(const string &section, const string &key,
                                  const int default_value){
-    rewind();
     string tmp;
     if(getKeyFromSection(section, key, tmp)) return stoi(tmp);
     return default_value;
@@ -114,7 +303,6 @@ int Parser::getIntKeyFromSection(const string &section, const string &key,
 
 double Parser::getDoubleKeyFromSection(const string &section, const string &key,
                                        const double default_value){
-    rewind();
     string tmp;
     if(getKeyFromSection(section, key, tmp)) return stof(tmp);
     return default_value;
@@ -122,7 +310,6 @@ double Parser::getDoubleKeyFromSection(const string &section, const string &key,
 
 string Parser::getStringKeyFromSection(const string &section, const string &key,
                                        const string &default_value){
-    rewind();
     string tmp;
     if(getKeyFromSection(section, key, tmp)){
         boost::to_upper(tmp);
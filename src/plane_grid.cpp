@@ -0,0 +1,124 @@
+#include "plane_grid.h"
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#include "small_functions.h"
+
+using std::vector;
+using std::array;
+
+int PlaneGrid::cellCoord(const double x, const int d) const{
+    const double wrapped = x - box_[d] * std::floor(x / box_[d]);
+    return std::min(static_cast<int>(wrapped / cellWidth_[d]), numCells_[d] - 1);
+}
+
+void PlaneGrid::build(const vector<array<double, 3>> &coords, const array<double, 3> &box,
+                      const double per_cell){
+    if(!(box[0] > 0. && box[1] > 0.)) throw std::invalid_argument("PlaneGrid box must be positive");
+    box_ = box;
+
+    const int num = static_cast<int>(coords.size());
+    // Square buckets of the area which holds per_cell points on average
+    const double side = num > 0 ? std::sqrt(per_cell * box[0] * box[1] / num) : box[0];
+    for(int d=0; d<2; d++){
+        numCells_[d] = std::max(1, static_cast<int>(box[d] / side));
+        cellWidth_[d] = box[d] / numCells_[d];
+        // Centred range of offsets - its extremes are the furthest buckets by periodic distance
+        offsetLo_[d] = -(numCells_[d] - 1) / 2;
+        offsetHi_[d] = offsetLo_[d] + numCells_[d] - 1;
+    }
+
+    const int num_cells = numCells_[0] * numCells_[1];
+    cellStart_.assign(num_cells + 1, 0);
+    vector<int> cell(num);
+    for(int i=0; i<num; i++){
+        cell[i] = cellCoord(coords[i][0], 0) * numCells_[1] + cellCoord(coords[i][1], 1);
+        cellStart_[cell[i] + 1]++;
+    }
+    for(int c=0; c<num_cells; c++) cellStart_[c+1] += cellStart_[c];
+
+    // Counting sort is stable so points within a bucket remain in index order
+    vector<int> next(cellStart_.begin(), cellStart_.end() - 1);
+    sortedIndex_.resize(num);
+    sortedCoords_.resize(num);
+    for(int i=0; i<num; i++){
+        const int pos = next[cell[i]]++;
+        sortedIndex_[pos] = i;
+        sortedCoords_[pos] = coords[i];
+    }
+}
+
+int PlaneGrid::nearest(const array<double, 3> &point, const double max_dist2, double &dist2) const{
+    const int cx = cellCoord(point[0], 0);
+    const int cy = cellCoord(point[1], 1);
+    const double min_width = std::min(cellWidth_[0], cellWidth_[1]);
+    const int max_ring = std::max(std::max(-offsetLo_[0], offsetHi_[0]),
+                                  std::max(-offsetLo_[1], offsetHi_[1]));
+
+    int best = -1;
+    double best_dist2 = max_dist2;
+
+    auto search_cell = [&](const int dx, const int dy){
+        const int x = (cx + dx + numCells_[0]) % numCells_[0];
+        const int y = (cy + dy + numCells_[1]) % numCells_[1];
+        const int c = x * numCells_[1] + y;
+        for(int i=cellStart_[c]; i<cellStart_[c+1]; i++){
+            const double d2 = distSqrPlane(point, sortedCoords_[i], box_);
+            if(d2 < best_dist2 || (d2 == best_dist2 && best >= 0 && sortedIndex_[i] < best)){
+                best = sortedIndex_[i];
+                best_dist2 = d2;
+            }
+        }
+    };
+
+    for(int ring=0; ring<=max_ring; ring++){
+        const int x_lo = std::max(-ring, offsetLo_[0]), x_hi = std::min(ring, offsetHi_[0]);
+        const int y_lo = std::max(-ring, offsetLo_[1]), y_hi = std::min(ring, offsetHi_[1]);
+
+        // Search only the buckets on the edge of this ring
+        for(int dx=x_lo; dx<=x_hi; dx++){
+            if(dx == -ring || dx == ring){
+                for(int dy=y_lo; dy<=y_hi; dy++) search_cell(dx, dy);
+            }else{
+                if(-ring >= y_lo) search_cell(dx, -ring);
+                if(ring <= y_hi) search_cell(dx, ring);
+            }
+        }
+
+        // Unsearched buckets are at least ring bucket widths away along x or y
+        // Strict comparison so an equally close point with lower index is not missed
+        const double bound = ring * min_width;
+        if(best_dist2 < bound * bound * (1. - 1e-9)) break;
+    }
+
+    if(best >= 0) dist2 = best_dist2;
+    return best;
+}
+
+void PlaneGrid::within(const array<double, 3> &point, const double max_dist2, vector<int> &found) const{
+    found.clear();
+    const int cx = cellCoord(point[0], 0);
+    const int cy = cellCoord(point[1], 1);
+    const double radius = std::sqrt(max_dist2);
+
+    // Buckets up to radius away plus one since the point may be anywhere in its own bucket
+    array<int, 2> lo, hi;
+    for(int d=0; d<2; d++){
+        const int reach = static_cast<int>(radius / cellWidth_[d]) + 1;
+        lo[d] = std::max(-reach, offsetLo_[d]);
+        hi[d] = std::min(reach, offsetHi_[d]);
+    }
+
+    for(int dx=lo[0]; dx<=hi[0]; dx++){
+        const int x = (cx + dx + numCells_[0]) % numCells_[0];
+        for(int dy=lo[1]; dy<=hi[1]; dy++){
+            const int y = (cy + dy + numCells_[1]) % numCells_[1];
+            const int c = x * numCells_[1] + y;
+            for(int i=cellStart_[c]; i<cellStart_[c+1]; i++){
+                if(distSqrPlane(point, sortedCoords_[i], box_) < max_dist2) found.push_back(sortedIndex_[i]);
+            }
+        }
+    }
+}
@@ -6,88 +6,208 @@
 
 #include <cmath>
 #include <array>
+#include <stdexcept>
 
 #include "small_functions.h"
 
 using std::vector;
 using std::array;
+using std::string;
+
+RDF::RDF(const vector<Residue> &residues, const double cutoff, const int resolution) :
+        residues_(residues), cutoff_(cutoff), resolution_(resolution), cellList_(cutoff){
+    grid_ = static_cast<int>(cutoff_ * resolution_);
+}
+
+int RDF::selectionIndex(const string &name){
+    for(int i=0; i<selectionNames_.size(); i++){
+        if(selectionNames_[i] == name) return i;
+    }
+    // Selections are stored as bits in masks_
+    if(selectionNames_.size() == 64) throw std::runtime_error("Too many RDF selections - maximum is 64");
+    selectionNames_.push_back(name);
+    return static_cast<int>(selectionNames_.size()) - 1;
+}
+
+void RDF::addPair(const string &a, const string &b){
+    if(frames_ > 0) throw std::logic_error("RDF pairs must be added before the first frame");
+    customPairs_ = true;
+    pairs_.push_back({{selectionIndex(a), selectionIndex(b)}});
+}
+
+vector<int> RDF::resolveSelection(const string &name, const Frame &frame) const{
+    vector<int> atoms;
+
+    // Residue name - take the reference atom of each residue
+    for(const Residue &res : residues_){
+        if(res.resname != name) continue;
+
+        int ref = res.ref_atom;
+        if(ref < 0 && !res.ref_atom_name.empty()){
+            for(int i=0; i<res.num_atoms; i++){
+                if(frame.atoms_[res.start + i].atom_name == res.ref_atom_name) ref = i;
+            }
+        }
+        if(ref < 0){
+            printf("WARNING: No reference atom for residue %s - using first atom for RDF\n",
+                   res.resname.c_str());
+            ref = 0;
+        }
+        for(int i=0; i<res.num_residues; i++) atoms.push_back(res.start + i*res.num_atoms + ref);
+        return atoms;
+    }
+
+    // Atom or bead name, then type
+    for(int i=0; i<frame.numAtoms_; i++){
+        if(frame.atoms_[i].atom_name == name) atoms.push_back(i);
+    }
+    if(atoms.empty()){
+        for(int i=0; i<frame.numAtoms_; i++){
+            if(frame.atoms_[i].atom_type == name) atoms.push_back(i);
+        }
+    }
+
+    if(atoms.empty()) throw std::runtime_error("RDF selection " + name + " matches no atoms");
+    return atoms;
+}
+
+void RDF::setupSelections(const Frame &frame){
+    // Selections are set up again after an output refresh when following an XTC
+    if(!customPairs_ && pairs_.empty()){
+        const int sel = selectionIndex(residues_[0].resname);
+        pairs_.push_back({{sel, sel}});
+    }
+
+    // Union of selections with a bitmask recording membership
+    vector<std::uint64_t> mask(frame.numAtoms_, 0);
+    selectionSizes_.clear();
+    for(int s=0; s<selectionNames_.size(); s++){
+        const vector<int> atoms = resolveSelection(selectionNames_[s], frame);
+        selectionSizes_.push_back(static_cast<int>(atoms.size()));
+        for(const int atom : atoms) mask[atom] |= std::uint64_t(1) << s;
+    }
+
+    atoms_.clear();
+    masks_.clear();
+    for(int i=0; i<frame.numAtoms_; i++){
+        if(!mask[i]) continue;
+        atoms_.push_back(i);
+        masks_.push_back(mask[i]);
+    }
+
+    // Atoms in both selections of a pair can't be paired with themselves
+    const int num_pairs = static_cast<int>(pairs_.size());
+    pairOverlap_.assign(num_pairs, 0);
+    for(int p=0; p<num_pairs; p++){
+        const std::uint64_t both = (std::uint64_t(1) << pairs_[p][0]) | (std::uint64_t(1) << pairs_[p][1]);
+        for(const std::uint64_t m : masks_){
+            if((m & both) == both) pairOverlap_[p]++;
+        }
+    }
+
+    // Accumulators may already have been restored from a checkpoint
+    if(frames_ == 0){
+        histograms_.resize(num_pairs);
+        for(Histogram &hist : histograms_) hist.init(0., cutoff_, grid_);
+        pairDensity_.assign(num_pairs, 0.);
+        refCount_.assign(num_pairs, 0.);
+    }else if(histograms_.size() != num_pairs){
+        throw std::runtime_error("RDF checkpoint does not match the requested pairs");
+    }
+    rdfs_.resize(num_pairs);
+    for(LightArray<double> &rdf : rdfs_) rdf.alloc(grid_);
+    coordination_.resize(num_pairs);
+    for(LightArray<double> &coord : coordination_) coord.alloc(grid_);
+    selected_ = true;
+}
 
 void RDF::calculateRDF(const Frame &frame){
+    if(!selected_) setupSelections(frame);
+
     // Calculate average number density in cell
-    const double box[3] = {frame.box_[0][0], frame.box_[1][1], frame.box_[2][2]};
+    // Assumes cubic/orthorhombic box
+    const array<double, 3> box = {{frame.box_[0][0], frame.box_[1][1], frame.box_[2][2]}};
     const double volume = box[0] * box[1] * box[2];
-    density_ += residues_[0].num_residues / volume;
-
-    //TODO just put this inline?
-    const Residue &res = residues_[0];
-    #pragma omp parallel for default(none) shared(res, frame, box)
-    for(int i=0; i<res.num_residues; i++){
-        // Get number of ref atom for this residue
-        const int atom_a = res.start + i*res.num_atoms + res.ref_atom;
-
-        array<double, 3> R_a;
-        R_a[0] = frame.atoms_[atom_a].coords[0];
-        R_a[1] = frame.atoms_[atom_a].coords[1];
-        R_a[2] = frame.atoms_[atom_a].coords[2];
-
-        int pbc_axis[3];
-
-        // Assumes cubic/orthorhombic box
-        for(int ii=0; ii<3; ii++){
-            pbc_axis[ii] = 0;
-            if(R_a[ii] < cutoff_) pbc_axis[ii] = -1;
-            if(R_a[ii] > box[ii] - cutoff_) pbc_axis[ii] = 1;
-        }
+    for(int p=0; p<pairs_.size(); p++){
+        const double num_a = selectionSizes_[pairs_[p][0]];
+        const double num_b = selectionSizes_[pairs_[p][1]];
+        pairDensity_[p] += (num_a * num_b - pairOverlap_[p]) / volume;
+        refCount_[p] += num_a;
+    }
 
-        for(int j=0; j<res.num_residues; j++){
-            if(i == j) continue;
-
-            const int atom_b = res.start + j*res.num_atoms + res.ref_atom;
-            array<double, 3> R_b;
-            R_b[0] = frame.atoms_[atom_b].coords[0];
-            R_b[1] = frame.atoms_[atom_b].coords[1];
-            R_b[2] = frame.atoms_[atom_b].coords[2];
-
-            // Loop over centre and neighbouring boxes
-            for(int ii=-1; ii<=1; ii++){
-                if(pbc_axis[0] != ii && ii != 0) continue;
-                for(int jj=-1; jj<=1; jj++){
-                    if(pbc_axis[1] != jj && jj != 0) continue;
-                    for(int kk=-1; kk<=1; kk++){
-                        if(pbc_axis[2] != kk && kk != 0) continue;
-
-                        array<double, 3> R_b_adj;
-                        R_b_adj[0] = R_b[0] + ii*box[0];
-                        R_b_adj[1] = R_b[1] + jj*box[1];
-                        R_b_adj[2] = R_b[2] + kk*box[2];
-
-                        const double dist2 = distSqr(R_a, R_b_adj);
-                        if(dist2 > cutoff_*cutoff_) continue;
-                        const double dist = sqrt(dist2);
-                        const int loc = static_cast<int>(dist * resolution_);
-                        histogram_.increment(loc);
-                    }
-                }
-            }
+    coords_.resize(atoms_.size());
+    for(int i=0; i<atoms_.size(); i++) coords_[i] = frame.atoms_[atoms_[i]].coords;
+
+    // Each pair is found once - count it for each ordering which matches a requested pair
+    cellList_.build(coords_, box);
+    const int num_pairs = static_cast<int>(pairs_.size());
+    cellList_.forEachPair([this, num_pairs](const int i, const int j, const double dist2){
+        const std::uint64_t mask_i = masks_[i], mask_j = masks_[j];
+        const double dist = sqrt(dist2);
+        for(int p=0; p<num_pairs; p++){
+            const int a = pairs_[p][0], b = pairs_[p][1];
+            const int weight = static_cast<int>(((mask_i >> a) & (mask_j >> b) & 1) +
+                                                ((mask_j >> a) & (mask_i >> b) & 1));
+            if(weight) histograms_[p].add(dist, weight);
         }
-    }
+    });
 
     frames_++;
 }
 
 void RDF::normalize(){
-    // Populate rdf_ with reciprocal of expected number per shell
-    // Both histogram_ and density_ are cumulative, so number of frames cancels
+    // Populate rdfs_ with reciprocal of expected number per shell
+    // Both histograms_ and pairDensity_ are cumulative, so number of frames cancels
     const double prefactor = (4. / 3.) * M_PI;
-    const double r_scale = cutoff_ / resolution_;
-    for(int i=0; i<grid_; i++){
-        const double r_inner = i * r_scale;
-        const double r_outer = r_inner + r_scale;
-        const double v_inner = r_inner * r_inner * r_inner;
-        const double v_outer = r_outer * r_outer * r_outer;
-        rdf_(i) = histogram_.at(i) / (density_ * prefactor * (v_outer - v_inner));
+    const double r_scale = cutoff_ / grid_;
+
+    for(int p=0; p<pairs_.size(); p++){
+        Histogram &hist = histograms_[p];
+        hist.reduce();
+        for(int i=0; i<grid_; i++){
+            const double r_inner = i * r_scale;
+            const double r_outer = r_inner + r_scale;
+            const double v_inner = r_inner * r_inner * r_inner;
+            const double v_outer = r_outer * r_outer * r_outer;
+            // A selection of a single atom paired with itself has no pairs to normalise by
+            rdfs_[p](i) = pairDensity_[p] > 0. ?
+                          hist.at(i) / (pairDensity_[p] * prefactor * (v_outer - v_inner)) : 0.;
+            // Coordination number is the running total of neighbours per reference atom
+            coordination_[p](i) = hist.at(i) / refCount_[p] + (i > 0 ? coordination_[p](i-1) : 0.);
+        }
+
+        if(!customPairs_){
+            rdfs_[p].printCSV("rdf");
+            continue;
+        }
+
+        const string filename = "rdf_" + selectionNames_[pairs_[p][0]] + "_" +
+                                selectionNames_[pairs_[p][1]] + ".dat";
+        backup_old_file(filename);
+        FILE *f = fopen(filename.c_str(), "w");
+        if(!f) throw std::runtime_error("Could not open RDF file " + filename);
+        fprintf(f, "# RDF %s - %s prepared by CGTOOL\n", selectionNames_[pairs_[p][0]].c_str(),
+                selectionNames_[pairs_[p][1]].c_str());
+        fprintf(f, "# r (nm)  g(r)  coordination number\n");
+        for(int i=0; i<grid_; i++){
+            fprintf(f, "%10.4f %12.5f %12.5f\n", (i + 0.5) * r_scale,
+                    rdfs_[p].at(i), coordination_[p].at(i));
+        }
+        fclose(f);
     }
 
-    rdf_.printCSV("rdf");
     frames_ = 0;
-}
\ No newline at end of file
+    selected_ = false;
+}
+
+void RDF::checkpoint(Checkpoint &cp){
+    cp.sync(frames_);
+    cp.sync(pairDensity_);
+    cp.sync(refCount_);
+    // Histograms are allocated on the first frame so may not exist yet when loading
+    if(cp.loading()){
+        histograms_.resize(pairDensity_.size());
+        for(Histogram &hist : histograms_) hist.init(0., cutoff_, grid_);
+    }
+    for(Histogram &hist : histograms_) hist.checkpoint(cp);
+}
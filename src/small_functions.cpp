@@ -10,6 +10,7 @@
 #include <fstream>
 
 #include <cstdint>
+#include <set>
 
 #ifdef __MACH__
 #include <mach/clock.h>
@@ -57,6 +58,9 @@ double end_timer(const double start){
 }
 
 bool backup_old_file(const string name){
+    // Output written again in this run replaces our own earlier copy
+    static std::set<string> backed_up;
+    if(!backed_up.insert(name).second) return true;
     if(!file_exists(name)) return true;
 
     string newName = "#" + name + "#";
@@ -0,0 +1,158 @@
+#include "structure_factor.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+
+#include "fft.h"
+#include "small_functions.h"
+
+using std::vector;
+using std::array;
+using std::complex;
+
+StructureFactor::StructureFactor(const int grid, const int bins) :
+        grid_(grid), bins_(bins){
+    if(grid_ < 4 || bins_ < 1) throw std::invalid_argument("Invalid structure factor grid");
+}
+
+void StructureFactor::spread(const Frame &frame, const array<double, 3> &box){
+    const int n = grid_;
+    const int size = n * n * n;
+    rho_.assign(size, complex<double>(0., 0.));
+
+    #pragma omp parallel default(shared)
+    {
+        // Each thread spreads onto its own grid to avoid races
+        vector<double> local(size, 0.);
+
+        #pragma omp for schedule(static)
+        for(int i=0; i<frame.numAtoms_; i++){
+            array<array<double, 4>, 3> weights;
+            array<int, 3> first;
+            for(int d=0; d<3; d++){
+                double u = frame.atoms_[i].coords[d] / box[d];
+                u = (u - std::floor(u)) * n;
+                const int cell = static_cast<int>(u);
+                const double t = u - cell;
+                // Cubic B-spline weights at grid points cell-1 to cell+2
+                weights[d][0] = (1. - t) * (1. - t) * (1. - t) / 6.;
+                weights[d][1] = (3. * t * t * t - 6. * t * t + 4.) / 6.;
+                weights[d][2] = (-3. * t * t * t + 3. * t * t + 3. * t + 1.) / 6.;
+                weights[d][3] = t * t * t / 6.;
+                first[d] = cell - 1 + n;
+            }
+
+            for(int a=0; a<4; a++){
+                const int x = (first[0] + a) % n;
+                for(int b=0; b<4; b++){
+                    const int y = (first[1] + b) % n;
+                    const double wxy = weights[0][a] * weights[1][b];
+                    for(int c=0; c<4; c++){
+                        const int z = (first[2] + c) % n;
+                        local[(x * n + y) * n + z] += wxy * weights[2][c];
+                    }
+                }
+            }
+        }
+
+        #pragma omp critical
+        for(int i=0; i<size; i++) rho_[i] += local[i];
+    }
+}
+
+void StructureFactor::calculate(const Frame &frame){
+    const array<double, 3> box = {{frame.box_[0][0], frame.box_[1][1], frame.box_[2][2]}};
+    const int n = grid_;
+
+    // Fix q range from first frame - half of Nyquist frequency of coarsest axis
+    if(frames_ == 0){
+        double q_max = M_PI * n / box[0];
+        for(int d=1; d<3; d++) q_max = std::min(q_max, M_PI * n / box[d]);
+        q_max *= 0.5;
+        const array<HistogramAxis, 1> axes = {{HistogramAxis(0., q_max, bins_)}};
+        power_.init(axes);
+        count_.init(axes);
+    }
+    const double q_max = power_.axis(0).hi();
+
+    spread(frame, box);
+    fft3D(rho_, n, n, n);
+
+    // Spline correction |B(k)|^2 = ((2 + cos(2 pi k / n)) / 3)^2 along each axis
+    vector<double> spline(n);
+    for(int k=0; k<n; k++){
+        const double b = (2. + cos(2. * M_PI * k / n)) / 3.;
+        spline[k] = b * b;
+    }
+
+    #pragma omp parallel default(shared)
+    {
+        HistogramND<double, 1> power(power_), count(count_);
+        power.zero();
+        count.zero();
+
+        #pragma omp for schedule(static)
+        for(int x=0; x<n; x++){
+            const int kx = x <= n / 2 ? x : x - n;
+            const double qx = 2. * M_PI * kx / box[0];
+            for(int y=0; y<n; y++){
+                const int ky = y <= n / 2 ? y : y - n;
+                const double qy = 2. * M_PI * ky / box[1];
+                for(int z=0; z<n; z++){
+                    if(x == 0 && y == 0 && z == 0) continue;
+                    const int kz = z <= n / 2 ? z : z - n;
+                    const double qz = 2. * M_PI * kz / box[2];
+                    const double q = sqrt(qx * qx + qy * qy + qz * qz);
+                    if(q >= q_max) continue;
+
+                    const double corr = spline[x] * spline[y] * spline[z];
+                    const array<double, 1> loc = {{q}};
+                    power.add(loc, std::norm(rho_[(x * n + y) * n + z]) / corr);
+                    count.add(loc);
+                }
+            }
+        }
+
+        #pragma omp critical
+        {
+            power_.merge(power);
+            count_.merge(count);
+        }
+    }
+
+    numAtoms_ += frame.numAtoms_;
+    frames_++;
+}
+
+void StructureFactor::checkpoint(Checkpoint &cp){
+    cp.sync(frames_);
+    cp.sync(numAtoms_);
+    // Histograms hold the |q| range fixed by the first frame
+    power_.checkpoint(cp);
+    count_.checkpoint(cp);
+}
+
+void StructureFactor::normalize(const std::string &filename){
+    if(frames_ == 0) throw std::logic_error("No frames added to structure factor");
+
+    // Average over frames and vectors in shell of sum |rho(q)|^2 / N
+    const double atoms_per_frame = numAtoms_ / frames_;
+    sq_.assign(bins_, 0.);
+    for(int i=0; i<bins_; i++){
+        if(count_.at(i) > 0.) sq_[i] = power_.at(i) / (count_.at(i) * atoms_per_frame);
+    }
+
+    backup_old_file(filename);
+    FILE *f = fopen(filename.c_str(), "w");
+    if(!f) throw std::runtime_error("Could not open structure factor file " + filename);
+    fprintf(f, "# Structure factor prepared by CGTOOL\n");
+    fprintf(f, "# q (nm^-1)  S(q)  number of wavevectors\n");
+    for(int i=0; i<bins_; i++){
+        // Empty shells at small q have no wavevectors - skip them
+        if(count_.at(i) == 0.) continue;
+        fprintf(f, "%10.4f %12.5f %10d\n", axis().centre(i), sq_[i],
+                static_cast<int>(count_.at(i) / frames_));
+    }
+    fclose(f);
+}
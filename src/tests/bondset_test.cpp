@@ -1,13 +1,24 @@
 #include "bondset.h"
 
 #include <vector>
+#include <cmath>
 
 #include "gtest/gtest.h"
 
 #include "residue.h"
+#include "boltzmann_inverter.h"
 
 using std::vector;
 
+/** Deterministic normally distributed values - Box-Muller on a regular grid */
+static void normal_samples(vector<double> &vec, const double mean, const double sdev, const int n){
+    for(int i=0; i<n; i++){
+        const double u1 = (i / 100 + 0.5) / (n / 100);
+        const double u2 = (i % 100 + 0.5) / 100;
+        vec.push_back(mean + sdev * std::sqrt(-2. * std::log(u1)) * std::cos(2. * M_PI * u2));
+    }
+}
+
 TEST(BondSetTest, FromFile){
     vector<Residue> tmpres;
     PotentialType tmppots[3];
@@ -19,6 +30,100 @@ TEST(BondSetTest, FromFile){
     ASSERT_EQ(bondset.bonds_[5].atomNums_[1], 0);
 }
 
+TEST(BoltzmannInverterTest, TabulateHarmonic){
+    const double mean = 0.4, sdev = 0.01;
+    BondStruct bond(BondType::LENGTH);
+    normal_samples(bond.values_, mean, sdev, 20000);
+
+    BoltzmannInverter bi(300.);
+    bi.calculate(bond);
+    bi.tabulate(bond);
+    ASSERT_FALSE(bond.table_.empty());
+
+    // Minimum of the potential at the mean and harmonic curvature close to kT / var
+    const double kT = 8.314 * 300. / 1000.;
+    int min_loc = 0;
+    for(int i=0; i<bond.table_.size(); i++){
+        if(bond.table_[i][1] < bond.table_[min_loc][1]) min_loc = i;
+    }
+    ASSERT_NEAR(mean, bond.table_[min_loc][0], 0.002);
+
+    // Jacobian correction shifts the curvature slightly, allow 20%
+    const int off = 10;
+    const double dx = bond.table_[min_loc + off][0] - bond.table_[min_loc][0];
+    const double curv = (bond.table_[min_loc + off][1] + bond.table_[min_loc - off][1]
+                         - 2. * bond.table_[min_loc][1]) / (dx * dx);
+    ASSERT_NEAR(1., curv / (kT / (sdev * sdev)), 0.2);
+}
+
+TEST(BoltzmannInverterTest, FitModesBimodal){
+    // Two well separated modes with 30:70 population
+    const double means[2] = {0.3, 0.5};
+    const double sdev = 0.02;
+    BondStruct bond(BondType::LENGTH);
+    normal_samples(bond.values_, means[0], sdev, 6000);
+    normal_samples(bond.values_, means[1], sdev, 14000);
+
+    BoltzmannInverter bi(300.);
+    bi.calculate(bond);
+    bi.fitModes(bond, 3);
+    ASSERT_EQ(2, bond.modes_.size());
+
+    const double kT = 8.314 * 300. / 1000.;
+    ASSERT_NEAR(0.3, bond.modes_[0].weight, 0.02);
+    ASSERT_NEAR(0.7, bond.modes_[1].weight, 0.02);
+    for(int i=0; i<2; i++){
+        ASSERT_NEAR(means[i], bond.modes_[i].mean, 0.005);
+        ASSERT_NEAR(sdev, bond.modes_[i].sdev, 0.003);
+        ASSERT_NEAR(1., bond.modes_[i].forceConstant / (kT / (sdev * sdev)), 0.3);
+    }
+}
+
+TEST(BoltzmannInverterTest, FitModesUnimodal){
+    BondStruct bond(BondType::LENGTH);
+    normal_samples(bond.values_, 0.4, 0.01, 20000);
+
+    BoltzmannInverter bi(300.);
+    bi.calculate(bond);
+    bi.fitModes(bond, 3);
+    ASSERT_EQ(1, bond.modes_.size());
+    ASSERT_NEAR(0.4, bond.modes_[0].mean, 0.001);
+}
+
+TEST(BoltzmannInverterTest, DihedralSeriesThreefold){
+    // Sample dihedrals from a threefold potential k (1 + cos(3 phi)) by inverting the CDF
+    const double kT = 8.314 * 300. / 1000.;
+    const double k = 5.;
+    const int grid = 36000;
+    vector<double> cdf(grid + 1, 0.);
+    for(int i=0; i<grid; i++){
+        const double phi = (-180. + (i + 0.5) * 360. / grid) * M_PI / 180.;
+        cdf[i+1] = cdf[i] + std::exp(-k * (1. + std::cos(3. * phi)) / kT);
+    }
+
+    BondStruct bond(BondType::DIHEDRAL);
+    const int n = 100000;
+    int j = 0;
+    for(int i=0; i<n; i++){
+        const double target = (i + 0.5) / n * cdf[grid];
+        while(cdf[j+1] < target) j++;
+        bond.values_.push_back(-180. + (j + 0.5) * 360. / grid);
+    }
+
+    BoltzmannInverter bi(300.);
+    bi.calculate(bond);
+    bi.fitDihedralSeries(bond);
+    ASSERT_EQ(1, bond.terms_.size());
+    ASSERT_EQ(3, bond.terms_[0].multiplicity);
+    ASSERT_NEAR(k, bond.terms_[0].forceConstant, 0.2);
+    ASSERT_NEAR(0., bond.terms_[0].phase, 1.);
+
+    // RB of cos(3 phi) = -4 cos^3(psi) + 3 cos(psi)
+    ASSERT_NEAR(3. * k, bond.rbCoeffs_[1], 0.5);
+    ASSERT_NEAR(0., bond.rbCoeffs_[2], 0.5);
+    ASSERT_NEAR(-4. * k, bond.rbCoeffs_[3], 0.5);
+}
+
 int main(int argc, char **argv){
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,106 @@
+#include "cell_list.h"
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+#include "gtest/gtest.h"
+
+#include "test_helpers.h"
+
+using std::vector;
+using std::array;
+
+/** Count pairs within cutoff by checking every pair using minimum image */
+static long long brute_force(const vector<array<double, 3>> &coords, const array<double, 3> &box,
+                             const double cutoff){
+    long long count = 0;
+    for(int i=0; i<coords.size(); i++){
+        for(int j=i+1; j<coords.size(); j++){
+            double dist2 = 0.;
+            for(int d=0; d<3; d++){
+                double delta = coords[j][d] - coords[i][d];
+                delta -= box[d] * std::round(delta / box[d]);
+                dist2 += delta * delta;
+            }
+            if(dist2 < cutoff * cutoff) count++;
+        }
+    }
+    return count;
+}
+
+static long long cell_list_count(const vector<array<double, 3>> &coords, const array<double, 3> &box,
+                                 const double cutoff){
+    CellList cells(cutoff);
+    cells.build(coords, box);
+    long long count = 0;
+    cells.forEachPair([&count](const int i, const int j, const double dist2){
+        #pragma omp atomic
+        count++;
+    });
+    return count;
+}
+
+TEST(CellListTest, MatchesBruteForce){
+    const array<double, 3> box = {{6., 5., 7.}};
+    const vector<array<double, 3>> coords = random_coords(2000, box, -0.5, 1.5);
+    CellList cells(1.2);
+    cells.build(coords, box);
+    ASSERT_EQ(5, cells.numCells()[0]);
+    ASSERT_EQ(brute_force(coords, box, 1.2), cell_list_count(coords, box, 1.2));
+}
+
+TEST(CellListTest, FewCells){
+    // Fewer than three cells along an axis - half shell would visit cells twice
+    const array<double, 3> box = {{2.5, 4., 2.1}};
+    const vector<array<double, 3>> coords = random_coords(500, box, -0.5, 1.5);
+    ASSERT_EQ(brute_force(coords, box, 1.), cell_list_count(coords, box, 1.));
+}
+
+TEST(CellListTest, EachPairOnce){
+    const array<double, 3> box = {{3., 3., 3.}};
+    const vector<array<double, 3>> coords = random_coords(300, box, -0.5, 1.5);
+    CellList cells(1.);
+    cells.build(coords, box);
+    vector<int> seen(300 * 300, 0);
+    cells.forEachPair([&seen](const int i, const int j, const double dist2){
+        const int lo = std::min(i, j), hi = std::max(i, j);
+        #pragma omp atomic
+        seen[lo * 300 + hi]++;
+    });
+    for(const int count : seen) ASSERT_LE(count, 1);
+}
+
+TEST(CellListTest, CutoffTooLarge){
+    const array<double, 3> box = {{3., 3., 1.5}};
+    CellList cells(1.);
+    ASSERT_THROW(cells.build(random_coords(10, box, -0.5, 1.5), box), std::invalid_argument);
+}
+
+TEST(CellListTest, BenchmarkScaling){
+    // Density similar to CG water - ten particles per nm^3
+    const double density = 10.;
+    const double cutoff = 1.2;
+    for(const int n : {10000, 100000, 1000000}){
+        const double side = std::cbrt(n / density);
+        const array<double, 3> box = {{side, side, side}};
+        const vector<array<double, 3>> coords = random_coords(n, box, -0.5, 1.5);
+
+        const auto start = std::chrono::steady_clock::now();
+        const long long pairs = cell_list_count(coords, box, cutoff);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        printf("CellList %8d particles %10lld pairs %8.3f s\n", n, pairs, elapsed.count());
+
+        // Uniform density - expect about half of N * rho * 4/3 pi rc^3 pairs
+        const double expected = 0.5 * n * density * 4. / 3. * M_PI * cutoff * cutoff * cutoff;
+        ASSERT_NEAR(1., pairs / expected, 0.05);
+    }
+}
+
+int main(int argc, char **argv){
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
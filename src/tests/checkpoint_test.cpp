@@ -0,0 +1,191 @@
+#include "checkpoint.h"
+
+#include <vector>
+#include <string>
+#include <array>
+#include <map>
+#include <cstdio>
+
+#include "histogram_nd.h"
+#include "light_array.h"
+
+#include "gtest/gtest.h"
+
+using std::vector;
+using std::string;
+using std::array;
+using std::map;
+
+TEST(CheckpointTest, RoundTrip){
+    int frames = 42;
+    double mean = 3.25;
+    string name = "POPC";
+    vector<double> values = {1., 2.5, -3.};
+    vector<vector<int>> nested = {{1, 2}, {}, {3}};
+    array<double, 3> box = {{1., 2., 3.}};
+    map<string, int> counts = {{"a", 1}, {"bb", 2}};
+    vector<char> flags = {1, 0, 1};
+    LightArray<double> grid(3, 4);
+    grid(2, 3) = 7.;
+    const array<HistogramAxis, 1> axes = {{HistogramAxis::fromWidth(0.5, 0.3, 5)}};
+    HistogramND<double, 1> hist(axes);
+    hist.add({{1.}}, 2.);
+    hist.add({{10.}}, 1.);
+    {
+        Checkpoint cp("checkpoint_test.cpt", Checkpoint::Mode::SAVE);
+        cp.section("test");
+        cp.sync(frames);
+        cp.sync(mean);
+        cp.sync(name);
+        cp.sync(values);
+        cp.sync(nested);
+        cp.sync(box);
+        cp.sync(counts);
+        cp.sync(flags);
+        grid.checkpoint(cp);
+        hist.checkpoint(cp);
+        cp.save();
+    }
+
+    int frames2 = 0;
+    double mean2 = 0.;
+    string name2;
+    vector<double> values2;
+    vector<vector<int>> nested2 = {{5}};
+    array<double, 3> box2;
+    map<string, int> counts2 = {{"c", 3}};
+    vector<char> flags2;
+    LightArray<double> grid2;
+    HistogramND<double, 1> hist2;
+    {
+        Checkpoint cp("checkpoint_test.cpt", Checkpoint::Mode::LOAD);
+        ASSERT_TRUE(cp.loading());
+        cp.section("test");
+        cp.sync(frames2);
+        cp.sync(mean2);
+        cp.sync(name2);
+        cp.sync(values2);
+        cp.sync(nested2);
+        cp.sync(box2);
+        cp.sync(counts2);
+        cp.sync(flags2);
+        grid2.checkpoint(cp);
+        hist2.checkpoint(cp);
+    }
+    ASSERT_EQ(frames2, frames);
+    ASSERT_EQ(mean2, mean);
+    ASSERT_EQ(name2, name);
+    ASSERT_EQ(values2, values);
+    ASSERT_EQ(nested2, nested);
+    ASSERT_EQ(box2, box);
+    ASSERT_EQ(counts2, counts);
+    ASSERT_EQ(flags2, flags);
+    ASSERT_TRUE(grid2 == grid);
+    ASSERT_EQ(hist2.size(), 5);
+    ASSERT_EQ(hist2.axis(0).index(1.), hist.axis(0).index(1.));
+    for(int i=0; i<5; i++) ASSERT_EQ(hist2.at(i), hist.at(i));
+    ASSERT_EQ(hist2.outside(), 1.);
+    std::remove("checkpoint_test.cpt");
+}
+
+TEST(CheckpointTest, Rewind){
+    vector<double> values = {1., 2., 3.};
+    int frames = 3;
+    Checkpoint snapshot("checkpoint_rewind.cpt", Checkpoint::Mode::SAVE);
+    snapshot.section("test");
+    snapshot.sync(frames);
+    snapshot.sync(values);
+
+    // Changed in place as by normalising output
+    frames = 0;
+    for(double &val : values) val /= 3.;
+
+    snapshot.rewind();
+    ASSERT_TRUE(snapshot.loading());
+    snapshot.section("test");
+    snapshot.sync(frames);
+    snapshot.sync(values);
+    ASSERT_EQ(frames, 3);
+    ASSERT_EQ(values, vector<double>({1., 2., 3.}));
+
+    // Never written to disk
+    FILE *f = fopen("checkpoint_rewind.cpt", "r");
+    ASSERT_EQ(f, nullptr);
+}
+
+TEST(CheckpointTest, Mismatch){
+    {
+        Checkpoint cp("checkpoint_mismatch.cpt", Checkpoint::Mode::SAVE);
+        cp.section("bonds");
+        vector<double> data(10, 1.);
+        cp.syncData(data.data(), data.size());
+        cp.save();
+    }
+    {
+        Checkpoint cp("checkpoint_mismatch.cpt", Checkpoint::Mode::LOAD);
+        ASSERT_THROW(cp.section("rdf"), std::runtime_error);
+    }
+    {
+        Checkpoint cp("checkpoint_mismatch.cpt", Checkpoint::Mode::LOAD);
+        cp.section("bonds");
+        vector<double> data(5);
+        ASSERT_THROW(cp.syncData(data.data(), data.size()), std::runtime_error);
+    }
+    {
+        // Nothing left to read
+        Checkpoint cp("checkpoint_mismatch.cpt", Checkpoint::Mode::LOAD);
+        cp.section("bonds");
+        vector<double> data(10);
+        cp.syncData(data.data(), data.size());
+        int extra;
+        ASSERT_THROW(cp.sync(extra), std::runtime_error);
+    }
+    std::remove("checkpoint_mismatch.cpt");
+
+    FILE *f = fopen("checkpoint_mismatch.cpt", "w");
+    fprintf(f, "not a checkpoint\n");
+    fclose(f);
+    ASSERT_THROW(Checkpoint("checkpoint_mismatch.cpt", Checkpoint::Mode::LOAD), std::runtime_error);
+    std::remove("checkpoint_mismatch.cpt");
+    ASSERT_THROW(Checkpoint("checkpoint_mismatch.cpt", Checkpoint::Mode::LOAD), std::runtime_error);
+}
+
+TEST(CheckpointTest, StreamFileTruncated){
+    FILE *out = open_stream_file("checkpoint_stream.dat");
+    fprintf(out, "frame 1\n");
+    {
+        Checkpoint cp("checkpoint_stream.cpt", Checkpoint::Mode::SAVE);
+        cp.syncFile(out);
+        cp.save();
+    }
+    // Written after checkpoint then lost when resumed
+    fprintf(out, "frame 2\n");
+    fclose(out);
+
+    Checkpoint::setResuming(true);
+    out = open_stream_file("checkpoint_stream.dat");
+    Checkpoint::setResuming(false);
+    {
+        Checkpoint cp("checkpoint_stream.cpt", Checkpoint::Mode::LOAD);
+        cp.syncFile(out);
+    }
+    fprintf(out, "frame 2 again\n");
+    fclose(out);
+
+    char line[64];
+    vector<string> lines;
+    FILE *in = fopen("checkpoint_stream.dat", "r");
+    while(fgets(line, sizeof(line), in)) lines.push_back(line);
+    fclose(in);
+    ASSERT_EQ(lines, vector<string>({"frame 1\n", "frame 2 again\n"}));
+
+    // Output shorter than at the checkpoint cannot be resumed
+    out = fopen("checkpoint_stream.dat", "w");
+    {
+        Checkpoint cp("checkpoint_stream.cpt", Checkpoint::Mode::LOAD);
+        ASSERT_THROW(cp.syncFile(out), std::runtime_error);
+    }
+    fclose(out);
+    std::remove("checkpoint_stream.dat");
+    std::remove("checkpoint_stream.cpt");
+}
@@ -0,0 +1,140 @@
+#include "density_map.h"
+
+#include <vector>
+#include <array>
+#include <string>
+#include <cmath>
+#include <random>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+#include "test_helpers.h"
+
+using std::vector;
+using std::array;
+using std::string;
+
+static void name_atoms(Frame &frame){
+    for(int i=0; i<frame.numAtoms_; i++) frame.atoms_[i].atom_name = "OW";
+}
+
+TEST(DensityMapTest, UniformProfile){
+    const int num = 20000;
+    const double box = 4.;
+    vector<Residue> residues = single_atom_residues(num);
+    Frame frame(num, box, residues);
+    name_atoms(frame);
+
+    DensityMap map("SOL", "z", {10});
+    map.setup(frame, residues);
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<double> dist(-box, 2. * box);
+    for(int f=0; f<5; f++){
+        for(int i=0; i<num; i++){
+            // Some atoms outside the box are wrapped in
+            for(int d=0; d<3; d++) frame.atoms_[i].coords[d] = dist(gen);
+        }
+        map.add(frame);
+    }
+    map.reduce();
+
+    const double expected = num / (box * box * box);
+    double total = 0.;
+    for(int z=0; z<10; z++){
+        ASSERT_NEAR(expected, map.density(0, 0, z), 0.05 * expected);
+        total += map.density(0, 0, z) * box * box * box / 10.;
+    }
+    ASSERT_NEAR(num, total, 1e-6 * num);
+}
+
+TEST(DensityMapTest, FluctuatingBox){
+    vector<Residue> residues = single_atom_residues(2);
+    Frame frame(2, 4., residues);
+    name_atoms(frame);
+    DensityMap map("OW", "xy", {4, 2});
+    map.setup(frame, residues);
+
+    // Same fractional coordinates in boxes of different size fall in the same cells
+    for(const double box : {4., 5.}){
+        for(int d=0; d<3; d++) frame.box_[d][d] = static_cast<float>(box);
+        frame.atoms_[0].coords = {{0.1 * box, 0.3 * box, 0.5 * box}};
+        frame.atoms_[1].coords = {{0.9 * box, 0.7 * box, 0.5 * box}};
+        map.add(frame);
+    }
+    map.reduce();
+
+    const double mean_inv_vol = 0.5 * (8. / 64. + 8. / 125.);
+    ASSERT_NEAR(mean_inv_vol, map.density(0, 0), 1e-9);
+    ASSERT_NEAR(mean_inv_vol, map.density(3, 1), 1e-9);
+    ASSERT_DOUBLE_EQ(0., map.density(1, 0));
+    ASSERT_NEAR(4.5, map.meanBox()[0], 1e-6);
+}
+
+TEST(DensityMapTest, CentreAcrossBoundary){
+    vector<Residue> residues = single_atom_residues(4);
+    Frame frame(4, 10., residues);
+    name_atoms(frame);
+    DensityMap map("OW", "x", {10}, "OW");
+    map.setup(frame, residues);
+
+    // Cluster split across the periodic boundary is moved to the middle
+    const double xs[4] = {9.6, 9.8, 0.2, 0.4};
+    for(int i=0; i<4; i++) frame.atoms_[i].coords = {{xs[i], 5., 5.}};
+    map.add(frame);
+    map.reduce();
+    ASSERT_NEAR(4. / 2. / 100., map.density(4), 1e-9);
+    ASSERT_NEAR(4. / 2. / 100., map.density(5), 1e-9);
+    ASSERT_DOUBLE_EQ(0., map.density(0));
+    ASSERT_DOUBLE_EQ(0., map.density(9));
+}
+
+TEST(DensityMapTest, BinaryOutput){
+    vector<Residue> residues = single_atom_residues(1);
+    Frame frame(1, 3., residues);
+    name_atoms(frame);
+    DensityMap map("SOL", "xyz", {3, 3, 3});
+    map.setup(frame, residues);
+    frame.atoms_[0].coords = {{0.5, 1.5, 2.5}};
+    map.add(frame);
+    map.reduce();
+    map.printBinary("density_test");
+    map.printDX("density_test");
+
+    FILE *f = fopen("density_test.bin", "rb");
+    ASSERT_NE(nullptr, f);
+    char magic[4];
+    std::int32_t counts[3];
+    float origin[3], spacing[3];
+    vector<float> data(27);
+    ASSERT_EQ(4, fread(magic, 1, 4, f));
+    ASSERT_EQ(3, fread(counts, sizeof(std::int32_t), 3, f));
+    ASSERT_EQ(3, fread(origin, sizeof(float), 3, f));
+    ASSERT_EQ(3, fread(spacing, sizeof(float), 3, f));
+    ASSERT_EQ(27, fread(data.data(), sizeof(float), 27, f));
+    fclose(f);
+    std::remove("density_test.bin");
+    std::remove("density_test.dx");
+
+    ASSERT_EQ(0, std::strncmp(magic, "CGDM", 4));
+    for(int d=0; d<3; d++){
+        ASSERT_EQ(3, counts[d]);
+        ASSERT_FLOAT_EQ(1.f, spacing[d]);
+        ASSERT_FLOAT_EQ(0.5f, origin[d]);
+    }
+    // z varies fastest
+    ASSERT_FLOAT_EQ(1.f, data[(0 * 3 + 1) * 3 + 2]);
+    ASSERT_FLOAT_EQ(1.f, data[0] + data[(0 * 3 + 1) * 3 + 2]);
+}
+
+TEST(DensityMapTest, BadSelection){
+    vector<Residue> residues = single_atom_residues(1);
+    Frame frame(1, 3., residues);
+    name_atoms(frame);
+    DensityMap map("POPC", "z", {10});
+    ASSERT_THROW(map.setup(frame, residues), std::runtime_error);
+    ASSERT_THROW(DensityMap("SOL", "xz", {10}), std::invalid_argument);
+    ASSERT_THROW(DensityMap("SOL", "w", {10}), std::invalid_argument);
+}
@@ -0,0 +1,88 @@
+#include "diffusion.h"
+
+#include <vector>
+#include <array>
+#include <string>
+#include <cmath>
+#include <random>
+
+#include "gtest/gtest.h"
+
+using std::vector;
+using std::array;
+using std::string;
+
+static double wrap(const double x, const double box){
+    return x - box * std::floor(x / box);
+}
+
+TEST(DiffusionTest, DirectSum){
+    const int num = 3, frames = 37;
+    const array<double, 2> box = {{5., 5.}};
+    Diffusion diff(vector<int>(num, 0), {"all"}, {0u});
+
+    std::mt19937 gen(7);
+    std::normal_distribution<double> gaussian;
+    vector<vector<array<double, 2>>> traj(frames, vector<array<double, 2>>(num));
+    for(int t=0; t<frames; t++){
+        for(int p=0; p<num; p++){
+            for(int d=0; d<2; d++){
+                traj[t][p][d] = (t == 0 ? 1. : traj[t-1][p][d]) + 0.3 * gaussian(gen);
+            }
+        }
+        vector<array<double, 2>> wrapped(traj[t]);
+        for(array<double, 2> &pos : wrapped) for(int d=0; d<2; d++) pos[d] = wrap(pos[d], box[d]);
+        diff.add(wrapped, box, 2. * t);
+    }
+    diff.calculate();
+
+    // Compare against O(T^2) sum over time origins of unwrapped positions
+    for(int m=0; m<frames; m++){
+        double direct = 0.;
+        for(int p=0; p<num; p++){
+            for(int t=0; t+m<frames; t++){
+                for(int d=0; d<2; d++){
+                    const double delta = traj[t+m][p][d] - traj[t][p][d];
+                    direct += delta * delta;
+                }
+            }
+        }
+        direct /= num * (frames - m);
+        ASSERT_NEAR(direct, diff.msd(0, m), 1e-4 * (1. + direct));
+        ASSERT_DOUBLE_EQ(2. * m, diff.lagTime(m));
+    }
+}
+
+TEST(DiffusionTest, RandomWalkWithDrift){
+    const int num = 400, frames = 500;
+    const double D_upper = 0.01, D_lower = 0.02, dt = 10.;
+    const array<double, 2> box = {{10., 10.}};
+    vector<int> group(num);
+    for(int p=0; p<num; p++) group[p] = p % 2;
+    Diffusion diff(group, {"upper", "lower"}, {1u, 2u});
+
+    std::mt19937 gen(11);
+    std::normal_distribution<double> gaussian;
+    vector<array<double, 2>> pos(num);
+    for(int p=0; p<num; p++) pos[p] = {{box[0] * (gaussian(gen) + 3.) / 6., box[1] * 0.5}};
+    for(int t=0; t<frames; t++){
+        vector<array<double, 2>> wrapped(num);
+        for(int p=0; p<num; p++){
+            const double D = group[p] == 0 ? D_upper : D_lower;
+            for(int d=0; d<2; d++){
+                // Each leaflet drifts steadily - removed by the analysis
+                if(t > 0) pos[p][d] += std::sqrt(2. * D * dt) * gaussian(gen) + (group[p] == 0 ? 0.05 : -0.03);
+                wrapped[p][d] = wrap(pos[p][d], box[d]);
+            }
+        }
+        diff.add(wrapped, box, t * dt);
+    }
+    diff.calculate();
+
+    double D;
+    ASSERT_TRUE(diff.fit(0, 0., 1000., D));
+    ASSERT_NEAR(D_upper, D, 0.1 * D_upper);
+    ASSERT_TRUE(diff.fit(1, 0., 1000., D));
+    ASSERT_NEAR(D_lower, D, 0.1 * D_lower);
+    ASSERT_FALSE(diff.fit(1, 0., 5., D));
+}
@@ -0,0 +1,84 @@
+#include "fft.h"
+
+#include <vector>
+#include <complex>
+#include <cmath>
+
+#include "gtest/gtest.h"
+
+using std::vector;
+using std::complex;
+
+/** \brief Naive O(N^2) DFT to test against */
+static vector<complex<double>> dft(const vector<complex<double>> &in){
+    const int n = static_cast<int>(in.size());
+    vector<complex<double>> out(n);
+    for(int k=0; k<n; k++){
+        for(int j=0; j<n; j++){
+            const double ang = -2. * M_PI * j * k / n;
+            out[k] += in[j] * complex<double>(cos(ang), sin(ang));
+        }
+    }
+    return out;
+}
+
+static vector<complex<double>> test_signal(const int n){
+    vector<complex<double>> sig(n);
+    for(int i=0; i<n; i++) sig[i] = complex<double>(sin(0.3 * i) + 0.1 * i, cos(1.7 * i));
+    return sig;
+}
+
+TEST(FFTTest, MatchesDFTPow2){
+    vector<complex<double>> sig = test_signal(64);
+    const vector<complex<double>> ref = dft(sig);
+    FFT plan(64);
+    plan.forward(sig);
+    for(int i=0; i<64; i++){
+        ASSERT_NEAR(ref[i].real(), sig[i].real(), 1e-9);
+        ASSERT_NEAR(ref[i].imag(), sig[i].imag(), 1e-9);
+    }
+}
+
+TEST(FFTTest, MatchesDFTBluestein){
+    vector<complex<double>> sig = test_signal(45);
+    const vector<complex<double>> ref = dft(sig);
+    FFT plan(45);
+    plan.forward(sig);
+    for(int i=0; i<45; i++){
+        ASSERT_NEAR(ref[i].real(), sig[i].real(), 1e-9);
+        ASSERT_NEAR(ref[i].imag(), sig[i].imag(), 1e-9);
+    }
+}
+
+TEST(FFTTest, RoundTrip3D){
+    const int nx = 6, ny = 8, nz = 5;
+    vector<complex<double>> sig = test_signal(nx * ny * nz);
+    const vector<complex<double>> orig(sig);
+    fft3D(sig, nx, ny, nz);
+    fft3D(sig, nx, ny, nz, true);
+    for(int i=0; i<nx*ny*nz; i++){
+        ASSERT_NEAR(orig[i].real(), sig[i].real(), 1e-9);
+        ASSERT_NEAR(orig[i].imag(), sig[i].imag(), 1e-9);
+    }
+}
+
+TEST(FFTTest, ConvolveZeroPadded){
+    vector<double> data = {0., 0., 1., 0., 0., 0., 2.};
+    const vector<double> kernel = {0.5, 0.25};
+    fft_convolve(data, kernel, false);
+    const vector<double> ref = {0., 0.25, 0.5, 0.25, 0., 0.5, 1.};
+    for(int i=0; i<7; i++) ASSERT_NEAR(ref[i], data[i], 1e-12);
+}
+
+TEST(FFTTest, ConvolvePeriodic){
+    vector<double> data = {0., 0., 1., 0., 0., 0., 2.};
+    const vector<double> kernel = {0.5, 0.25};
+    fft_convolve(data, kernel, true);
+    const vector<double> ref = {0.5, 0.25, 0.5, 0.25, 0., 0.5, 1.};
+    for(int i=0; i<7; i++) ASSERT_NEAR(ref[i], data[i], 1e-12);
+}
+
+int main(int argc, char **argv){
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,124 @@
+#include "histogram.h"
+#include "histogram_nd.h"
+
+#include <vector>
+#include <cmath>
+#include <limits>
+
+#include "gtest/gtest.h"
+
+using std::vector;
+using std::array;
+
+TEST(HistogramTest, ShardedIncrement){
+    Histogram hist(10);
+    const int n = 100000;
+    #pragma omp parallel for
+    for(int i=0; i<n; i++) hist.increment(i % 10);
+    hist.reduce();
+    for(int i=0; i<10; i++) ASSERT_EQ(n / 10, hist.at(i));
+
+    // Counts beyond the range of a 32 bit int
+    Histogram big(1);
+    big.zero(2147483647);
+    big.increment(0);
+    big.reduce();
+    ASSERT_EQ(2147483648LL, big.at(0));
+}
+
+TEST(HistogramTest, AddRealValues){
+    Histogram hist;
+    hist.init(1., 2., 10);
+    hist.add(1.05);
+    hist.add(1.95);
+    hist.add(0.5);
+    hist.add(2.);
+    hist.reduce();
+    ASSERT_EQ(1, hist.at(0));
+    ASSERT_EQ(1, hist.at(9));
+    std::int64_t total = 0;
+    for(int i=0; i<10; i++) total += hist.at(i);
+    ASSERT_EQ(2, total);
+}
+
+TEST(HistogramAxisTest, Uniform){
+    HistogramAxis axis(0., 1., 10);
+    ASSERT_EQ(10, axis.bins());
+    ASSERT_EQ(0, axis.index(0.));
+    ASSERT_EQ(3, axis.index(0.35));
+    ASSERT_EQ(9, axis.index(0.999));
+    ASSERT_EQ(-1, axis.index(-0.01));
+    ASSERT_EQ(10, axis.index(1.));
+    ASSERT_EQ(10, axis.index(std::numeric_limits<double>::quiet_NaN()));
+    ASSERT_DOUBLE_EQ(0.35, axis.centre(3));
+}
+
+TEST(HistogramAxisTest, Edges){
+    HistogramAxis axis(vector<double>{0., 1., 3., 7.});
+    ASSERT_EQ(3, axis.bins());
+    ASSERT_EQ(0, axis.index(0.5));
+    ASSERT_EQ(1, axis.index(1.));
+    ASSERT_EQ(2, axis.index(6.9));
+    ASSERT_EQ(3, axis.index(7.));
+    ASSERT_EQ(-1, axis.index(-1.));
+    ASSERT_DOUBLE_EQ(4., axis.width(2));
+
+    ASSERT_THROW(HistogramAxis(vector<double>{0., 1., 1.}), std::invalid_argument);
+    ASSERT_THROW(HistogramAxis(1., 0., 10), std::invalid_argument);
+}
+
+TEST(HistogramAxisTest, Periodic){
+    HistogramAxis axis(-180., 180., 36, true);
+    ASSERT_EQ(0, axis.index(-180.));
+    ASSERT_EQ(0, axis.index(180.));
+    ASSERT_EQ(35, axis.index(-185.));
+    ASSERT_EQ(18, axis.index(365.));
+}
+
+TEST(HistogramNDTest, BatchMatchesSingle){
+    const array<HistogramAxis, 2> axes = {{HistogramAxis(0., 1., 7),
+                                           HistogramAxis(vector<double>{-1., 0., 0.5, 2.})}};
+    HistogramND<double, 2> single(axes), batch(axes);
+
+    vector<double> x, y, w;
+    for(int i=0; i<1000; i++){
+        x.push_back(std::fmod(i * 0.618034, 1.2) - 0.1);
+        y.push_back(std::fmod(i * 0.414214, 3.5) - 1.2);
+        w.push_back(0.5 + (i % 3));
+        single.add({{x.back(), y.back()}}, w.back());
+    }
+    batch.addBatch({{x.data(), y.data()}}, static_cast<int>(x.size()), w.data());
+
+    for(int i=0; i<single.size(); i++) ASSERT_DOUBLE_EQ(single.at(i), batch.at(i));
+    ASSERT_DOUBLE_EQ(single.outside(), batch.outside());
+    ASSERT_GT(batch.outside(), 0.);
+
+    double weight = 0.;
+    for(const double val : w) weight += val;
+    ASSERT_NEAR(weight, batch.total() + batch.outside(), 1e-9);
+}
+
+TEST(HistogramNDTest, MergeAndDensity){
+    const array<HistogramAxis, 2> axes = {{HistogramAxis(0., 2., 4), HistogramAxis(0., 1., 5)}};
+    vector<HistogramND<std::int64_t, 2>> parts(5, HistogramND<std::int64_t, 2>(axes));
+    for(int p=0; p<5; p++){
+        for(int i=0; i<100; i++) parts[p].add({{(i % 20) * 0.1 + 0.01, (i % 10) * 0.1 + 0.01}});
+    }
+    reduce_partials(parts);
+    ASSERT_EQ(500, parts[0].total());
+    ASSERT_EQ(50, parts[0].at({{0, 0}}));
+
+    // Density integrates to one over the bins
+    const vector<double> density = parts[0].density();
+    double integral = 0.;
+    for(const double d : density) integral += d * 0.5 * 0.2;
+    ASSERT_NEAR(1., integral, 1e-12);
+
+    const array<HistogramAxis, 2> other = {{HistogramAxis(0., 2., 4), HistogramAxis(0., 1., 6)}};
+    ASSERT_THROW(parts[0].merge(HistogramND<std::int64_t, 2>(other)), std::invalid_argument);
+}
+
+int main(int argc, char **argv){
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
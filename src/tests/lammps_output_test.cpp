@@ -0,0 +1,93 @@
+#include "LammpsTrjOutput.h"
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+using std::vector;
+using std::string;
+
+template<typename T>
+static T read_value(FILE *file){
+    T value;
+    if(fread(&value, sizeof(T), 1, file) != 1) throw std::runtime_error("Unexpected end of file");
+    return value;
+}
+
+TEST(LammpsOutputTest, TextFormat){
+    vector<Residue> residues(1);
+    Frame frame(2, 3., residues);
+    frame.atoms_[1].coords = {{1., 2., 3.}};
+    frame.atoms_[1].mass = 72.;
+    {
+        LammpsTrjOutput output(frame.numAtoms_, "lammps_output_test.trj");
+        ASSERT_EQ(output.writeFrame(frame), 0);
+    }
+
+    FILE *file = fopen("lammps_output_test.trj", "r");
+    char line[256];
+    vector<string> lines;
+    while(fgets(line, 256, file)) lines.push_back(line);
+    fclose(file);
+    std::remove("lammps_output_test.trj");
+
+    ASSERT_EQ(lines.size(), 11);
+    ASSERT_EQ(lines[5], "-15.000000 15.000000\n");
+    ASSERT_EQ(lines[10], "      2    2    1    -5.0000     5.0000    15.0000   0.00000   0.00000   0.00000 72.0  2.7\n");
+}
+
+TEST(LammpsOutputTest, BinaryFormat){
+    vector<Residue> residues(1);
+    Frame frame(3, 4., residues);
+    frame.num_ = 12;
+    frame.time_ = 2.5f;
+    for(int i=0; i<frame.numAtoms_; i++) frame.atoms_[i].coords = {{0.1 * i, 0.2 * i, 0.3 * i}};
+    {
+        LammpsTrjOutput output(frame.numAtoms_, "lammps_output_test.bin", true);
+        ASSERT_EQ(output.writeFrame(frame), 0);
+        ASSERT_EQ(output.writeFrame(frame), 0);
+    }
+
+    // Read as LAMMPS' binary2txt would
+    FILE *file = fopen("lammps_output_test.bin", "rb");
+    for(int f=0; f<2; f++){
+        ASSERT_EQ(read_value<std::int64_t>(file), -8);
+        char magic[8];
+        ASSERT_EQ(fread(magic, 1, 8, file), 8);
+        ASSERT_EQ(string(magic, 8), "DUMPATOM");
+        ASSERT_EQ(read_value<std::int32_t>(file), 1);
+        ASSERT_EQ(read_value<std::int32_t>(file), 2);
+        ASSERT_EQ(read_value<std::int64_t>(file), 12);
+        ASSERT_EQ(read_value<std::int64_t>(file), 3);
+        ASSERT_EQ(read_value<std::int32_t>(file), 0);
+        for(int i=0; i<6; i++) ASSERT_EQ(read_value<std::int32_t>(file), 0);
+        for(int i=0; i<6; i++) ASSERT_DOUBLE_EQ(read_value<double>(file), i % 2 ? 20. : -20.);
+        const int size_one = read_value<std::int32_t>(file);
+        ASSERT_EQ(size_one, 11);
+        ASSERT_EQ(read_value<std::int32_t>(file), 0);
+        ASSERT_EQ(read_value<char>(file), 1);
+        ASSERT_DOUBLE_EQ(read_value<double>(file), 2.5);
+        const int len = read_value<std::int32_t>(file);
+        vector<char> columns(len);
+        ASSERT_EQ(fread(columns.data(), 1, len, file), len);
+        ASSERT_EQ(string(columns.data(), len), "id type mol x y z mux muy muz mass diameter");
+        ASSERT_EQ(read_value<std::int32_t>(file), 1);
+        ASSERT_EQ(read_value<std::int32_t>(file), 3 * size_one);
+
+        for(int i=0; i<3; i++){
+            vector<double> values(size_one);
+            ASSERT_EQ(fread(values.data(), sizeof(double), size_one, file), size_one);
+            ASSERT_DOUBLE_EQ(values[0], i + 1);
+            ASSERT_DOUBLE_EQ(values[3], 10 * 0.1 * i - 20.);
+            ASSERT_DOUBLE_EQ(values[5], 10 * 0.3 * i - 20.);
+        }
+    }
+    char extra;
+    ASSERT_EQ(fread(&extra, 1, 1, file), 0);
+    fclose(file);
+    std::remove("lammps_output_test.bin");
+}
@@ -1,5 +1,8 @@
 #include "light_array.h"
 
+#include <cmath>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 
@@ -147,6 +150,92 @@ TEST(LightArrayTest, InitAccess2dSpeedFast){
     }
 }
 
+/** Serial red-black Gauss-Seidel in the original lexicographic order */
+static void reference_smooth(std::vector<std::vector<double>> &a, const int n_iter, const bool periodic){
+    const int nx = a.size(), ny = a[0].size();
+    for(int pass=0; pass<2*n_iter; pass++){
+        for(int i=0; i<nx; i++){
+            for(int j=0; j<ny; j++){
+                if((i + j) % 2 != pass % 2) continue;
+                if(!periodic && (i == 0 || j == 0 || i == nx-1 || j == ny-1)) continue;
+                const double sum = a[(i+nx-1)%nx][j] + a[(i+1)%nx][j] + a[i][(j+ny-1)%ny] + a[i][(j+1)%ny];
+                a[i][j] += 0.25 * (sum - 4 * a[i][j]);
+            }
+        }
+    }
+}
+
+static void compare_smooth(const int nx, const int ny, const bool periodic){
+    LightArray<double> array(nx, ny);
+    std::vector<std::vector<double>> ref(nx, std::vector<double>(ny));
+    for(int i=0; i<nx; i++){
+        for(int j=0; j<ny; j++){
+            array(i, j) = ref[i][j] = std::sin(0.7 * i * i + 1.3 * j);
+        }
+    }
+    array.smooth(3, periodic);
+    reference_smooth(ref, 3, periodic);
+    for(int i=0; i<nx; i++){
+        for(int j=0; j<ny; j++){
+            ASSERT_NEAR(ref[i][j], array(i, j), 1e-12);
+        }
+    }
+}
+
+TEST(LightArrayTest, SmoothNonSquare){
+    compare_smooth(7, 12, false);
+    compare_smooth(12, 7, false);
+}
+
+TEST(LightArrayTest, SmoothPeriodic){
+    compare_smooth(8, 10, true);
+    compare_smooth(9, 11, true);
+}
+
+TEST(LightArrayTest, GaussianPeriodic){
+    const int nx = 20, ny = 30;
+    const double sigma = 1.5;
+    LightArray<double> array(nx, ny);
+    array(3, 28) = 1.;
+    array.gaussianFilter(sigma);
+    ASSERT_NEAR(1., array.sum(), 1e-12);
+
+    // Separable kernel wraps around the edges
+    const double peak = array(3, 28);
+    ASSERT_NEAR(array(3, 1), array(3, 25), 1e-12);
+    ASSERT_NEAR(array(1, 28), array(5, 28), 1e-12);
+    ASSERT_NEAR(array(4, 29) / peak, std::exp(-1. / (sigma * sigma)), 1e-12);
+}
+
+TEST(LightArrayTest, GaussianEdges){
+    LightArray<double> array(15, 10);
+    array.zero(2.);
+    array.gaussianFilter(2., false);
+    for(int i=0; i<15; i++){
+        for(int j=0; j<10; j++){
+            ASSERT_NEAR(2., array(i, j), 1e-12);
+        }
+    }
+}
+
+TEST(LightArrayTest, GaussianSpeed){
+    const int size = 1000;
+    LightArray<double> array(size, size);
+    for(int i=0; i<size; i++){
+        for(int j=0; j<size; j++){
+            array(i, j) = (i + j) % 2;
+        }
+    }
+    array.gaussianFilter(2.);
+    array.smooth(10, true);
+    // Checkerboard is the highest frequency so is almost entirely removed
+    for(int i=0; i<size; i++){
+        for(int j=0; j<size; j++){
+            ASSERT_NEAR(0.5, array(i, j), 1e-3);
+        }
+    }
+}
+
 int main(int argc, char **argv){
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
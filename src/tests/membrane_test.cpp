@@ -0,0 +1,337 @@
+#include "membrane.h"
+
+#include <vector>
+#include <array>
+#include <string>
+#include <cmath>
+#include <random>
+#include <fstream>
+#include <algorithm>
+
+#include "gtest/gtest.h"
+
+#include "test_helpers.h"
+
+using std::vector;
+using std::array;
+using std::string;
+
+/** Membrane with its per frame state exposed for checking */
+class TestMembrane : public Membrane{
+public:
+    using Membrane::Membrane;
+    using Membrane::upperHeads_;
+    using Membrane::lowerHeads_;
+    using Membrane::upperPair_;
+    using Membrane::lowerPair_;
+    using Membrane::closestUpper_;
+    using Membrane::closestLower_;
+    using Membrane::undulation_;
+    using Membrane::isProtein;
+    using Membrane::protOccupancy_;
+    using Membrane::leafletHeight;
+};
+
+/** Two bead lipids - head then tail - followed by a block of protein atoms */
+static vector<Residue> bilayer_residues(const int num_lipids, const int num_prot){
+    vector<Residue> residues(num_prot > 0 ? 2 : 1);
+    Residue &lip = residues[0];
+    lip.resname = "LIP";
+    lip.ref_atom_name = "H";
+    lip.ref_atom = 0;
+    lip.num_atoms = 2;
+    lip.num_residues = num_lipids;
+    lip.total_atoms = 2 * num_lipids;
+    lip.start = 0;
+    lip.end = 2 * num_lipids;
+
+    if(num_prot > 0){
+        Residue &prot = residues[1];
+        prot.resname = "PROT";
+        prot.ref_atom_name = "ALL";
+        prot.num_atoms = num_prot;
+        prot.num_residues = 1;
+        prot.total_atoms = num_prot;
+        prot.start = lip.end;
+        prot.end = lip.end + num_prot;
+    }
+    return residues;
+}
+
+/** Flat bilayer of n x n lipids per leaflet in a box of side box - lower leaflet first, tails towards the middle */
+static void place_bilayer(Frame &frame, const int n, const double box,
+                          const double lower_z=2., const double upper_z=4.){
+    const double spacing = box / n;
+    for(int r=0; r<2*n*n; r++){
+        const bool upper = r >= n * n;
+        const int k = r % (n * n);
+        const double x = (k / n + 0.5) * spacing;
+        const double y = (k % n + 0.5) * spacing;
+        const double z = upper ? upper_z : lower_z;
+        frame.atoms_[2 * r].coords = {{x, y, z}};
+        frame.atoms_[2 * r + 1].coords = {{x, y, z + (upper ? -0.5 : 0.5)}};
+    }
+}
+
+/** Column of protein atoms through the middle of the bilayer at (x, y) */
+static void place_protein(Frame &frame, const int first, const int num, const double x, const double y){
+    for(int k=0; k<num; k++) frame.atoms_[first + k].coords = {{x, y, 2.5 + k / (num - 1.)}};
+}
+
+TEST(MembraneTest, ProteinHasNoClosestLipid){
+    const int n = 6, num_prot = 5;
+    const double box = 6.;
+    vector<Residue> residues = bilayer_residues(2 * n * n, num_prot);
+    Frame frame(4 * n * n + num_prot, box, residues);
+    place_bilayer(frame, n, box);
+    place_protein(frame, 4 * n * n, num_prot, 3., 3.);
+
+    TestMembrane membrane(residues, frame, 20, 4, false, false, 0.6, false, true);
+    ASSERT_EQ(num_prot, membrane.proteinAtoms().size());
+    ASSERT_NEAR(2., membrane.thickness(frame), 1e-9);
+
+    int num_protein = 0;
+    for(int i=0; i<20; i++){
+        for(int j=0; j<20; j++){
+            const bool protein = membrane.isProtein(i, j);
+            ASSERT_EQ(protein, membrane.closestUpper_(i, j) < 0);
+            ASSERT_EQ(protein, membrane.closestLower_(i, j) < 0);
+            num_protein += protein;
+        }
+    }
+    ASSERT_GT(num_protein, 0);
+
+    // Flat membrane has no undulations - protein must not add any
+    ASSERT_EQ(1, membrane.undulation_.frames());
+    for(int s=0; s<membrane.undulation_.axis().bins(); s++){
+        ASSERT_NEAR(0., membrane.undulation_.height(s), 1e-12);
+        ASSERT_NEAR(0., membrane.undulation_.thickness(s), 1e-12);
+    }
+}
+
+TEST(MembraneTest, ProteinFilledWithLeafletMean){
+    const int n = 6, num_prot = 5;
+    const double box = 6.;
+    vector<Residue> residues = bilayer_residues(2 * n * n, num_prot);
+    Frame frame(4 * n * n + num_prot, box, residues);
+    place_bilayer(frame, n, box);
+    place_protein(frame, 4 * n * n, num_prot, 0.1, 5.9);
+
+    // Rough upper leaflet
+    std::mt19937 gen(12345);
+    std::uniform_real_distribution<double> dist(-0.2, 0.2);
+    for(int r=n*n; r<2*n*n; r++) frame.atoms_[2 * r].coords[2] += dist(gen);
+
+    TestMembrane membrane(residues, frame, 20, 4, false, false, 0.6, false, true);
+    membrane.thickness(frame);
+
+    LightArray<double> height;
+    membrane.leafletHeight(frame, membrane.closestUpper_, height);
+    double sum = 0.;
+    int n_vals = 0;
+    for(int i=0; i<20; i++){
+        for(int j=0; j<20; j++){
+            const int head = membrane.closestUpper_(i, j);
+            if(head < 0) continue;
+            ASSERT_EQ(frame.atoms_[head].coords[2], height(i, j));
+            sum += height(i, j);
+            n_vals++;
+        }
+    }
+    ASSERT_LT(n_vals, 400);
+
+    // Protein straddles the corner of the box
+    ASSERT_TRUE(membrane.isProtein(0, 19));
+    ASSERT_TRUE(membrane.isProtein(19, 0));
+    for(int i=0; i<20; i++){
+        for(int j=0; j<20; j++){
+            if(membrane.closestUpper_(i, j) >= 0) continue;
+            ASSERT_NEAR(sum / n_vals, height(i, j), 1e-12);
+        }
+    }
+}
+
+TEST(MembraneTest, FlipFlop){
+    const int n = 4;
+    const double box = 6.;
+    vector<Residue> residues = bilayer_residues(2 * n * n, 0);
+    Frame frame(4 * n * n, box, residues);
+    place_bilayer(frame, n, box);
+
+    // One block so the midplane is the mean head height
+    TestMembrane membrane(residues, frame, 20, 1, false, false, 0., true, false);
+    ASSERT_EQ(n * n, membrane.upperHeads_.size());
+    ASSERT_EQ(n * n, membrane.lowerHeads_.size());
+
+    // Lower lipid crosses the midplane with its head now above its tail
+    const int flip = 0;
+    frame.atoms_[flip].coords[2] = 3.6;
+    frame.atoms_[flip + 1].coords[2] = 3.1;
+    // Near the midplane on the other side but still pointing the old way
+    const int lower_near = 2;
+    frame.atoms_[lower_near].coords[2] = 3.2;
+    frame.atoms_[lower_near + 1].coords[2] = 3.7;
+    const int upper_near = 2 * n * n;
+    frame.atoms_[upper_near].coords[2] = 2.9;
+    frame.atoms_[upper_near + 1].coords[2] = 2.4;
+    // Reversed but far from the midplane on its own side
+    const int upper_far = 2 * n * n + 2;
+    frame.atoms_[upper_far + 1].coords[2] = 4.5;
+
+    frame.time_ = 10.;
+    membrane.thickness(frame);
+    frame.time_ = 20.;
+    membrane.thickness(frame);
+
+    ASSERT_EQ(1, membrane.leaflet(flip));
+    ASSERT_EQ(-1, membrane.leaflet(lower_near));
+    ASSERT_EQ(1, membrane.leaflet(upper_near));
+    ASSERT_EQ(1, membrane.leaflet(upper_far));
+
+    ASSERT_EQ(n * n + 1, membrane.upperHeads_.size());
+    ASSERT_EQ(n * n - 1, membrane.lowerHeads_.size());
+    const vector<int> &upper = membrane.upperHeads_;
+    const vector<int> &lower = membrane.lowerHeads_;
+    ASSERT_NE(upper.end(), std::find(upper.begin(), upper.end(), flip));
+    ASSERT_EQ(lower.end(), std::find(lower.begin(), lower.end(), flip));
+
+    // One event only - the lipid stays put in the second frame
+    std::ifstream file("flipflop.dat");
+    double time;
+    int atom;
+    string resname, from, to;
+    ASSERT_TRUE(bool(file >> time >> atom >> resname >> from >> to));
+    ASSERT_NEAR(10., time, 1e-6);
+    ASSERT_EQ(flip + 1, atom);
+    ASSERT_EQ("LIP", resname);
+    ASSERT_EQ("lower", from);
+    ASSERT_EQ("upper", to);
+    ASSERT_FALSE(bool(file >> time));
+}
+
+TEST(MembraneTest, RasteriseProteinBruteForce){
+    const int n = 6, num_prot = 40, grid = 20;
+    const double box = 6., radius = 0.45;
+    vector<Residue> residues = bilayer_residues(2 * n * n, num_prot);
+    Frame frame(4 * n * n + num_prot, box, residues);
+    place_bilayer(frame, n, box);
+
+    // Random protein atoms inside the bilayer plus some on each edge and corner of the box
+    const int first = 4 * n * n;
+    std::mt19937 gen(12345);
+    std::uniform_real_distribution<double> dist(0., box);
+    std::uniform_real_distribution<double> dist_z(2.5, 3.5);
+    for(int k=0; k<num_prot; k++) frame.atoms_[first + k].coords = {{dist(gen), dist(gen), dist_z(gen)}};
+    const array<array<double, 2>, 5> edges = {{{{0.05, 3.}}, {{5.97, 1.}}, {{2., 0.01}}, {{4., 5.9}}, {{5.99, 5.98}}}};
+    for(int k=0; k<edges.size(); k++){
+        frame.atoms_[first + k].coords[0] = edges[k][0];
+        frame.atoms_[first + k].coords[1] = edges[k][1];
+    }
+
+    TestMembrane membrane(residues, frame, grid, 4, false, false, radius, false, false);
+    ASSERT_EQ(num_prot, membrane.proteinAtoms().size());
+    membrane.thickness(frame);
+
+    // Minimum image distance from each grid point to every protein atom
+    const double step = box / grid;
+    int num_protein = 0;
+    for(int i=0; i<grid; i++){
+        for(int j=0; j<grid; j++){
+            bool covered = false;
+            for(int k=0; k<num_prot; k++){
+                const array<double, 3> &coords = frame.atoms_[first + k].coords;
+                double dx = (i + 0.5) * step - coords[0];
+                double dy = (j + 0.5) * step - coords[1];
+                dx -= box * std::round(dx / box);
+                dy -= box * std::round(dy / box);
+                if(dx * dx + dy * dy <= radius * radius) covered = true;
+            }
+            ASSERT_EQ(covered, membrane.isProtein(i, j)) << i << " " << j;
+            ASSERT_EQ(covered ? 1. : 0., membrane.protOccupancy_(i, j));
+            num_protein += covered;
+        }
+    }
+    ASSERT_GT(num_protein, 0);
+    ASSERT_LT(num_protein, grid * grid);
+
+    // Corner atom covers all four corners of the grid through the periodic boundary
+    ASSERT_TRUE(membrane.isProtein(0, 0));
+    ASSERT_TRUE(membrane.isProtein(0, grid - 1));
+    ASSERT_TRUE(membrane.isProtein(grid - 1, 0));
+    ASSERT_TRUE(membrane.isProtein(grid - 1, grid - 1));
+}
+
+/** Index in heads of the closest head to (x, y) in the plane by minimum image - lowest index wins a tie */
+static int brute_force_nearest(const Frame &frame, const vector<int> &heads,
+                               const double x, const double y, const array<double, 3> &box){
+    int closest = -1;
+    double min_dist2 = 0.;
+    for(int k=0; k<heads.size(); k++){
+        double dx = frame.atoms_[heads[k]].coords[0] - x;
+        double dy = frame.atoms_[heads[k]].coords[1] - y;
+        dx -= box[0] * std::round(dx / box[0]);
+        dy -= box[1] * std::round(dy / box[1]);
+        const double dist2 = dx * dx + dy * dy;
+        if(closest < 0 || dist2 < min_dist2){
+            closest = k;
+            min_dist2 = dist2;
+        }
+    }
+    return closest;
+}
+
+TEST(MembraneTest, PairsBruteForce){
+    const int n = 8, grid = 25;
+    const array<double, 3> box = {{6., 5., 6.}};
+    vector<Residue> residues = bilayer_residues(2 * n * n, 0);
+    Frame frame(4 * n * n, box[0], residues);
+    frame.box_[1][1] = box[1];
+    frame.boxDiag_[1] = box[1];
+
+    // Rough leaflets with some heads just outside the box in x and y
+    const vector<array<double, 3>> coords = random_coords(2 * n * n, box, -0.05, 1.05);
+    for(int r=0; r<2*n*n; r++){
+        const bool upper = r >= n * n;
+        const double z = (upper ? 4. : 2.) + 0.5 * (coords[r][2] / box[2] - 0.5);
+        frame.atoms_[2 * r].coords = {{coords[r][0], coords[r][1], z}};
+        frame.atoms_[2 * r + 1].coords = {{coords[r][0], coords[r][1], z + (upper ? -0.5 : 0.5)}};
+    }
+
+    // One block since some heads are outside the box
+    TestMembrane membrane(residues, frame, grid, 1, false, false, 0., false, false);
+    ASSERT_EQ(n * n, membrane.upperHeads_.size());
+    ASSERT_EQ(n * n, membrane.lowerHeads_.size());
+    const double avg = membrane.thickness(frame);
+
+    const vector<int> *heads[2] = {&membrane.upperHeads_, &membrane.lowerHeads_};
+    const vector<double> *pairs[2] = {&membrane.upperPair_, &membrane.lowerPair_};
+    const LightArray<int> *closest[2] = {&membrane.closestUpper_, &membrane.closestLower_};
+    double expected_avg = 0.;
+    for(int l=0; l<2; l++){
+        const vector<int> &ref = *heads[l];
+        const vector<int> &other = *heads[1 - l];
+        ASSERT_EQ(ref.size(), pairs[l]->size());
+
+        // Distance in z to the closest head in the other leaflet
+        vector<double> expected_pairs(ref.size());
+        for(int k=0; k<ref.size(); k++){
+            const array<double, 3> &r_k = frame.atoms_[ref[k]].coords;
+            const int other_k = brute_force_nearest(frame, other, r_k[0], r_k[1], box);
+            expected_pairs[k] = std::abs(r_k[2] - frame.atoms_[other[other_k]].coords[2]);
+            ASSERT_EQ(expected_pairs[k], (*pairs[l])[k]);
+        }
+
+        // Closest head to each grid point
+        double sum = 0.;
+        for(int i=0; i<grid; i++){
+            for(int j=0; j<grid; j++){
+                const int k = brute_force_nearest(frame, ref, (i + 0.5) * box[0] / grid,
+                                                  (j + 0.5) * box[1] / grid, box);
+                ASSERT_EQ(ref[k], closest[l]->at(i, j)) << i << " " << j;
+                sum += expected_pairs[k];
+            }
+        }
+        expected_avg += 0.5 * sum / (grid * grid);
+    }
+    ASSERT_NEAR(expected_avg, avg, 1e-9);
+}
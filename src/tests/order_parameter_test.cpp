@@ -0,0 +1,119 @@
+#include "order_parameter.h"
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+#include "gtest/gtest.h"
+
+using std::vector;
+using std::string;
+
+/** Lipids of a head group and three tail atoms - half upper and half lower */
+static vector<Residue> lipid_residues(const int num){
+    vector<Residue> residues(1);
+    Residue &res = residues[0];
+    res.resname = "LIP";
+    res.ref_atom_name = "H";
+    res.ref_atom = 0;
+    res.num_atoms = 4;
+    res.num_residues = num;
+    res.total_atoms = 4 * num;
+    res.start = 0;
+    res.end = 4 * num;
+    const char *names[4] = {"H", "C1", "C2", "C3"};
+    for(int i=0; i<4; i++) res.name_to_num[names[i]] = i;
+    return residues;
+}
+
+/** Place lipid r with head at (x, y, z) and tail bonds along step, alternating in x by zig */
+static void place_lipid(Frame &frame, const int r, const double x, const double y, const double z,
+                        const std::array<double, 3> &step, const double zig=0.){
+    for(int a=0; a<4; a++){
+        frame.atoms_[4 * r + a].coords = {{x + a * step[0] + (a % 2) * zig,
+                                           y + a * step[1], z + a * step[2]}};
+    }
+}
+
+TEST(OrderParameterTest, AllTrans){
+    const int num = 10;
+    vector<Residue> residues = lipid_residues(num);
+    Frame frame(4 * num, 5., residues);
+    for(int r=0; r<num; r++){
+        const double dir = r < num / 2 ? -1. : 1.;
+        place_lipid(frame, r, 0.5 * r, 1., 2.5 - dir, {{0., 0., 0.125 * dir}}, 0.1);
+    }
+
+    OrderParameter order(residues, 10);
+    order.addChain("LIP", {"H", "C1", "C2", "C3"});
+    order.calculate(frame);
+
+    // Zig-zag bonds make the same angle to z - chain axis is along z so S_CD = -1/2
+    const double cos2 = 0.125 * 0.125 / (0.125 * 0.125 + 0.1 * 0.1);
+    for(int b=0; b<3; b++){
+        ASSERT_NEAR(1.5 * cos2 - 0.5, order.scc(0, b, 0), 1e-9);
+        ASSERT_NEAR(1.5 * cos2 - 0.5, order.scc(0, b, 1), 1e-9);
+    }
+    for(int a=1; a<3; a++){
+        ASSERT_NEAR(-0.5, order.scd(0, a, 0), 1e-9);
+        ASSERT_NEAR(-0.5, order.scd(0, a, 1), 1e-9);
+    }
+}
+
+TEST(OrderParameterTest, LeafletsByOrientation){
+    const int num = 8;
+    vector<Residue> residues = lipid_residues(num);
+    Frame frame(4 * num, 5., residues);
+    // Upper leaflet straight along the normal, lower leaflet lying flat
+    for(int r=0; r<num/2; r++) place_lipid(frame, r, 0.5 * r, 1., 3.5, {{0., 0., -0.15}});
+    for(int r=num/2; r<num; r++) place_lipid(frame, r, 1., 0.5 * r, 0.5, {{0.1, 0.1, 1e-3}});
+
+    OrderParameter order(residues, 10);
+    order.addChain("LIP", {"H", "C1", "C2", "C3"});
+    order.calculate(frame);
+    order.calculate(frame);
+    ASSERT_EQ(2, order.frames());
+
+    for(int b=0; b<3; b++){
+        ASSERT_NEAR(1., order.scc(0, b, 0), 1e-9);
+        ASSERT_NEAR(-0.5, order.scc(0, b, 1), 1e-4);
+        ASSERT_NEAR(0.25, order.scc(0, b), 1e-4);
+    }
+
+    order.reset();
+    ASSERT_EQ(0, order.frames());
+    ASSERT_DOUBLE_EQ(0., order.scc(0, 0));
+}
+
+TEST(OrderParameterTest, Isotropic){
+    const int num = 20000;
+    vector<Residue> residues = lipid_residues(num);
+    Frame frame(4 * num, 10., residues);
+    // Bonds uniformly distributed on the sphere
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    for(int r=0; r<num; r++){
+        const double cos_t = 2. * uniform(gen) - 1.;
+        const double sin_t = std::sqrt(1. - cos_t * cos_t);
+        const double phi = 2. * M_PI * uniform(gen);
+        const double len = 0.15;
+        place_lipid(frame, r, 10. * uniform(gen), 10. * uniform(gen), 5.,
+                    {{len * sin_t * std::cos(phi), len * sin_t * std::sin(phi), len * cos_t}});
+    }
+
+    OrderParameter order(residues, 10);
+    order.addChain("LIP", {"H", "C1", "C2"});
+    order.calculate(frame);
+    ASSERT_NEAR(0., order.scc(0, 0), 0.02);
+    ASSERT_NEAR(0., order.scc(0, 1), 0.02);
+}
+
+TEST(OrderParameterTest, MissingAtom){
+    vector<Residue> residues = lipid_residues(2);
+    OrderParameter order(residues);
+    ASSERT_THROW(order.addChain("LIP", {"H", "C4"}), std::invalid_argument);
+    ASSERT_THROW(order.addChain("POPC", {"H", "C1"}), std::invalid_argument);
+    ASSERT_THROW(order.addChain("LIP", {"H"}), std::invalid_argument);
+}
@@ -55,6 +55,72 @@ TEST(ParserTest, GetKeyFalse){
     ASSERT_FALSE(parser.getKeyFromSection("here", "nokey", value));
 }
 
+TEST(ParserTest, GetLineFromSectionRef){
+    Parser parser("../test_data/modules/parser.cfg");
+    std::vector<boost::string_ref> tokens;
+    ASSERT_TRUE(parser.getLineFromSection("test", tokens));
+    ASSERT_EQ(tokens.size(), 4);
+    ASSERT_EQ(tokens[0], "This");
+    ASSERT_EQ(tokens[3], "test");
+    // End of section, then back to the start
+    ASSERT_FALSE(parser.getLineFromSection("test", tokens));
+    ASSERT_TRUE(parser.getLineFromSection("test", tokens));
+    ASSERT_EQ(tokens[0], "This");
+}
+
+TEST(ParserTest, GetKeyRepeated){
+    // Key lookup does not depend on previous reads
+    Parser parser("../test_data/modules/parser.cfg");
+    std::vector<std::string> tokens;
+    ASSERT_TRUE(parser.getLineFromSection("here", tokens));
+    ASSERT_EQ(parser.getStringKeyFromSection("here", "key", "none"), "VALUE");
+    ASSERT_EQ(parser.getStringKeyFromSection("here", "key", "none"), "VALUE");
+    ASSERT_EQ(parser.getIntKeyFromSection("here", "nokey", 7), 7);
+}
+
+TEST(ParserTest, Include){
+    Parser parser("../test_data/modules/parser_include.top");
+    std::vector<std::string> tokens;
+    // Section from included file
+    ASSERT_TRUE(parser.getLineFromSection("atomtypes", tokens));
+    ASSERT_EQ(tokens[0], "C1");
+    // Excluded by #ifdef
+    ASSERT_FALSE(parser.getLineFromSection("atomtypes", tokens));
+}
+
+TEST(ParserTest, Define){
+    Parser parser("../test_data/modules/parser_include.top");
+    std::string value;
+    ASSERT_TRUE(parser.getKeyFromSection("molecule", "defined", value));
+    ASSERT_EQ(value, "yes");
+    ASSERT_FALSE(parser.getKeyFromSection("molecule", "ndefined", value));
+
+    // Substitution of a name defined in an included file
+    std::vector<std::string> tokens;
+    while(parser.getLineFromSection("molecule", tokens)){
+        if(tokens[0] == "bond") break;
+    }
+    ASSERT_EQ(tokens.size(), 3);
+    ASSERT_EQ(tokens[1], "0.47");
+    ASSERT_EQ(tokens[2], "1250");
+}
+
+TEST(ParserTest, IncludeCache){
+    Parser::clearCache();
+    Parser parser1("../test_data/modules/parser_include.top");
+    ASSERT_EQ(Parser::cacheSize(), 2);
+    Parser parser2("../test_data/modules/parser_include.top");
+    ASSERT_EQ(Parser::cacheSize(), 2);
+}
+
+TEST(ParserTest, IncludeMissing){
+    // Missing includes are skipped
+    Parser parser("../test_data/modules/parser_missing.top");
+    std::string value;
+    ASSERT_TRUE(parser.getKeyFromSection("here", "key", value));
+    ASSERT_EQ(value, "value");
+}
+
 int main(int argc, char **argv){
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,81 @@
+#include "plane_grid.h"
+
+#include <vector>
+#include <array>
+
+#include "gtest/gtest.h"
+
+#include "test_helpers.h"
+
+#include "small_functions.h"
+
+using std::vector;
+using std::array;
+
+/** Nearest point as found by the original membrane grid search */
+static int brute_force(const vector<array<double, 3>> &coords, const array<double, 3> &point,
+                       const array<double, 3> &box, const double max_dist2){
+    double min_dist2 = max_dist2;
+    int closest = -1;
+    for(int k=0; k<coords.size(); k++){
+        const double dist2 = distSqrPlane(point, coords[k], box);
+        if(dist2 < min_dist2){
+            closest = k;
+            min_dist2 = dist2;
+        }
+    }
+    return closest;
+}
+
+static void compare_grid(const vector<array<double, 3>> &coords, const array<double, 3> &box,
+                         const int grid, const double max_dist2){
+    PlaneGrid plane;
+    plane.build(coords, box);
+    for(int i=0; i<grid; i++){
+        for(int j=0; j<grid; j++){
+            const array<double, 3> point = {{(i + 0.5) * box[0] / grid, (j + 0.5) * box[1] / grid, 0.}};
+            double dist2;
+            ASSERT_EQ(brute_force(coords, point, box, max_dist2), plane.nearest(point, max_dist2, dist2));
+        }
+    }
+}
+
+TEST(PlaneGridTest, MatchesBruteForce){
+    const array<double, 3> box = {{12., 9., 10.}};
+    compare_grid(random_coords(500, box, -0.25, 1.25), box, 60, box[0] * box[1]);
+}
+
+TEST(PlaneGridTest, LatticeTies){
+    // Grid points lie exactly between lattice points so many are equidistant
+    const array<double, 3> box = {{8., 8., 10.}};
+    vector<array<double, 3>> coords;
+    for(int i=0; i<8; i++){
+        for(int j=0; j<8; j++) coords.push_back({{i + 0.5, 8. - j - 0.5, 5.}});
+    }
+    compare_grid(coords, box, 8, box[0] * box[1]);
+    compare_grid(coords, box, 4, box[0] * box[1]);
+    compare_grid(coords, box, 16, box[0] * box[1]);
+}
+
+TEST(PlaneGridTest, FewPoints){
+    const array<double, 3> box = {{10., 4., 10.}};
+    compare_grid(random_coords(3, box, -0.25, 1.25), box, 20, box[0] * box[1]);
+}
+
+TEST(PlaneGridTest, MaxDistance){
+    const array<double, 3> box = {{10., 10., 10.}};
+    const vector<array<double, 3>> coords = random_coords(50, box, -0.25, 1.25);
+    compare_grid(coords, box, 40, 0.25);
+
+    PlaneGrid plane;
+    plane.build(coords, box);
+    double dist2 = -1.;
+    const array<double, 3> point = {{5., 5., 0.}};
+    ASSERT_EQ(-1, plane.nearest(point, 0., dist2));
+    ASSERT_EQ(-1., dist2);
+}
+
+int main(int argc, char **argv){
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,149 @@
+#include "rdf.h"
+
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <stdexcept>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "gtest/gtest.h"
+
+#include "frame.h"
+#include "residue.h"
+
+#include "test_helpers.h"
+
+using std::vector;
+
+TEST(RDFTest, IdealGas){
+    const int natoms = 4000;
+    const double box = 5.;
+    vector<Residue> residues = single_atom_residues(natoms);
+    Frame frame(natoms, box, residues);
+    random_coords(frame, box);
+
+    RDF rdf(residues, 1., 20);
+    rdf.calculateRDF(frame);
+    rdf.normalize();
+    std::remove("rdf.dat");
+
+    // Uncorrelated positions - g(r) should be one away from the smallest shells
+    for(int i=5; i<20; i++) ASSERT_NEAR(1., rdf.rdf().at(i), 0.1);
+}
+
+TEST(RDFTest, SelectionPairs){
+    const int natoms = 4000;
+    const double box = 5.;
+    vector<Residue> residues = single_atom_residues(natoms);
+    Frame frame(natoms, box, residues);
+    random_coords(frame, box);
+    // One quarter of atoms are type B
+    for(int i=0; i<natoms; i++) frame.atoms_[i].atom_type = i % 4 ? "A" : "B";
+
+    RDF rdf(residues, 1., 20);
+    rdf.addPair("A", "B");
+    rdf.addPair("B", "B");
+    rdf.addPair("SOL", "B");
+    rdf.calculateRDF(frame);
+    rdf.normalize();
+    std::remove("rdf_A_B.dat");
+    std::remove("rdf_B_B.dat");
+    std::remove("rdf_SOL_B.dat");
+
+    for(int p=0; p<3; p++){
+        for(int i=5; i<20; i++) ASSERT_NEAR(1., rdf.rdf(p).at(i), 0.2);
+    }
+
+    // Coordination number within cutoff approaches density of B times sphere volume
+    const double expected = (natoms / 4) / (box * box * box) * (4. / 3.) * M_PI;
+    ASSERT_NEAR(expected, rdf.coordination(0).at(19), 0.05 * expected);
+    ASSERT_NEAR(expected, rdf.coordination(2).at(19), 0.05 * expected);
+
+    // Selection matching nothing is an error
+    ASSERT_THROW({
+        RDF bad(residues, 1., 20);
+        bad.addPair("A", "C");
+        bad.calculateRDF(frame);
+    }, std::runtime_error);
+}
+
+TEST(RDFTest, OverlappingSelections){
+    // Few atoms so leaving out the self pairs of atoms in both selections makes a clear difference
+    const int natoms = 20;
+    const double box = 4., cutoff = 2.;
+    vector<Residue> residues = single_atom_residues(natoms);
+    Frame frame(natoms, box, residues);
+    for(int i=0; i<natoms; i++) frame.atoms_[i].atom_type = i % 4 ? "A" : "B";
+
+    RDF rdf(residues, cutoff, 10);
+    rdf.addPair("SOL", "B");
+    rdf.addPair("B", "SOL");
+    rdf.addPair("A", "B");
+    for(unsigned seed=1; seed<=2000; seed++){
+        random_coords(frame, box, seed);
+        rdf.calculateRDF(frame);
+    }
+    rdf.normalize();
+    std::remove("rdf_SOL_B.dat");
+    std::remove("rdf_B_SOL.dat");
+    std::remove("rdf_A_B.dat");
+
+    // Mean of g(r) over the sphere is one for uncorrelated positions
+    const double v_sphere = (4. / 3.) * M_PI * cutoff * cutoff * cutoff;
+    for(int p=0; p<3; p++){
+        double mean = 0.;
+        for(int i=0; i<20; i++){
+            const double r_inner = i * 0.1, r_outer = r_inner + 0.1;
+            mean += rdf.rdf(p).at(i) * (4. / 3.) * M_PI * (std::pow(r_outer, 3) - std::pow(r_inner, 3));
+        }
+        ASSERT_NEAR(1., mean / v_sphere, 0.015);
+    }
+
+    // Each SOL atom has every other B atom as a neighbour - B atoms are in both selections
+    const int num_b = natoms / 4;
+    const double expected = (natoms * num_b - num_b) / static_cast<double>(natoms) * v_sphere / (box * box * box);
+    ASSERT_NEAR(expected, rdf.coordination(0).at(19), 0.015 * expected);
+}
+
+TEST(RDFTest, BenchmarkThreadScaling){
+    const int natoms = 8000;
+    const double box = 10.;
+    vector<Residue> residues = single_atom_residues(natoms);
+    Frame frame(natoms, box, residues);
+    random_coords(frame, box);
+
+#ifdef _OPENMP
+    const int max_threads = omp_get_max_threads();
+#endif
+    vector<double> reference;
+    for(int threads=1; threads<=64; threads*=2){
+#ifdef _OPENMP
+        omp_set_num_threads(threads);
+#endif
+        RDF rdf(residues, 2., 50);
+        const auto start = std::chrono::steady_clock::now();
+        rdf.calculateRDF(frame);
+        rdf.normalize();
+        std::remove("rdf.dat");
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        printf("RDF %5d atoms %3d threads %8.3f s\n", natoms, threads, elapsed.count());
+
+        // Integer counts so result must be identical for any number of threads
+        vector<double> result;
+        for(int i=0; i<100; i++) result.push_back(rdf.rdf().at(i));
+        if(reference.empty()) reference = result;
+        for(int i=0; i<100; i++) ASSERT_EQ(reference[i], result[i]);
+    }
+#ifdef _OPENMP
+    omp_set_num_threads(max_threads);
+#endif
+}
+
+int main(int argc, char **argv){
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,60 @@
+#include "structure_factor.h"
+
+#include <vector>
+#include <cstdio>
+
+#include "gtest/gtest.h"
+
+#include "frame.h"
+#include "residue.h"
+
+#include "test_helpers.h"
+
+using std::vector;
+
+TEST(StructureFactorTest, IdealGas){
+    const int natoms = 20000;
+    const double box = 6.;
+    vector<Residue> residues = single_atom_residues(natoms);
+    Frame frame(natoms, box, residues);
+    random_coords(frame, box);
+
+    StructureFactor sq(64, 20);
+    sq.calculate(frame);
+    sq.normalize("sq_test.dat");
+    std::remove("sq_test.dat");
+
+    // Uncorrelated positions - S(q) = 1 at all q
+    for(int i=5; i<20; i++) ASSERT_NEAR(1., sq.sq()[i], 0.15);
+}
+
+TEST(StructureFactorTest, CubicLattice){
+    const int side = 10;
+    const int natoms = side * side * side;
+    const double box = 5.;
+    const double spacing = box / side;
+    vector<Residue> residues = single_atom_residues(natoms);
+    Frame frame(natoms, box, residues);
+
+    for(int i=0; i<natoms; i++){
+        frame.atoms_[i].coords[0] = spacing * (i / (side * side));
+        frame.atoms_[i].coords[1] = spacing * ((i / side) % side);
+        frame.atoms_[i].coords[2] = spacing * (i % side);
+    }
+
+    StructureFactor sq(64, 100);
+    sq.calculate(frame);
+    sq.normalize("sq_test.dat");
+    std::remove("sq_test.dat");
+
+    // Bragg peak at 2 pi / spacing, no scattering at lower q
+    const int peak = sq.axis().index(2. * M_PI / spacing);
+    ASSERT_LT(peak, sq.axis().bins());
+    ASSERT_GT(sq.sq()[peak], 10.);
+    for(int i=0; i<peak-1; i++) ASSERT_NEAR(0., sq.sq()[i], 1e-6);
+}
+
+int main(int argc, char **argv){
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,45 @@
+#ifndef CGTOOL_TEST_HELPERS_H
+#define CGTOOL_TEST_HELPERS_H
+
+#include <vector>
+#include <array>
+#include <random>
+#include <string>
+
+#include "frame.h"
+#include "residue.h"
+
+/** \brief Deterministic pseudo-random coordinates.
+* Uniform between lo and hi box lengths along each axis - outside [0, 1) some are outside the box */
+inline std::vector<std::array<double, 3>> random_coords(const int n, const std::array<double, 3> &box,
+                                                        const double lo=0., const double hi=1.,
+                                                        const unsigned seed=12345){
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> dist(lo, hi);
+    std::vector<std::array<double, 3>> coords(n);
+    for(auto &coord : coords){
+        for(int d=0; d<3; d++) coord[d] = box[d] * dist(gen);
+    }
+    return coords;
+}
+
+/** \brief Place the atoms of a frame at random_coords in a cubic box */
+inline void random_coords(Frame &frame, const double box, const unsigned seed=12345){
+    const std::vector<std::array<double, 3>> coords = random_coords(frame.numAtoms_, {{box, box, box}}, 0., 1., seed);
+    for(int i=0; i<frame.numAtoms_; i++) frame.atoms_[i].coords = coords[i];
+}
+
+/** \brief One block of num single atom residues - e.g. solvent */
+inline std::vector<Residue> single_atom_residues(const int num, const std::string &resname="SOL"){
+    std::vector<Residue> residues(1);
+    residues[0].resname = resname;
+    residues[0].ref_atom = 0;
+    residues[0].num_atoms = 1;
+    residues[0].num_residues = num;
+    residues[0].total_atoms = num;
+    residues[0].start = 0;
+    residues[0].end = num;
+    return residues;
+}
+
+#endif //CGTOOL_TEST_HELPERS_H
@@ -0,0 +1,67 @@
+#include "text_buffer.h"
+
+#include <string>
+#include <cstdio>
+#include <cmath>
+#include <random>
+
+#include "gtest/gtest.h"
+
+using std::string;
+
+static string printf_fixed(const double value, const int width, const int precision){
+    char str[128];
+    snprintf(str, 128, "%*.*f", width, precision, value);
+    return str;
+}
+
+static string buffer_fixed(const double value, const int width, const int precision){
+    TextBuffer buffer(4);
+    buffer.appendFixed(value, width, precision);
+    return string(buffer.data(), buffer.size());
+}
+
+TEST(TextBufferTest, FixedMatchesPrintf){
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> dist(-100., 100.);
+    for(int i=0; i<100000; i++){
+        const double value = dist(gen);
+        const int precision = i % 7;
+        ASSERT_EQ(buffer_fixed(value, 10, precision), printf_fixed(value, 10, precision)) << value;
+    }
+}
+
+TEST(TextBufferTest, FixedEdgeCases){
+    const double values[] = {0., -0., 0.5, 1.5, 2.5, 0.125, 0.375, -0.0001, 1.0005, 2.675,
+                             999.9995, -999.9995, 1e12, -3e20, INFINITY, NAN, 1e-300};
+    for(const double value : values){
+        for(int precision=0; precision<6; precision++){
+            ASSERT_EQ(buffer_fixed(value, 8, precision), printf_fixed(value, 8, precision)) << value;
+            ASSERT_EQ(buffer_fixed(value, 0, precision), printf_fixed(value, 0, precision)) << value;
+        }
+    }
+}
+
+TEST(TextBufferTest, FixedLargeMatchesPrintf){
+    // Scaled value too large to round exactly - must fall back to printf
+    ASSERT_EQ(buffer_fixed(123456789.123456789, 0, 9), printf_fixed(123456789.123456789, 0, 9));
+    std::mt19937 gen(2);
+    std::uniform_real_distribution<double> exponent(0., 12.);
+    for(int i=0; i<100000; i++){
+        const double value = std::pow(10., exponent(gen)) * (i % 2 ? 1. : -1.);
+        const int precision = 6 + i % 4;
+        ASSERT_EQ(buffer_fixed(value, 12, precision), printf_fixed(value, 12, precision)) << value;
+    }
+}
+
+TEST(TextBufferTest, IntAndString){
+    TextBuffer buffer(2);
+    buffer.appendInt(42, 5);
+    buffer.appendInt(-7);
+    buffer.appendInt(0, 2);
+    buffer.append(string("AB"), 4, true);
+    buffer.append(string("CD"), 4);
+    buffer.append(string("TOOLONG"), 3);
+    buffer.append('\n');
+    ASSERT_EQ(string(buffer.data(), buffer.size()), "   42-7 0AB    CDTOOLONG\n");
+}
@@ -0,0 +1,93 @@
+#include "undulation.h"
+
+#include <vector>
+#include <array>
+#include <complex>
+#include <cmath>
+#include <random>
+#include <cstdio>
+
+#include "gtest/gtest.h"
+
+#include "fft.h"
+
+using std::vector;
+using std::array;
+using std::complex;
+
+/** Gaussian height field with Helfrich spectrum A <|h(q)|^2> = kT / (kappa q^4 + sigma q^2) */
+static void helfrich_field(LightArray<double> &field, const int n, const double box,
+                           const double kT, const double kappa, const double sigma,
+                           std::mt19937 &gen){
+    // White noise of unit variance
+    std::normal_distribution<double> gaussian;
+    vector<complex<double>> h(n * n);
+    for(int i=0; i<n*n; i++) h[i] = gaussian(gen);
+
+    // Colour the noise - scaling depends only on |q| so the field stays real
+    fft2D(h, n, n);
+    const double area = box * box;
+    for(int x=0; x<n; x++){
+        const int kx = x <= n / 2 ? x : x - n;
+        for(int y=0; y<n; y++){
+            const int ky = y <= n / 2 ? y : y - n;
+            const double q2 = (2. * M_PI / box) * (2. * M_PI / box) * (kx * kx + ky * ky);
+            const double power = q2 > 0. ? kT / (area * (kappa * q2 * q2 + sigma * q2)) : 0.;
+            h[x * n + y] *= std::sqrt(power * n * n);
+        }
+    }
+    fft2D(h, n, n, true);
+
+    field.alloc(n, n);
+    for(int x=0; x<n; x++){
+        for(int y=0; y<n; y++) field(x, y) = h[x * n + y].real();
+    }
+}
+
+TEST(UndulationTest, RecoverHelfrich){
+    const int n = 32;
+    const double box = 30.;
+    const double kT = 2.5, kappa = 50., sigma = 2.;
+    std::mt19937 gen(12345);
+
+    UndulationSpectrum spectrum;
+    LightArray<double> height, thickness;
+    for(int frame=0; frame<200; frame++){
+        helfrich_field(height, n, box, kT, kappa, sigma, gen);
+        helfrich_field(thickness, n, box, kT, 10. * kappa, sigma, gen);
+        spectrum.add(height, thickness, {{box, box, 10.}});
+    }
+
+    double fit_kappa, fit_sigma;
+    ASSERT_TRUE(spectrum.fit(1.5, kT, fit_kappa, fit_sigma));
+    ASSERT_NEAR(kappa, fit_kappa, 0.1 * kappa);
+    ASSERT_NEAR(sigma, fit_sigma, 0.2 * sigma);
+
+    // Stiffer thickness field has smaller fluctuations
+    for(int i=0; i<spectrum.axis().bins(); i++){
+        if(spectrum.height(i) > 0.){
+            ASSERT_LT(spectrum.thickness(i), spectrum.height(i));
+        }
+    }
+
+    spectrum.print("undulation_test", 1.5, kT);
+    std::remove("undulation_test.dat");
+}
+
+TEST(UndulationTest, FlatMembrane){
+    const int n = 16;
+    LightArray<double> height(n, n), thickness(n, n);
+    height.zero(5.);
+    thickness.zero(4.);
+
+    UndulationSpectrum spectrum;
+    spectrum.add(height, thickness, {{10., 10., 10.}});
+    for(int i=0; i<spectrum.axis().bins(); i++) ASSERT_NEAR(0., spectrum.height(i), 1e-20);
+    double kappa, sigma;
+    ASSERT_FALSE(spectrum.fit(1., 2.5, kappa, sigma));
+}
+
+int main(int argc, char **argv){
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,115 @@
+#include "voronoi.h"
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <algorithm>
+
+#include "gtest/gtest.h"
+
+#include "test_helpers.h"
+
+using std::vector;
+using std::array;
+
+static void check_consistent(const Voronoi &voronoi, const array<double, 3> &box){
+    double total = 0.;
+    for(const double area : voronoi.areas()) total += area;
+    ASSERT_NEAR(box[0] * box[1], total, 1e-8);
+
+    // Neighbour relation is symmetric
+    const vector<vector<int>> &neigh = voronoi.neighbours();
+    for(int i=0; i<neigh.size(); i++){
+        for(const int j : neigh[i]){
+            ASSERT_TRUE(std::binary_search(neigh[j].begin(), neigh[j].end(), i));
+        }
+    }
+}
+
+TEST(VoronoiTest, SquareLattice){
+    const array<double, 3> box = {{10., 10., 10.}};
+    vector<array<double, 3>> coords;
+    for(int i=0; i<10; i++){
+        for(int j=0; j<10; j++) coords.push_back({{i + 0.5, j + 0.5, 5.}});
+    }
+
+    Voronoi voronoi;
+    voronoi.tessellate(coords, box);
+    check_consistent(voronoi, box);
+    for(int i=0; i<coords.size(); i++){
+        ASSERT_NEAR(1., voronoi.areas()[i], 1e-10);
+        // Diagonal points only touch at a corner
+        ASSERT_EQ(4, voronoi.neighbours()[i].size());
+    }
+}
+
+TEST(VoronoiTest, HexagonalLattice){
+    const int nx = 8, ny = 10;
+    const double a = 1.;
+    const double row = a * std::sqrt(3.) / 2.;
+    const array<double, 3> box = {{nx * a, ny * row, 10.}};
+    vector<array<double, 3>> coords;
+    for(int j=0; j<ny; j++){
+        for(int i=0; i<nx; i++) coords.push_back({{(i + 0.5 * (j % 2)) * a, j * row, 5.}});
+    }
+
+    Voronoi voronoi;
+    voronoi.tessellate(coords, box);
+    check_consistent(voronoi, box);
+    for(int i=0; i<coords.size(); i++){
+        ASSERT_NEAR(a * row, voronoi.areas()[i], 1e-10);
+        ASSERT_EQ(6, voronoi.neighbours()[i].size());
+    }
+}
+
+TEST(VoronoiTest, RandomMatchesGridCount){
+    const array<double, 3> box = {{9., 7., 10.}};
+    const vector<array<double, 3>> coords = random_coords(200, box, -0.25, 1.25);
+
+    Voronoi voronoi;
+    voronoi.tessellate(coords, box);
+    check_consistent(voronoi, box);
+
+    // Approximate areas by assigning a fine grid to the closest point
+    const int grid = 600;
+    vector<int> count(coords.size(), 0);
+    for(int gx=0; gx<grid; gx++){
+        for(int gy=0; gy<grid; gy++){
+            const double x = (gx + 0.5) * box[0] / grid, y = (gy + 0.5) * box[1] / grid;
+            double best = 1e10;
+            int closest = -1;
+            for(int k=0; k<coords.size(); k++){
+                double dx = coords[k][0] - x, dy = coords[k][1] - y;
+                dx -= box[0] * std::round(dx / box[0]);
+                dy -= box[1] * std::round(dy / box[1]);
+                if(dx * dx + dy * dy < best){
+                    best = dx * dx + dy * dy;
+                    closest = k;
+                }
+            }
+            count[closest]++;
+        }
+    }
+    const double cell = box[0] * box[1] / (grid * grid);
+    for(int k=0; k<coords.size(); k++) ASSERT_NEAR(voronoi.areas()[k], count[k] * cell, 0.02);
+}
+
+TEST(VoronoiTest, FewPoints){
+    // Cells reach across the box so periodic images of the same point are neighbours
+    const array<double, 3> box = {{6., 4., 10.}};
+    const vector<array<double, 3>> coords = random_coords(3, box, -0.25, 1.25);
+
+    Voronoi voronoi;
+    voronoi.tessellate(coords, box);
+    check_consistent(voronoi, box);
+
+    Voronoi single;
+    single.tessellate(vector<array<double, 3>>(1, coords[0]), box);
+    ASSERT_NEAR(box[0] * box[1], single.areas()[0], 1e-10);
+    ASSERT_TRUE(single.neighbours()[0].empty());
+}
+
+int main(int argc, char **argv){
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
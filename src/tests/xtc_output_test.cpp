@@ -0,0 +1,149 @@
+#include "XTCOutput.h"
+#include "XTCInput.h"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <cmath>
+#include <random>
+#include <cstdio>
+
+#include "xdrfile.h"
+#include "xdrfile_xtc.h"
+
+#include "gtest/gtest.h"
+
+using std::vector;
+using std::string;
+
+/** Write frames of random coordinates which differ each frame */
+static void write_frames(XTCOutput &output, Frame &frame, const int num_frames){
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> dist(0., 5.);
+    for(int f=0; f<num_frames; f++){
+        frame.step_ = 10 * f;
+        frame.time_ = 0.5f * f;
+        for(int i=0; i<frame.numAtoms_; i++){
+            for(int d=0; d<3; d++) frame.atoms_[i].coords[d] = dist(gen);
+        }
+        ASSERT_EQ(output.writeFrame(frame), 0);
+    }
+}
+
+static vector<char> read_bytes(const string &filename){
+    std::ifstream file(filename, std::ios::binary);
+    return vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+TEST(XTCOutputTest, ThreadedMatchesSerial){
+    vector<Residue> residues(1);
+    Frame frame(1000, 5., residues);
+    {
+        XTCOutput serial(frame.numAtoms_, "xtc_output_serial.xtc");
+        write_frames(serial, frame, 50);
+    }
+    {
+        XTCOutput threaded(frame.numAtoms_, "xtc_output_threaded.xtc", 500.f, {}, 4);
+        write_frames(threaded, frame, 50);
+    }
+
+    const vector<char> serial = read_bytes("xtc_output_serial.xtc");
+    const vector<char> threaded = read_bytes("xtc_output_threaded.xtc");
+    ASSERT_GT(serial.size(), 0);
+    ASSERT_EQ(serial, threaded);
+    std::remove("xtc_output_serial.xtc");
+    std::remove("xtc_output_threaded.xtc");
+}
+
+TEST(XTCOutputTest, SubsetPrecision){
+    vector<Residue> residues(1);
+    Frame frame(100, 5., residues);
+    // XTC only compresses frames of more than 9 atoms
+    vector<int> atoms;
+    for(int i=3; i<frame.numAtoms_; i+=4) atoms.push_back(i);
+    for(int i=0; i<frame.numAtoms_; i++){
+        for(int d=0; d<3; d++) frame.atoms_[i].coords[d] = 0.1 * i + 0.01234 * d;
+    }
+    frame.step_ = 7;
+    frame.time_ = 3.5f;
+    {
+        XTCOutput output(frame.numAtoms_, "xtc_output_subset.xtc", 10000.f, atoms, 2);
+        ASSERT_EQ(output.writeFrame(frame), 0);
+    }
+
+    int natoms;
+    ASSERT_EQ(read_xtc_natoms("xtc_output_subset.xtc", &natoms), exdrOK);
+    ASSERT_EQ(natoms, atoms.size());
+
+    XDRFILE *file = xdrfile_open("xtc_output_subset.xtc", "r");
+    int step;
+    float time, prec;
+    matrix box;
+    vector<float> x(3 * natoms);
+    ASSERT_EQ(read_xtc(file, natoms, &step, &time, box, reinterpret_cast<rvec *>(x.data()), &prec), exdrOK);
+    xdrfile_close(file);
+
+    ASSERT_EQ(step, 7);
+    ASSERT_FLOAT_EQ(time, 3.5f);
+    ASSERT_FLOAT_EQ(prec, 10000.f);
+    for(int i=0; i<natoms; i++){
+        for(int d=0; d<3; d++) ASSERT_NEAR(x[3*i + d], frame.atoms_[atoms[i]].coords[d], 1e-4);
+    }
+    std::remove("xtc_output_subset.xtc");
+}
+
+TEST(XTCOutputTest, SubsetOutOfRange){
+    ASSERT_THROW(XTCOutput(10, "xtc_output_range.xtc", 500.f, {10}), std::out_of_range);
+}
+
+TEST(XTCInputTest, PartialFrameRetry){
+    vector<Residue> residues(1);
+    Frame frame(100, 5., residues);
+    {
+        XTCOutput output(frame.numAtoms_, "xtc_input_full.xtc");
+        write_frames(output, frame, 3);
+    }
+    const vector<char> bytes = read_bytes("xtc_input_full.xtc");
+
+    // End of each frame in the file
+    vector<long> ends;
+    {
+        XDRFILE *file = xdrfile_open("xtc_input_full.xtc", "r");
+        int step;
+        float time, prec;
+        matrix box;
+        vector<float> x(3 * frame.numAtoms_);
+        while(read_xtc(file, frame.numAtoms_, &step, &time, box,
+                       reinterpret_cast<rvec *>(x.data()), &prec) == exdrOK){
+            ends.push_back(xdrfile_tell(file));
+        }
+        xdrfile_close(file);
+    }
+    ASSERT_EQ(ends.size(), 3);
+
+    // As if the last frame were still being written
+    const long split = (ends[1] + ends[2]) / 2;
+    FILE *out = fopen("xtc_input_growing.xtc", "wb");
+    fwrite(bytes.data(), 1, split, out);
+    fflush(out);
+
+    XTCInput input("xtc_input_growing.xtc");
+    ASSERT_EQ(input.readFrame(frame), 0);
+    ASSERT_EQ(frame.step_, 10);
+    const long pos = input.tell();
+    ASSERT_EQ(pos, ends[1]);
+    ASSERT_NE(input.readFrame(frame), 0);
+
+    fwrite(bytes.data() + split, 1, bytes.size() - split, out);
+    fclose(out);
+
+    input.seek(pos);
+    ASSERT_EQ(input.readFrame(frame), 0);
+    ASSERT_EQ(frame.step_, 20);
+    ASSERT_EQ(input.tell(), ends[2]);
+    ASSERT_THROW(input.seek(ends[2] + 1), std::runtime_error);
+
+    std::remove("xtc_input_full.xtc");
+    std::remove("xtc_input_growing.xtc");
+}
@@ -0,0 +1,108 @@
+#include "text_buffer.h"
+
+#include <cmath>
+#include <cstring>
+
+static const double powers_of_ten[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+
+void TextBuffer::pad(const size_t n, const int width){
+    if(n >= width) return;
+    const size_t shift = width - n;
+    char *start = reserve(shift) - n;
+    std::memmove(start + shift, start, n);
+    std::memset(start, ' ', shift);
+    size_ += shift;
+}
+
+void TextBuffer::append(const char *str){
+    appendBytes(str, std::strlen(str));
+}
+
+void TextBuffer::append(const std::string &str, const int width, const bool left){
+    appendBytes(str.data(), str.size());
+    if(!left){
+        pad(str.size(), width);
+    }else if(str.size() < width){
+        const size_t fill = width - str.size();
+        std::memset(reserve(fill), ' ', fill);
+        size_ += fill;
+    }
+}
+
+void TextBuffer::appendInt(const long value, const int width){
+    // Digits are produced in reverse then flipped
+    char digits[24];
+    int n = 0;
+    unsigned long mag = value < 0 ? -static_cast<unsigned long>(value) : value;
+    do{
+        digits[n++] = static_cast<char>('0' + mag % 10);
+        mag /= 10;
+    }while(mag > 0);
+    if(value < 0) digits[n++] = '-';
+
+    char *out = reserve(n);
+    for(int i=0; i<n; i++) out[i] = digits[n - 1 - i];
+    size_ += n;
+    pad(n, width);
+}
+
+void TextBuffer::appendFixed(const double value, const int width, const int precision){
+    const double mag = std::fabs(value);
+    bool fast = precision >= 0 && precision <= 9 && std::isfinite(value);
+
+    double scaled = 0.;
+    double fraction = 0.;
+    if(fast){
+        scaled = mag * powers_of_ten[precision];
+        // Product is only within the tie tolerance below while its ulp is well under 1e-6
+        fast = scaled < 4e9;
+        fraction = scaled - std::floor(scaled);
+    }
+
+    // Rounding a product may differ from printf's exact decimal rounding only near a tie
+    if(!fast || std::fabs(fraction - 0.5) < 1e-6){
+        char *out = reserve(64 + width);
+        const int n = std::snprintf(out, 64 + width, "%*.*f", width, precision, value);
+        if(n >= 64 + width){
+            out = reserve(n + 1);
+            std::snprintf(out, n + 1, "%*.*f", width, precision, value);
+        }
+        size_ += n;
+        return;
+    }
+
+    const unsigned long rounded = static_cast<unsigned long>(std::floor(scaled + 0.5));
+    const unsigned long divisor = static_cast<unsigned long>(powers_of_ten[precision]);
+    unsigned long integer = rounded / divisor;
+    unsigned long decimal = rounded % divisor;
+
+    char digits[32];
+    int n = 0;
+    for(int i=0; i<precision; i++){
+        digits[n++] = static_cast<char>('0' + decimal % 10);
+        decimal /= 10;
+    }
+    if(precision > 0) digits[n++] = '.';
+    do{
+        digits[n++] = static_cast<char>('0' + integer % 10);
+        integer /= 10;
+    }while(integer > 0);
+    // printf keeps the sign of negative values which round to zero
+    if(std::signbit(value)) digits[n++] = '-';
+
+    char *out = reserve(n);
+    for(int i=0; i<n; i++) out[i] = digits[n - 1 - i];
+    size_ += n;
+    pad(n, width);
+}
+
+void TextBuffer::appendBytes(const void *bytes, const size_t n){
+    std::memcpy(reserve(n), bytes, n);
+    size_ += n;
+}
+
+bool TextBuffer::write(FILE *file){
+    const bool ok = std::fwrite(data_.data(), 1, size_, file) == size_;
+    size_ = 0;
+    return ok;
+}
@@ -0,0 +1,179 @@
+#include "undulation.h"
+
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+#include <algorithm>
+
+#include "fft.h"
+#include "small_functions.h"
+
+using std::vector;
+using std::array;
+using std::complex;
+
+void UndulationSpectrum::add(const LightArray<double> &height, const LightArray<double> &thickness,
+                             const array<double, 3> &box){
+    const int n = height.size()[0];
+    const int size = n * n;
+
+    // Fix q range from the first frame - up to Nyquist frequency of coarsest axis
+    // in shells the width of the reciprocal lattice spacing
+    if(frames_ == 0){
+        grid_ = n;
+        bins_ = std::max(1, n / 2);
+        const double dq = 2. * M_PI / std::max(box[0], box[1]);
+        const array<HistogramAxis, 1> axes = {{HistogramAxis::fromWidth(0.5 * dq, dq, bins_)}};
+        height_.init(axes);
+        thickness_.init(axes);
+        count_.init(axes);
+        qSum_.init(axes);
+        heightQ4_.init(axes);
+        invQ2_.init(axes);
+    }
+    if(n != grid_) throw std::invalid_argument("Undulation grid size changed between frames");
+    const double q_max = count_.axis(0).hi();
+    const double q_min = count_.axis(0).lo();
+
+    // Fluctuations about the mean so the q = 0 term vanishes
+    vector<complex<double>> h(size), t(size);
+    double h_mean = 0., t_mean = 0.;
+    for(int i=0; i<n; i++){
+        for(int j=0; j<n; j++){
+            h_mean += height.at(i, j);
+            t_mean += thickness.at(i, j);
+        }
+    }
+    h_mean /= size;
+    t_mean /= size;
+    for(int i=0; i<n; i++){
+        for(int j=0; j<n; j++){
+            h[i * n + j] = height.at(i, j) - h_mean;
+            t[i * n + j] = thickness.at(i, j) - t_mean;
+        }
+    }
+
+    fft2D(h, n, n);
+    fft2D(t, n, n);
+
+    // A |h(q)|^2 with h(q) the grid mean of h(r) exp(-iq.r)
+    const double area = box[0] * box[1];
+    const double norm = area / (static_cast<double>(size) * size);
+
+    #pragma omp parallel default(shared)
+    {
+        HistogramND<double, 1> h_part(height_), t_part(thickness_), c_part(count_), q_part(qSum_);
+        HistogramND<double, 1> h4_part(heightQ4_), x_part(invQ2_);
+        h_part.zero();
+        t_part.zero();
+        c_part.zero();
+        q_part.zero();
+        h4_part.zero();
+        x_part.zero();
+
+        #pragma omp for schedule(static)
+        for(int x=0; x<n; x++){
+            const int kx = x <= n / 2 ? x : x - n;
+            const double qx = 2. * M_PI * kx / box[0];
+            for(int y=0; y<n; y++){
+                if(x == 0 && y == 0) continue;
+                const int ky = y <= n / 2 ? y : y - n;
+                const double qy = 2. * M_PI * ky / box[1];
+                const double q = std::sqrt(qx * qx + qy * qy);
+                if(q < q_min || q >= q_max) continue;
+
+                const array<double, 1> loc = {{q}};
+                const double power = norm * std::norm(h[x * n + y]);
+                h_part.add(loc, power);
+                h4_part.add(loc, q * q * q * q * power);
+                x_part.add(loc, 1. / (q * q));
+                t_part.add(loc, norm * std::norm(t[x * n + y]));
+                c_part.add(loc);
+                q_part.add(loc, q);
+            }
+        }
+
+        #pragma omp critical
+        {
+            height_.merge(h_part);
+            thickness_.merge(t_part);
+            count_.merge(c_part);
+            qSum_.merge(q_part);
+            heightQ4_.merge(h4_part);
+            invQ2_.merge(x_part);
+        }
+    }
+
+    frames_++;
+}
+
+double UndulationSpectrum::q(const int i) const{
+    return count_.at(i) > 0. ? qSum_.at(i) / count_.at(i) : axis().centre(i);
+}
+
+double UndulationSpectrum::height(const int i) const{
+    return count_.at(i) > 0. ? height_.at(i) / count_.at(i) : 0.;
+}
+
+double UndulationSpectrum::thickness(const int i) const{
+    return count_.at(i) > 0. ? thickness_.at(i) / count_.at(i) : 0.;
+}
+
+void UndulationSpectrum::checkpoint(Checkpoint &cp){
+    cp.sync(grid_);
+    cp.sync(bins_);
+    cp.sync(frames_);
+    for(HistogramND<double, 1> *hist : {&height_, &thickness_, &count_, &qSum_, &heightQ4_, &invQ2_})
+        hist->checkpoint(cp);
+}
+
+bool UndulationSpectrum::fit(const double q_max, const double kT, double &kappa, double &sigma) const{
+    if(frames_ == 0) return false;
+
+    // Least squares fit of y = kT / <q^4 A |h|^2> = kappa + sigma x where x = <q^-2>
+    double sum_x = 0., sum_y = 0., sum_xx = 0., sum_xy = 0.;
+    int num = 0;
+    for(int i=0; i<bins_; i++){
+        const double q = this->q(i);
+        if(q >= q_max || count_.at(i) == 0. || heightQ4_.at(i) <= 0.) continue;
+        const double x = invQ2_.at(i) / count_.at(i);
+        const double y = kT * count_.at(i) / heightQ4_.at(i);
+        sum_x += x;
+        sum_y += y;
+        sum_xx += x * x;
+        sum_xy += x * y;
+        num++;
+    }
+    if(num < 2) return false;
+
+    sigma = (num * sum_xy - sum_x * sum_y) / (num * sum_xx - sum_x * sum_x);
+    kappa = (sum_y - sigma * sum_x) / num;
+    return true;
+}
+
+void UndulationSpectrum::print(const std::string &filename, const double q_max, const double kT,
+                               const bool header) const{
+    const std::string file = filename + ".dat";
+    // Backup using small_functions.h
+    backup_old_file(file);
+    FILE *f = fopen(file.c_str(), "w");
+    if(f == nullptr) throw std::runtime_error("Could not open output file.");
+
+    if(header){
+        fprintf(f, "@legend Membrane undulation spectrum\n");
+        double kappa, sigma;
+        if(fit(q_max, kT, kappa, sigma)){
+            fprintf(f, "@kappa %f kT, %f kJ/mol\n", kappa / kT, kappa);
+            fprintf(f, "@sigma %f kJ/mol/nm^2\n", sigma);
+        }
+        fprintf(f, "@columns q (nm^-1)  A<|h(q)|^2> (nm^4)  A<|t(q)|^2> (nm^4)  wavevectors\n");
+    }
+
+    for(int i=0; i<bins_; i++){
+        // Empty shells at small q have no wavevectors - skip them
+        if(count_.at(i) == 0.) continue;
+        fprintf(f, "%10.4f%14.6e%14.6e%8d\n", q(i), height(i), thickness(i),
+                static_cast<int>(count_.at(i) / frames_));
+    }
+    fclose(f);
+}
@@ -0,0 +1,141 @@
+#include "voronoi.h"
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#include "plane_grid.h"
+
+using std::vector;
+using std::array;
+
+namespace{
+/** \brief Vertex of a cell polygon relative to its point and the neighbour whose bisector starts there */
+struct Vertex{
+    double x, y;
+    /** Index of neighbour whose bisector forms the edge to the next vertex - -1 for the box */
+    int edge;
+};
+
+/** \brief Neighbour candidate as a displacement from the cell's point */
+struct Candidate{
+    double dx, dy, dist2;
+    int index;
+
+    bool operator<(const Candidate &other) const{
+        return dist2 < other.dist2;
+    }
+};
+
+/** \brief Clip convex polygon to the half plane closer to the origin than to candidate c */
+void clip(vector<Vertex> &poly, vector<Vertex> &work, const Candidate &c){
+    const double half = 0.5 * c.dist2;
+    work.clear();
+    const int n = static_cast<int>(poly.size());
+    for(int k=0; k<n; k++){
+        const Vertex &p = poly[k];
+        const Vertex &q = poly[(k + 1) % n];
+        const double sp = p.x * c.dx + p.y * c.dy - half;
+        const double sq = q.x * c.dx + q.y * c.dy - half;
+        const bool p_in = sp <= 0., q_in = sq <= 0.;
+        if(p_in) work.push_back(p);
+        if(p_in != q_in){
+            const double t = sp / (sp - sq);
+            // Leaving the half plane the new edge is along the bisector, entering it continues the old edge
+            work.push_back({p.x + t * (q.x - p.x), p.y + t * (q.y - p.y), p_in ? c.index : p.edge});
+        }
+    }
+    poly.swap(work);
+}
+}
+
+void Voronoi::tessellate(const vector<array<double, 3>> &coords, const array<double, 3> &box){
+    const int num = static_cast<int>(coords.size());
+    areas_.assign(num, 0.);
+    neighbours_.assign(num, vector<int>());
+    if(num == 0) return;
+
+    PlaneGrid grid;
+    grid.build(coords, box);
+
+    // Radius within which points are guaranteed to be distinct images under minimum image
+    const double half_box = 0.5 * std::min(box[0], box[1]);
+    const double initial_radius = 2.5 * std::sqrt(box[0] * box[1] / num);
+    const double min_edge2 = 1e-12 * box[0] * box[1] / num;
+
+    #pragma omp parallel default(shared)
+    {
+        vector<int> found;
+        vector<Candidate> candidates;
+        vector<Vertex> poly, work;
+
+        #pragma omp for schedule(dynamic, 64)
+        for(int i=0; i<num; i++){
+            double radius = initial_radius;
+            while(true){
+                // Candidates as displacements from point i
+                candidates.clear();
+                if(radius < half_box){
+                    grid.within(coords[i], radius * radius, found);
+                    for(const int j : found){
+                        if(j == i) continue;
+                        double dx = coords[j][0] - coords[i][0];
+                        double dy = coords[j][1] - coords[i][1];
+                        dx -= box[0] * std::round(dx / box[0]);
+                        dy -= box[1] * std::round(dy / box[1]);
+                        candidates.push_back({dx, dy, dx * dx + dy * dy, j});
+                    }
+                }else{
+                    // Search radius reaches across the box - take every image of every point
+                    for(int j=0; j<num; j++){
+                        double dx = coords[j][0] - coords[i][0];
+                        double dy = coords[j][1] - coords[i][1];
+                        dx -= box[0] * std::round(dx / box[0]);
+                        dy -= box[1] * std::round(dy / box[1]);
+                        for(int sx=-1; sx<=1; sx++){
+                            for(int sy=-1; sy<=1; sy++){
+                                if(j == i && sx == 0 && sy == 0) continue;
+                                const double ix = dx + sx * box[0], iy = dy + sy * box[1];
+                                const double dist2 = ix * ix + iy * iy;
+                                if(dist2 < radius * radius) candidates.push_back({ix, iy, dist2, j});
+                            }
+                        }
+                    }
+                }
+                std::sort(candidates.begin(), candidates.end());
+
+                // Start with the rectangle bounded by the point's own images
+                const double hx = 0.5 * box[0], hy = 0.5 * box[1];
+                poly = {{-hx, -hy, -1}, {hx, -hy, -1}, {hx, hy, -1}, {-hx, hy, -1}};
+                for(const Candidate &c : candidates){
+                    if(c.dist2 <= 0.) throw std::runtime_error("Voronoi tessellation of coincident points");
+                    clip(poly, work, c);
+                }
+
+                // A point further than twice the furthest vertex cannot clip the cell
+                double max_vertex2 = 0.;
+                for(const Vertex &v : poly) max_vertex2 = std::max(max_vertex2, v.x * v.x + v.y * v.y);
+                if(4. * max_vertex2 <= radius * radius) break;
+                // Every image within reach of the cell has been tried
+                if(radius >= 2. * (hx + hy)) break;
+                radius = std::min(2. * radius, 2. * (hx + hy));
+            }
+
+            double area = 0.;
+            vector<int> &neigh = neighbours_[i];
+            neigh.clear();
+            for(int k=0; k<poly.size(); k++){
+                const Vertex &p = poly[k];
+                const Vertex &q = poly[(k + 1) % poly.size()];
+                area += p.x * q.y - q.x * p.y;
+                // Clipping through a vertex leaves an edge of zero length - not a real neighbour
+                const double len2 = (q.x - p.x) * (q.x - p.x) + (q.y - p.y) * (q.y - p.y);
+                if(p.edge >= 0 && len2 > min_edge2) neigh.push_back(p.edge);
+            }
+            areas_[i] = 0.5 * std::abs(area);
+
+            std::sort(neigh.begin(), neigh.end());
+            neigh.erase(std::unique(neigh.begin(), neigh.end()), neigh.end());
+        }
+    }
+}